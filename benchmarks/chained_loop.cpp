@@ -0,0 +1,79 @@
+// Async loop where every step continues with the future of the next step. With chained promises
+// collapsed the number of live states stays constant, so peak memory should not grow with the
+// iteration count.
+
+#include "../task_stuff.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+using namespace TaskStuff;
+
+namespace
+{
+    // Steps complete only once the driver loop in main gets to them, so no continuation runs inline
+    std::deque<Promise<int>> pendingSteps;
+
+    Future<int> Step()
+    {
+        pendingSteps.emplace_back();
+        return pendingSteps.back().GetFuture();
+    }
+
+    Future<int> Loop(int remaining)
+    {
+        if (remaining == 0)
+            return Future<int>(0);
+
+        return Step().Then([remaining](int)
+            {
+                return Loop(remaining - 1);
+            });
+    }
+
+    long PeakRssKiB()
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+        return usage.ru_maxrss / 1024;
+#else
+        return usage.ru_maxrss;
+#endif
+#else
+        return -1;
+#endif
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+    auto start = std::chrono::steady_clock::now();
+
+    Future<int> result = Loop(iterations);
+
+    while (!pendingSteps.empty())
+    {
+        Promise<int> promise = std::move(pendingSteps.front());
+        pendingSteps.pop_front();
+        promise.SetValue(1);
+    }
+
+    result.Get();
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+    std::printf("iterations: %d\n", iterations);
+    std::printf("time:       %lld ms\n", static_cast<long long>(elapsed.count()));
+    std::printf("peak rss:   %ld KiB\n", PeakRssKiB());
+    return 0;
+}
@@ -1,45 +1,244 @@
 #include "task_stuff.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+
 namespace TaskStuff
 {
-    void Promise<void>::SetDone()
+    template class Future<void, MultiThreaded>;
+    template class Promise<void, MultiThreaded>;
+
+    // Pool the current thread is a worker of, if any
+    static thread_local ThreadPool* _current_pool_ = nullptr;
+
+    bool _internal_on_pool_thread()
+    {
+        return _current_pool_ != nullptr;
+    }
+
+    bool _internal_help_current_pool()
+    {
+        return _current_pool_ && _current_pool_->_runOne();
+    }
+
+    void _internal_watch_current_pool(_InternalWaiter* waiter)
+    {
+        std::unique_lock lck(_current_pool_->_mtx_queue_);
+        _current_pool_->_helpers_.push_back(waiter);
+    }
+
+    void _internal_unwatch_current_pool(_InternalWaiter* waiter)
     {
-        if (_value_set_)
+        std::unique_lock lck(_current_pool_->_mtx_queue_);
+        std::erase(_current_pool_->_helpers_, waiter);
+    }
+
+    ThreadPool::ThreadPool(size_t threadCount)
+        : _stopping_(false)
+    {
+        if (threadCount == 0)
+            threadCount = 1;
+
+        _threads_.reserve(threadCount);
+
+        for (size_t i = 0; i < threadCount; ++i)
         {
-            throw FutureError(FutureErrorCode::PromiseAlreadySatisfied, "Promise value already set!");
+            _threads_.emplace_back([this]()
+                {
+                    _workerLoop();
+                });
         }
+    }
 
-        if (!_state_)
+    ThreadPool::~ThreadPool()
+    {
+        // Scope for lock
         {
-            throw FutureError(FutureErrorCode::NoState, "Promise has no state!");
+            std::unique_lock lck(_mtx_queue_);
+            _stopping_ = true;
         }
 
-        std::unique_lock lck(_state_->_mtx_value_);
-        _value_set_ = true;
+        _cv_queue_.notify_all();
+
+        for (std::thread& thread : _threads_)
+            thread.join();
+    }
 
-        // If a continuation function is set, call it with the value
-        if (_state_->_continuation_)
+    void ThreadPool::Execute(Task task)
+    {
+        // Scope for lock
         {
-            _state_->_continuation_->Call();
+            std::unique_lock lck(_mtx_queue_);
+            _queue_.push_back(std::move(task));
+
+            // A worker blocked in Get may be the only one able to run it. Every helper is told: the
+            // first one registered may be an outer Get of a worker now blocked in a nested one, or
+            // busy running a task. Helpers that aren't asleep only count the signal.
+            for (_InternalWaiter* helper : _helpers_)
+                helper->_signal();
         }
-        else if (_state_->_chained_promise_)
+
+        _cv_queue_.notify_one();
+    }
+
+    bool ThreadPool::_runOne()
+    {
+        Task task;
+
+        // Scope for lock
         {
-            _state_->_chained_promise_->SetDone();
+            std::unique_lock lck(_mtx_queue_);
+
+            if (_queue_.empty())
+                return false;
+
+            task = std::move(_queue_.front());
+            _queue_.pop_front();
         }
-        else // Otherwise set the value in the state normally
+
+        task();
+        return true;
+    }
+
+    void ThreadPool::_workerLoop()
+    {
+        _current_pool_ = this;
+
+        while (true)
         {
-            _state_->_value_.emplace();
-            _state_->_cv_value_.notify_all();
+            Task task;
+
+            // Scope for lock
+            {
+                std::unique_lock lck(_mtx_queue_);
+
+                while (_queue_.empty() && !_stopping_)
+                {
+                    _cv_queue_.wait(lck);
+                }
+
+                // Keep going until the queue is drained even when stopping
+                if (_queue_.empty())
+                    return;
+
+                task = std::move(_queue_.front());
+                _queue_.pop_front();
+            }
+
+            task();
         }
     }
 
-    Future<void>& Future<void>::operator=(Future<void>&& other) noexcept
+    namespace
     {
-        if (_state_)
-            _state_->_release();
+        // Single thread completing the promises of _internal_delay at their deadlines. It is stopped
+        // when the process exits, timers still pending then never complete.
+        class _DelayQueue
+        {
+        private:
+
+            std::mutex                                                          _mtx_;
+            std::condition_variable                                             _cv_;
+            std::multimap<std::chrono::steady_clock::time_point, Promise<void>> _timers_;
+            bool                                                                _stopping_ = false;
+            std::thread                                                         _thread_;
+
+            void _loop()
+            {
+                std::unique_lock lck(_mtx_);
+
+                while (!_stopping_)
+                {
+                    if (_timers_.empty())
+                    {
+                        _cv_.wait(lck);
+                        continue;
+                    }
+
+                    auto first = _timers_.begin();
+
+                    if (std::chrono::steady_clock::now() < first->first)
+                    {
+                        _cv_.wait_until(lck, first->first);
+                        continue;
+                    }
+
+                    Promise<void> promise = std::move(first->second);
+                    _timers_.erase(first);
+
+                    lck.unlock();
+                    promise.SetDone();
+                    lck.lock();
+                }
+            }
+
+        public:
+
+            _DelayQueue()
+                : _thread_([this]()
+                    {
+                        _loop();
+                    })
+            { }
+
+            // Leaves the pending promises alone, breaking them would run their continuations
+            void _stop()
+            {
+                // Scope for lock
+                {
+                    std::unique_lock lck(_mtx_);
+                    _stopping_ = true;
+                }
+
+                _cv_.notify_one();
+
+                // exit called from a timer continuation
+                if (_thread_.get_id() == std::this_thread::get_id())
+                    _thread_.detach();
+                else
+                    _thread_.join();
+            }
+
+            Future<void> _add(std::chrono::steady_clock::duration delay)
+            {
+                Promise<void> promise;
+                Future<void> fut = promise.GetFuture();
+                bool earliest = false;
+
+                // Scope for lock
+                {
+                    std::unique_lock lck(_mtx_);
+                    auto it = _timers_.emplace(std::chrono::steady_clock::now() + delay, std::move(promise));
+                    earliest = it == _timers_.begin();
+                }
+
+                // Only a new first deadline changes how long the thread has to sleep
+                if (earliest)
+                    _cv_.notify_one();
+
+                return fut;
+            }
+        };
+    }
+
+    Future<void> _internal_delay(std::chrono::steady_clock::duration delay)
+    {
+        // Never destroyed: that would break the promises of pending timers during static destruction,
+        // running their continuations while the objects they use are torn down. The thread is only
+        // stopped, so no timer fires while statics are destroyed either.
+        static _DelayQueue* queue = []()
+            {
+                _DelayQueue* created = new _DelayQueue();
+
+                std::atexit([]()
+                    {
+                        queue->_stop();
+                    });
+
+                return created;
+            }();
 
-        _state_ = other._state_;
-        other._state_ = nullptr;
-        return *this;
+        return queue->_add(delay);
     }
 }
@@ -2,19 +2,73 @@
 
 #include <array>
 #include <atomic>
+#include <cassert>
+#include <chrono>
 #include <condition_variable>
+#include <coroutine>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <span>
 #include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <tuple>
 #include <vector>
 
 namespace TaskStuff
 {
     struct VoidPlaceHolder {};
 
+    // How a value of type ValueT is stored in a state. A Future<T&> only refers to an object owned
+    // elsewhere (e.g. a buffer in an arena), so it is stored as a reference_wrapper and never copied.
+    // For contiguous buffers a Future<std::span<T>> gives the same zero-copy behaviour.
+    template <typename ValueT>
+    struct _internal_storage { using type = ValueT; };
+
+    template <typename ValueT>
+    struct _internal_storage<ValueT&> { using type = std::reference_wrapper<ValueT>; };
+
+    template <>
+    struct _internal_storage<void> { using type = VoidPlaceHolder; };
+
+    template <typename ValueT>
+    using _internal_storage_t = typename _internal_storage<ValueT>::type;
+
+    // Hands a stored value on: values are moved out, references are unwrapped
+    template <typename ValueT>
+    ValueT&& _internal_take_value(_internal_storage_t<ValueT>& stored)
+    {
+        if constexpr (std::is_reference_v<ValueT>)
+            return stored.get();
+        else
+            return std::move(stored);
+    }
+
+    // Default constructible slot that combinators collect a ValueT into, references are kept as pointers
+    template <typename ValueT>
+    using _internal_slot_t = std::conditional_t<std::is_reference_v<ValueT>, std::remove_reference_t<ValueT>*, ValueT>;
+
+    template <typename ValueT>
+    void _internal_fill_slot(_internal_slot_t<ValueT>& slot, ValueT&& value)
+    {
+        if constexpr (std::is_reference_v<ValueT>)
+            slot = &value;
+        else
+            slot = std::move(value);
+    }
+
+    template <typename ValueT>
+    ValueT&& _internal_take_slot(_internal_slot_t<ValueT>& slot)
+    {
+        if constexpr (std::is_reference_v<ValueT>)
+            return *slot;
+        else
+            return std::move(slot);
+    }
+
     template <typename FnT, typename ArgumentT>
     struct _internal_invoke_result
     {
@@ -30,6 +84,87 @@ namespace TaskStuff
     template <typename FnT, typename ArgumentT>
     using _internal_invoke_result_t = typename _internal_invoke_result<FnT, ArgumentT>::type;
 
+    // True when neither calling the continuation function nor handing its result on can throw
+    template <typename FnT, typename ArgumentT>
+    struct _internal_is_nothrow_continuation
+    {
+        using result_type = _internal_invoke_result_t<FnT, ArgumentT>;
+
+        static constexpr bool value =
+            std::is_nothrow_invocable_v<FnT&, ArgumentT> &&
+            (std::is_same_v<result_type, void> || std::is_nothrow_move_constructible_v<result_type>);
+    };
+
+    template <typename FnT>
+    struct _internal_is_nothrow_continuation<FnT, void>
+    {
+        using result_type = _internal_invoke_result_t<FnT, void>;
+
+        static constexpr bool value =
+            std::is_nothrow_invocable_v<FnT&> &&
+            (std::is_same_v<result_type, void> || std::is_nothrow_move_constructible_v<result_type>);
+    };
+
+    template <typename FnT, typename ArgumentT>
+    constexpr bool _internal_is_nothrow_continuation_v = _internal_is_nothrow_continuation<FnT, ArgumentT>::value;
+
+    // Runs call and routes anything it throws to the promise. Returns false if it threw.
+    // When call is noexcept no exception handling code is generated at all.
+    template <typename PromiseT, typename CallT>
+    bool _internal_guarded_call(PromiseT& promise, CallT const& call)
+    {
+        if constexpr (std::is_nothrow_invocable_v<CallT const&>)
+        {
+            call();
+            return true;
+        }
+        else
+        {
+            try
+            {
+                call();
+                return true;
+            }
+            catch (...)
+            {
+                promise.SetException(std::current_exception());
+                return false;
+            }
+        }
+    }
+
+    // Hands what call returns to the promise, or what it throws. Only call itself runs in the
+    // noexcept scope of a nothrow continuation: fulfilling the promise may still throw (locking
+    // its state for instance) and that is routed to the promise as well.
+    template <typename PromiseT, typename CallT>
+    void _internal_call_continuation(PromiseT& promise, CallT const& call)
+    {
+        using resultType = std::invoke_result_t<CallT const&>;
+
+        if constexpr (std::is_nothrow_invocable_v<CallT const&> && std::is_same_v<resultType, void>)
+        {
+            call();
+            _internal_guarded_call(promise, [&promise]() { promise.SetDone(); });
+        }
+        else if constexpr (std::is_nothrow_invocable_v<CallT const&>)
+        {
+            resultType value = call();
+            _internal_guarded_call(promise, [&promise, &value]() { promise.SetValue(static_cast<resultType&&>(value)); });
+        }
+        else if constexpr (std::is_same_v<resultType, void>)
+        {
+            _internal_guarded_call(promise, [&promise, &call]()
+                {
+                    call();
+                    promise.SetDone();
+                });
+        }
+        else
+        {
+            _internal_guarded_call(promise, [&promise, &call]() { promise.SetValue(call()); });
+        }
+    }
+
     enum class FutureErrorCode : int32_t
     {
         None                    = 0,
@@ -37,7 +172,10 @@ namespace TaskStuff
         BrokenPromise           = 1,
         FutureAlreadyRetrieved  = 2,
         PromiseAlreadySatisfied = 3,
-        NoState                 = 4
+        NoState                 = 4,
+        WouldDeadlock           = 5,
+        InvalidErrorCode        = 6,
+        ChannelClosed           = 7
     };
 
     class FutureError : public std::runtime_error
@@ -76,21 +214,329 @@ namespace TaskStuff
         }
     };
 
+    // Outcome of a future: the value, the exception or the error code it failed with.
+    // Inspecting a Result never throws, only Get() does if there is no value.
     template <typename ValueT>
+    class Result
+    {
+    private:
+
+        std::optional<_internal_storage_t<ValueT>> _value_;
+        std::exception_ptr                         _exception_;
+        std::error_code                            _error_;
+
+    public:
+
+        using value_type = ValueT;
+
+        explicit Result(std::exception_ptr exception)
+            : _exception_(exception)
+        { }
+
+        explicit Result(std::error_code error) noexcept
+            : _error_(error)
+        { }
+
+        template <typename... ArgsT>
+        explicit Result(std::in_place_t, ArgsT&&... args)
+            : _value_(std::in_place, std::forward<ArgsT>(args)...)
+        { }
+
+        bool HasValue() const
+        {
+            return _value_.has_value();
+        }
+
+        bool HasException() const
+        {
+            return static_cast<bool>(_exception_);
+        }
+
+        std::exception_ptr GetException() const
+        {
+            return _exception_;
+        }
+
+        bool HasError() const noexcept
+        {
+            return static_cast<bool>(_error_);
+        }
+
+        std::error_code GetError() const noexcept
+        {
+            return _error_;
+        }
+
+        // Hands the value on, rethrows the exception or throws the error code as a std::system_error
+        ValueT Get()
+        {
+            if (_exception_)
+            {
+                std::rethrow_exception(_exception_);
+            }
+
+            if (_error_)
+            {
+                throw std::system_error(_error_);
+            }
+
+            if constexpr (!std::is_same_v<ValueT, void>)
+            {
+                return _internal_take_value<ValueT>(*_value_);
+            }
+        }
+    };
+
+    // Plain value with the subset of the std::atomic interface used by the single threaded policy
+    template <typename T>
+    class _NonAtomic
+    {
+    private:
+
+        T _value_;
+
+    public:
+
+        _NonAtomic(T value = T())
+            : _value_(value)
+        { }
+
+        _NonAtomic& operator=(T value)
+        {
+            _value_ = value;
+            return *this;
+        }
+
+        operator T() const { return _value_; }
+
+        T operator++() { return ++_value_; }
+        T operator--() { return --_value_; }
+
+        T load(std::memory_order = std::memory_order_seq_cst) const { return _value_; }
+        void store(T value, std::memory_order = std::memory_order_seq_cst) { _value_ = value; }
+    };
+
+    // Lockable that does no locking. In debug builds it asserts that it's only ever used from one thread.
+    class _SingleThreadMutex
+    {
+    private:
+
+#ifndef NDEBUG
+        std::thread::id _owner_;
+#endif
+
+    public:
+
+        void lock()
+        {
+#ifndef NDEBUG
+            if (_owner_ == std::thread::id())
+                _owner_ = std::this_thread::get_id();
+
+            assert(_owner_ == std::this_thread::get_id() && "Single threaded future used from more than one thread!");
+#endif
+        }
+
+        bool try_lock()
+        {
+            lock();
+            return true;
+        }
+
+        void unlock()
+        { }
+    };
+
+    class _SingleThreadConditionVariable
+    {
+    public:
+
+        void notify_one() { }
+        void notify_all() { }
+
+        // Nothing else can fulfil the promise while the only thread is blocked here
+        template <typename LockT>
+        void wait(LockT&)
+        {
+            throw FutureError(FutureErrorCode::WouldDeadlock, "Waiting on a single threaded future that isn't ready!");
+        }
+    };
+
+    // Synchronization policy for futures that can be shared between threads (the default)
+    struct MultiThreaded
+    {
+        template <typename T>
+        using atomic_type = std::atomic<T>;
+
+        using mutex_type              = std::mutex;
+        using condition_variable_type = std::condition_variable;
+    };
+
+    // Synchronization policy for futures that are created, fulfilled and consumed on a single thread,
+    // e.g. an event loop. Reference counting and locking compile down to plain operations.
+    struct SingleThreaded
+    {
+        template <typename T>
+        using atomic_type = _NonAtomic<T>;
+
+        using mutex_type              = _SingleThreadMutex;
+        using condition_variable_type = _SingleThreadConditionVariable;
+    };
+
+    template <typename ValueT, typename SyncT>
     class _InternalFutureBase;
 
-    template <typename ValueT>
+    template <typename ValueT, typename SyncT>
     class _InternalPromiseBase;
 
-    template <typename ValueT>
+    template <typename ValueT, typename SyncT = MultiThreaded>
     class Future;
 
-    template <typename ValueT>
+    template <typename ValueT, typename SyncT = MultiThreaded>
     class Promise;
 
+    template <typename ValueT>
+    using LocalFuture = Future<ValueT, SingleThreaded>;
+
+    template <typename ValueT>
+    using LocalPromise = Promise<ValueT, SingleThreaded>;
+
     template <typename ValueT>
     class PersistentFuture;
 
+    template <typename ValueT>
+    class SharedFuture;
+
+    // Completes every promise with the stored value. All but the last get a copy, the last one
+    // gets the value moved. If a copy throws, that branch and the ones after it get the exception.
+    template <typename ValueT, typename SyncT, size_t N>
+    void _internal_fan_out(std::array<Promise<ValueT, SyncT>, N>& promises, _internal_storage_t<ValueT>& stored)
+    {
+        if constexpr (std::is_same_v<ValueT, void>)
+        {
+            for (auto& promise : promises)
+                promise.SetDone();
+        }
+        else if constexpr (std::is_reference_v<ValueT>)
+        {
+            for (auto& promise : promises)
+                promise.SetValue(stored.get());
+        }
+        else if constexpr (std::is_nothrow_copy_constructible_v<ValueT>)
+        {
+            for (size_t i = 0; i + 1 < N; ++i)
+                promises[i].SetValue(static_cast<ValueT const&>(stored));
+
+            promises[N - 1].SetValue(_internal_take_value<ValueT>(stored));
+        }
+        else
+        {
+            size_t i = 0;
+
+            try
+            {
+                for (; i + 1 < N; ++i)
+                    promises[i].SetValue(static_cast<ValueT const&>(stored));
+            }
+            catch (...)
+            {
+                for (; i < N; ++i)
+                    promises[i].SetException(std::current_exception());
+
+                return;
+            }
+
+            promises[N - 1].SetValue(_internal_take_value<ValueT>(stored));
+        }
+    }
+
+    // How far a state has got, published with release semantics once the outcome is stored
+    enum class _InternalFutureStatus : uint8_t
+    {
+        Pending,
+        Value,
+        Exception,
+        Error
+    };
+
+    // Both defined in task_stuff.cpp, used by blocking waits to keep ThreadPool workers busy
+    bool _internal_on_pool_thread();
+
+    // Runs one queued task of the pool the calling worker belongs to, false if there was none
+    bool _internal_help_current_pool();
+
+    class _InternalWaiter;
+
+    // While registered, waiter is signalled whenever a task is queued on the calling worker's pool
+    void _internal_watch_current_pool(_InternalWaiter* waiter);
+    void _internal_unwatch_current_pool(_InternalWaiter* waiter);
+
+    // Lets one thread block on many states at once. Every state it is attached to signals it once
+    // on completion, so waiting on N futures takes one condition variable instead of N.
+    class _InternalWaiter
+    {
+    private:
+
+        std::mutex              _mtx_;
+        std::condition_variable _cv_;
+        size_t                  _signal_count_ = 0;
+
+    public:
+
+        // Called by a state with its own lock held, detaching takes that lock too so the
+        // waiter can't go away while a state is signalling it
+        void _signal()
+        {
+            std::unique_lock lck(_mtx_);
+            ++_signal_count_;
+            _cv_.notify_one();
+        }
+
+        size_t _signals()
+        {
+            std::unique_lock lck(_mtx_);
+            return _signal_count_;
+        }
+
+        void _wait(size_t count)
+        {
+            std::unique_lock lck(_mtx_);
+            _cv_.wait(lck, [this, count]() { return _signal_count_ >= count; });
+        }
+
+        bool _waitUntil(size_t count, std::chrono::steady_clock::time_point deadline)
+        {
+            std::unique_lock lck(_mtx_);
+            return _cv_.wait_until(lck, deadline, [this, count]() { return _signal_count_ >= count; });
+        }
+
+        // A future that has already completed counts as a signal
+        template <typename FutureT>
+        void _attach(FutureT& fut)
+        {
+            if (fut._attachWaiter(this))
+                _signal();
+        }
+
+        template <typename FutureT>
+        void _detach(FutureT& fut)
+        {
+            fut._detachWaiter();
+        }
+    };
+
+    // Calls an OnComplete continuation and hands what it returns (or throws) to its promise
+    template <typename FnT, typename ValueT, typename SyncT>
+    void _internal_call_on_complete(FnT& fn, Result<ValueT>&& result, Promise<_internal_invoke_result_t<FnT, Result<ValueT>>, SyncT>& promise)
+    {
+        using resultType = _internal_invoke_result_t<FnT, Result<ValueT>>;
+
+        _internal_call_continuation(promise, [&fn, &result]() noexcept(_internal_is_nothrow_continuation_v<FnT, Result<ValueT>>) -> resultType
+            {
+                return fn(std::move(result));
+            });
+    }
+
     class _InternalCallableHolder
     {
         class _InternalIfc
@@ -99,6 +545,7 @@ namespace TaskStuff
 
             virtual void Call() = 0;
             virtual void SetException(std::exception_ptr e) = 0;
+            virtual void SetError(std::error_code code) = 0;
             virtual _InternalIfc* MoveTo(void* dest) = 0;
             virtual ~_InternalIfc() {}
         };
@@ -183,30 +630,33 @@ namespace TaskStuff
             _internal_instance_->SetException(e);
         }
 
-        template <typename ArgumentT>
+        void SetError(std::error_code code)
+        {
+            _internal_instance_->SetError(code);
+        }
+
+        template <typename ArgumentT, bool = std::is_same_v<ArgumentT, void>>
         class _ArgumentHolder
         {
         protected:
 
-            ArgumentT _argument_value_;
+            // Only engaged once the value arrives so ArgumentT doesn't have to be default constructible
+            std::optional<_internal_storage_t<ArgumentT>> _argument_value_;
 
         public:
 
-            _ArgumentHolder()
-                : _argument_value_(ArgumentT())
-            { }
-
-            void SetValue(ArgumentT val)
+            template <typename... ArgsT>
+            void SetValue(ArgsT&&... args)
             {
-                _argument_value_ = std::move(val);
+                _argument_value_.emplace(std::forward<ArgsT>(args)...);
             }
         };
 
-        template <>
-        class _ArgumentHolder<void>
+        template <typename ArgumentT>
+        class _ArgumentHolder<ArgumentT, true>
         { };
 
-        template <typename FnT, typename ArgumentT>
+        template <typename FnT, typename ArgumentT, typename SyncT>
         class _FunctionHolder final : public _InternalIfc, public _ArgumentHolder<ArgumentT>
         {
         private:
@@ -214,30 +664,27 @@ namespace TaskStuff
             using result_type = _internal_invoke_result_t<FnT, ArgumentT>;
 
             FnT                  _fn_;
-            Promise<result_type> _result_promise_;
+            Promise<result_type, SyncT> _result_promise_;
 
             _FunctionHolder(_FunctionHolder const&) = delete;
             _FunctionHolder& operator=(_FunctionHolder const&) = delete;
 
         public:
 
-            _FunctionHolder(FnT fn, Promise<result_type> resultPromise)
+            _FunctionHolder(FnT fn, Promise<result_type, SyncT> resultPromise)
                 : _fn_(std::move(fn))
                 , _result_promise_(std::move(resultPromise))
             { }
 
             _FunctionHolder(_FunctionHolder&& other)
-                : _fn_(std::move(other._fn_))
+                : _ArgumentHolder<ArgumentT>(std::move(other))
+                , _fn_(std::move(other._fn_))
                 , _result_promise_(std::move(other._result_promise_))
-            {
-                if constexpr (!std::is_same_v<ArgumentT, void>)
-                    _ArgumentHolder<ArgumentT>::_argument_value_ = std::move(other._argument_value_);
-            }
+            { }
 
             _FunctionHolder& operator=(_FunctionHolder&& other)
             {
-                if constexpr (!std::is_same_v<ArgumentT, void>)
-                    _ArgumentHolder<ArgumentT>::_argument_value_ = std::move(other._argument_value_);
+                _ArgumentHolder<ArgumentT>::operator=(std::move(other));
 
                 _fn_ = std::move(other._fn_);
                 _result_promise_ = std::move(other._result_promise_);
@@ -247,37 +694,17 @@ namespace TaskStuff
 
             void Call() override
             {
-                try
-                {
-                    if constexpr (std::is_same_v<result_type, void>)
-                    {
-                        if constexpr (std::is_same_v<ArgumentT, void>)
-                        {
-                            _fn_();
-                        }
-                        else
-                        {
-                            _fn_(std::move(_ArgumentHolder<ArgumentT>::_argument_value_));
-                        }
-
-                        _result_promise_.SetDone();
-                    }
-                    else
+                _internal_call_continuation(_result_promise_, [this]() noexcept(_internal_is_nothrow_continuation_v<FnT, ArgumentT>) -> result_type
                     {
                         if constexpr (std::is_same_v<ArgumentT, void>)
                         {
-                            _result_promise_.SetValue(_fn_());
+                            return _fn_();
                         }
                         else
                         {
-                            _result_promise_.SetValue(_fn_(std::move(_ArgumentHolder<ArgumentT>::_argument_value_)));
+                            return _fn_(_internal_take_value<ArgumentT>(*_ArgumentHolder<ArgumentT>::_argument_value_));
                         }
-                    }
-                }
-                catch (...)
-                {
-                    _result_promise_.SetException(std::current_exception());
-                }
+                    });
             }
 
             void SetException(std::exception_ptr e) override
@@ -285,14 +712,19 @@ namespace TaskStuff
                 _result_promise_.SetException(e);
             }
 
+            void SetError(std::error_code code) override
+            {
+                _result_promise_.SetError(code);
+            }
+
             _InternalIfc* MoveTo(void* dest) override
             {
                 // Placement new on buffer
-                return new (dest) _FunctionHolder<FnT, ArgumentT>(std::move(*this));
+                return new (dest) _FunctionHolder<FnT, ArgumentT, SyncT>(std::move(*this));
             }
         };
 
-        template <typename FnT, typename ArgumentT>
+        template <typename FnT, typename ArgumentT, typename SyncT>
         class _ChainedFunctionHolder final : public _InternalIfc, public _ArgumentHolder<ArgumentT>
         {
         private:
@@ -301,31 +733,28 @@ namespace TaskStuff
             using result_type = typename lower_future_type::value_type;
 
             FnT                  _fn_;
-            Promise<result_type> _result_promise_;
+            Promise<result_type, SyncT> _result_promise_;
 
             _ChainedFunctionHolder(_ChainedFunctionHolder const&) = delete;
             _ChainedFunctionHolder& operator=(_ChainedFunctionHolder const&) = delete;
 
         public:
 
-            _ChainedFunctionHolder(FnT fn, Promise<result_type> resultPromise)
+            _ChainedFunctionHolder(FnT fn, Promise<result_type, SyncT> resultPromise)
                 : _fn_(std::move(fn))
                 , _result_promise_(std::move(resultPromise))
             {
             }
 
             _ChainedFunctionHolder(_ChainedFunctionHolder&& other)
-                : _fn_(std::move(other._fn_))
+                : _ArgumentHolder<ArgumentT>(std::move(other))
+                , _fn_(std::move(other._fn_))
                 , _result_promise_(std::move(other._result_promise_))
-            {
-                if constexpr (!std::is_same_v<ArgumentT, void>)
-                    _ArgumentHolder<ArgumentT>::_argument_value_ = std::move(other._argument_value_);
-            }
+            { }
 
             _ChainedFunctionHolder& operator=(_ChainedFunctionHolder&& other)
             {
-                if constexpr (!std::is_same_v<ArgumentT, void>)
-                    _ArgumentHolder<ArgumentT>::_argument_value_ = std::move(other._argument_value_);
+                _ArgumentHolder<ArgumentT>::operator=(std::move(other));
 
                 _fn_ = std::move(other._fn_);
                 _result_promise_ = std::move(other._result_promise_);
@@ -336,18 +765,17 @@ namespace TaskStuff
             void Call() override
             {
                 lower_future_type lowerFuture;
-                try
-                {
-                    if constexpr (std::is_same_v<ArgumentT, void>)
-                        lowerFuture = _fn_();
-                    else
-                        lowerFuture = _fn_(std::move(_ArgumentHolder<ArgumentT>::_argument_value_));
-                }
-                catch (...)
-                {
-                    _result_promise_.SetException(std::current_exception());
-                    return;
-                }
+
+                bool called = _internal_guarded_call(_result_promise_, [this, &lowerFuture]() noexcept(_internal_is_nothrow_continuation_v<FnT, ArgumentT>)
+                    {
+                        if constexpr (std::is_same_v<ArgumentT, void>)
+                            lowerFuture = _fn_();
+                        else
+                            lowerFuture = _fn_(_internal_take_value<ArgumentT>(*_ArgumentHolder<ArgumentT>::_argument_value_));
+                    });
+
+                if (!called)
+                    return;
 
                 // "Chain" our promise to the Future returned from the continuation function
                 lowerFuture._setChainedPromise(std::move(_result_promise_));
@@ -358,49 +786,200 @@ namespace TaskStuff
                 _result_promise_.SetException(e);
             }
 
+            void SetError(std::error_code code) override
+            {
+                _result_promise_.SetError(code);
+            }
+
+            _InternalIfc* MoveTo(void* dest) override
+            {
+                // Placement new on buffer
+                return new (dest) _ChainedFunctionHolder<FnT, ArgumentT, SyncT>(std::move(*this));
+            }
+        };
+
+        template <typename FnT, typename ArgumentT, typename SyncT>
+        class _CompletionHolder final : public _InternalIfc, public _ArgumentHolder<ArgumentT>
+        {
+        private:
+
+            using result_type = _internal_invoke_result_t<FnT, Result<ArgumentT>>;
+
+            FnT                         _fn_;
+            Promise<result_type, SyncT> _result_promise_;
+
+            _CompletionHolder(_CompletionHolder const&) = delete;
+            _CompletionHolder& operator=(_CompletionHolder const&) = delete;
+
+        public:
+
+            _CompletionHolder(FnT fn, Promise<result_type, SyncT> resultPromise)
+                : _fn_(std::move(fn))
+                , _result_promise_(std::move(resultPromise))
+            { }
+
+            _CompletionHolder(_CompletionHolder&& other)
+                : _ArgumentHolder<ArgumentT>(std::move(other))
+                , _fn_(std::move(other._fn_))
+                , _result_promise_(std::move(other._result_promise_))
+            { }
+
+            void Call() override
+            {
+                if constexpr (std::is_same_v<ArgumentT, void>)
+                    _internal_call_on_complete(_fn_, Result<ArgumentT>(std::in_place), _result_promise_);
+                else
+                    _internal_call_on_complete(_fn_, Result<ArgumentT>(std::in_place, _internal_take_value<ArgumentT>(*_ArgumentHolder<ArgumentT>::_argument_value_)), _result_promise_);
+            }
+
+            void SetException(std::exception_ptr e) override
+            {
+                _internal_call_on_complete(_fn_, Result<ArgumentT>(e), _result_promise_);
+            }
+
+            void SetError(std::error_code code) override
+            {
+                _internal_call_on_complete(_fn_, Result<ArgumentT>(code), _result_promise_);
+            }
+
+            _InternalIfc* MoveTo(void* dest) override
+            {
+                // Placement new on buffer
+                return new (dest) _CompletionHolder<FnT, ArgumentT, SyncT>(std::move(*this));
+            }
+        };
+
+        template <typename ValueT, size_t N, typename SyncT>
+        class _SplitHolder final : public _InternalIfc, public _ArgumentHolder<ValueT>
+        {
+        private:
+
+            std::array<Promise<ValueT, SyncT>, N> _result_promises_;
+
+            _SplitHolder(_SplitHolder const&) = delete;
+            _SplitHolder& operator=(_SplitHolder const&) = delete;
+
+        public:
+
+            _SplitHolder(std::array<Promise<ValueT, SyncT>, N> resultPromises)
+                : _result_promises_(std::move(resultPromises))
+            { }
+
+            _SplitHolder(_SplitHolder&& other)
+                : _ArgumentHolder<ValueT>(std::move(other))
+                , _result_promises_(std::move(other._result_promises_))
+            { }
+
+            void Call() override
+            {
+                if constexpr (std::is_same_v<ValueT, void>)
+                {
+                    VoidPlaceHolder done;
+                    _internal_fan_out<ValueT>(_result_promises_, done);
+                }
+                else
+                {
+                    _internal_fan_out<ValueT>(_result_promises_, *_ArgumentHolder<ValueT>::_argument_value_);
+                }
+            }
+
+            void SetException(std::exception_ptr e) override
+            {
+                for (auto& promise : _result_promises_)
+                    promise.SetException(e);
+            }
+
+            void SetError(std::error_code code) override
+            {
+                for (auto& promise : _result_promises_)
+                    promise.SetError(code);
+            }
+
             _InternalIfc* MoveTo(void* dest) override
             {
                 // Placement new on buffer
-                return new (dest) _ChainedFunctionHolder<FnT, ArgumentT>(std::move(*this));
+                return new (dest) _SplitHolder<ValueT, N, SyncT>(std::move(*this));
             }
         };
 
-        template <typename FnT, typename ValueT>
-        _FunctionHolder<FnT, ValueT>* Init(FnT fn, Promise<_internal_invoke_result_t<FnT, ValueT>> resultPromise)
+        template <typename FnT, typename ValueT, typename SyncT>
+        _FunctionHolder<FnT, ValueT, SyncT>* Init(FnT fn, Promise<_internal_invoke_result_t<FnT, ValueT>, SyncT> resultPromise)
+        {
+            _clear();
+
+            _FunctionHolder<FnT, ValueT, SyncT>* ret = nullptr;
+
+            // TODO: Check/handle aligments
+            if constexpr (sizeof(_FunctionHolder<FnT, ValueT, SyncT>) <= INTERNAL_BUFFER_SIZE)
+            {
+                ret = new (_buf_.data()) _FunctionHolder<FnT, ValueT, SyncT>(std::move(fn), std::move(resultPromise));
+            }
+            else
+            {
+                ret = new _FunctionHolder<FnT, ValueT, SyncT>(std::move(fn), std::move(resultPromise));
+            }
+
+            _internal_instance_ = ret;
+            return ret;
+        }
+
+        template <typename FnT, typename ValueT, typename SyncT>
+        _ChainedFunctionHolder<FnT, ValueT, SyncT>* InitChained(FnT fn, Promise<typename _internal_invoke_result_t<FnT, ValueT>::value_type, SyncT> resultPromise)
+        {
+            _clear();
+
+            _ChainedFunctionHolder<FnT, ValueT, SyncT>* ret = nullptr;
+
+            // TODO: Check/handle aligments
+            if constexpr (sizeof(_ChainedFunctionHolder<FnT, ValueT, SyncT>) <= INTERNAL_BUFFER_SIZE)
+            {
+                ret = new (_buf_.data()) _ChainedFunctionHolder<FnT, ValueT, SyncT>(std::move(fn), std::move(resultPromise));
+            }
+            else
+            {
+                ret = new _ChainedFunctionHolder<FnT, ValueT, SyncT>(std::move(fn), std::move(resultPromise));
+            }
+
+            _internal_instance_ = ret;
+            return ret;
+        }
+
+        template <typename FnT, typename ValueT, typename SyncT>
+        _CompletionHolder<FnT, ValueT, SyncT>* InitCompletion(FnT fn, Promise<_internal_invoke_result_t<FnT, Result<ValueT>>, SyncT> resultPromise)
         {
             _clear();
 
-            _FunctionHolder<FnT, ValueT>* ret = nullptr;
+            _CompletionHolder<FnT, ValueT, SyncT>* ret = nullptr;
 
             // TODO: Check/handle aligments
-            if constexpr (sizeof(_FunctionHolder<FnT, ValueT>) <= INTERNAL_BUFFER_SIZE)
+            if constexpr (sizeof(_CompletionHolder<FnT, ValueT, SyncT>) <= INTERNAL_BUFFER_SIZE)
             {
-                ret = new (_buf_.data()) _FunctionHolder<FnT, ValueT>(std::move(fn), std::move(resultPromise));
+                ret = new (_buf_.data()) _CompletionHolder<FnT, ValueT, SyncT>(std::move(fn), std::move(resultPromise));
             }
             else
             {
-                ret = new _FunctionHolder<FnT, ValueT>(std::move(fn), std::move(resultPromise));
+                ret = new _CompletionHolder<FnT, ValueT, SyncT>(std::move(fn), std::move(resultPromise));
             }
 
             _internal_instance_ = ret;
             return ret;
         }
 
-        template <typename FnT, typename ValueT>
-        _ChainedFunctionHolder<FnT, ValueT>* InitChained(FnT fn, Promise<typename _internal_invoke_result_t<FnT, ValueT>::value_type> resultPromise)
+        template <typename ValueT, size_t N, typename SyncT>
+        _SplitHolder<ValueT, N, SyncT>* InitSplit(std::array<Promise<ValueT, SyncT>, N> resultPromises)
         {
             _clear();
 
-            _ChainedFunctionHolder<FnT, ValueT>* ret = nullptr;
+            _SplitHolder<ValueT, N, SyncT>* ret = nullptr;
 
             // TODO: Check/handle aligments
-            if constexpr (sizeof(_ChainedFunctionHolder<FnT, ValueT>) <= INTERNAL_BUFFER_SIZE)
+            if constexpr (sizeof(_SplitHolder<ValueT, N, SyncT>) <= INTERNAL_BUFFER_SIZE)
             {
-                ret = new (_buf_.data()) _ChainedFunctionHolder<FnT, ValueT>(std::move(fn), std::move(resultPromise));
+                ret = new (_buf_.data()) _SplitHolder<ValueT, N, SyncT>(std::move(resultPromises));
             }
             else
             {
-                ret = new _ChainedFunctionHolder<FnT, ValueT>(std::move(fn), std::move(resultPromise));
+                ret = new _SplitHolder<ValueT, N, SyncT>(std::move(resultPromises));
             }
 
             _internal_instance_ = ret;
@@ -411,8 +990,8 @@ namespace TaskStuff
     template <typename T>
     struct _is_future { static constexpr bool value = false; };
 
-    template <typename T>
-    struct _is_future<Future<T>> { static constexpr bool value = true; };
+    template <typename T, typename SyncT>
+    struct _is_future<Future<T, SyncT>> { static constexpr bool value = true; };
 
     template <typename T>
     constexpr bool _is_future_v = _is_future<T>::value;
@@ -420,22 +999,41 @@ namespace TaskStuff
     template <typename T>
     constexpr bool _is_not_future_v = !_is_future<T>::value;
 
-    template <typename ValueT>
+    template <typename ValueT, typename SyncT>
     class PromiseFutureState;
 
-    template <typename ValueT>
+    template <typename ValueT, typename SyncT>
     class _InternalFutureBase
     {
     protected:
 
-        PromiseFutureState<ValueT>* _state_;
+        PromiseFutureState<ValueT, SyncT>* _state_;
 
-        template <typename T>
+        template <typename T, typename S>
         friend class PromiseFutureState;
 
         friend class _InternalCallableHolder;
+        friend class _InternalWaiter;
+
+        // Returns true instead of attaching if the state has already completed
+        bool _attachWaiter(_InternalWaiter* waiter)
+        {
+            std::unique_lock lck(_state_->_mtx_value_);
+
+            if (_state_->_isComplete())
+                return true;
+
+            _state_->_waiter_ = waiter;
+            return false;
+        }
+
+        void _detachWaiter()
+        {
+            std::unique_lock lck(_state_->_mtx_value_);
+            _state_->_waiter_ = nullptr;
+        }
 
-        void _setChainedPromise(Promise<ValueT> chainedPromise)
+        void _setChainedPromise(Promise<ValueT, SyncT> chainedPromise)
         {
             if (!_state_)
             {
@@ -443,20 +1041,22 @@ namespace TaskStuff
                 return;
             }
 
+            chainedPromise._collapseChain();
+
             // Scope for lock
             {
                 std::unique_lock lck(_state_->_mtx_value_);
 
-                if (_state_->_exception_)
+                if (_state_->_hasFailed())
                 {
-                    chainedPromise.SetException(_state_->_exception_);
+                    _state_->_forwardFailure(chainedPromise);
                 }
                 else if (_state_->_value_.has_value())
                 {
                     if constexpr (std::is_same_v<ValueT, void>)
                         chainedPromise.SetDone();
                     else
-                        chainedPromise.SetValue(std::move(*_state_->_value_));
+                        chainedPromise.SetValue(_internal_take_value<ValueT>(*_state_->_value_));
                 }
                 else
                 {
@@ -468,6 +1068,82 @@ namespace TaskStuff
             _state_ = nullptr;
         }
 
+        // Moves the value out of the (locked) state and gives up our reference to it.
+        // The value is moved exactly once, the return is elided into the caller.
+        ValueT _takeValue(std::unique_lock<typename SyncT::mutex_type>& lck)
+        {
+            ValueT val = _internal_take_value<ValueT>(*_state_->_value_);
+            lck.unlock();
+
+            _state_->_release();
+            _state_ = nullptr;
+
+            return val;
+        }
+
+        // Blocks until the state completes. A ThreadPool worker runs other queued tasks of its pool
+        // meanwhile, otherwise a pool whose workers all block here never runs the tasks that would
+        // complete them. Define TASK_STUFF_STRICT_POOL_GET to make that a hard error in debug builds.
+        void _waitComplete(std::unique_lock<typename SyncT::mutex_type>& lck)
+        {
+            if constexpr (std::is_same_v<SyncT, MultiThreaded>)
+            {
+                if (!_state_->_isComplete() && _internal_on_pool_thread())
+                {
+#if defined(TASK_STUFF_STRICT_POOL_GET) && !defined(NDEBUG)
+                    throw FutureError(FutureErrorCode::WouldDeadlock, "Blocking on a future from a thread pool worker!");
+#endif
+
+                    // The waiter is signalled by the state completing as well as by tasks being queued
+                    _InternalWaiter waiter;
+                    lck.unlock();
+
+                    if (!_attachWaiter(&waiter))
+                    {
+                        _internal_watch_current_pool(&waiter);
+
+                        while (_state_->_status_.load(std::memory_order_acquire) == _InternalFutureStatus::Pending)
+                        {
+                            size_t signals = waiter._signals();
+
+                            if (_internal_help_current_pool())
+                                continue;
+
+                            // Nothing to run, sleep until we complete or a task is queued
+                            if (_state_->_status_.load(std::memory_order_acquire) == _InternalFutureStatus::Pending)
+                                waiter._wait(signals + 1);
+                        }
+
+                        _internal_unwatch_current_pool(&waiter);
+                        _detachWaiter();
+                    }
+
+                    lck.lock();
+                }
+            }
+
+            while (!_state_->_isComplete())
+            {
+                _state_->_cv_value_.wait(lck);
+            }
+        }
+
+        // Builds the Result of a completed state, a value is moved out. Needs the lock or
+        // an acquire load of the status that saw it complete.
+        Result<ValueT> _takeResult()
+        {
+            if (_state_->_exception_)
+                return Result<ValueT>(_state_->_exception_);
+
+            if (_state_->_error_)
+                return Result<ValueT>(_state_->_error_);
+
+            if constexpr (std::is_same_v<ValueT, void>)
+                return Result<ValueT>(std::in_place);
+            else
+                return Result<ValueT>(std::in_place, _internal_take_value<ValueT>(*_state_->_value_));
+        }
+
         _InternalFutureBase(_InternalFutureBase const&) = delete;
         _InternalFutureBase& operator=(_InternalFutureBase const&) = delete;
 
@@ -490,164 +1166,387 @@ namespace TaskStuff
             return _state_ != nullptr;
         }
 
-        ValueT Get()
+        // Polling accessors, each is a single atomic load and never blocks.
+        // A future without a state is never ready.
+        bool IsReady() const
+        {
+            return _state_ && _state_->_status_.load(std::memory_order_acquire) != _InternalFutureStatus::Pending;
+        }
+
+        bool HasValue() const
+        {
+            return _state_ && _state_->_status_.load(std::memory_order_acquire) == _InternalFutureStatus::Value;
+        }
+
+        bool HasException() const
+        {
+            return _state_ && _state_->_status_.load(std::memory_order_acquire) == _InternalFutureStatus::Exception;
+        }
+
+        bool HasError() const
+        {
+            return _state_ && _state_->_status_.load(std::memory_order_acquire) == _InternalFutureStatus::Error;
+        }
+
+        // Points to the value if it has arrived, nullptr otherwise. The value stays in the future.
+        std::remove_reference_t<ValueT> const* TryGet() const requires (!std::is_same_v<ValueT, void>)
+        {
+            if (!HasValue())
+                return nullptr;
+
+            if constexpr (std::is_reference_v<ValueT>)
+                return &_state_->_value_->get();
+            else
+                return &*_state_->_value_;
+        }
+
+        // Takes the outcome if the future has completed, which consumes the future
+        std::optional<Result<ValueT>> TryTake()
         {
+            if (!IsReady())
+                return std::nullopt;
+
+            std::optional<Result<ValueT>> result(_takeResult());
+
+            _state_->_release();
+            _state_ = nullptr;
+
+            return result;
+        }
+
+        // Turns this future into a SharedFuture that can be copied and continued from any number of times.
+        // Not available for Future<void>, whose continuations have no value to share (see Split).
+        SharedFuture<ValueT> Share() requires (!std::is_same_v<ValueT, void>)
+        {
+            return SharedFuture<ValueT>(std::move(static_cast<Future<ValueT, SyncT>&>(*this)));
+        }
+
+        // Calls fn with a Result holding either the value or the exception the future ends up with.
+        // One continuation covers both outcomes, so there's no need for a Then + OnException pair.
+        template <typename FnT>
+        Future<_internal_invoke_result_t<FnT, Result<ValueT>>, SyncT> OnComplete(FnT fn)
+        {
+            using resultType = _internal_invoke_result_t<FnT, Result<ValueT>>;
+
             if (!_state_)
             {
                 throw FutureError(FutureErrorCode::NoState, "Future has no state!");
             }
 
-            std::conditional_t<std::is_same_v<ValueT, void>, VoidPlaceHolder, ValueT> val;
+            Promise<resultType, SyncT> continuationPromise;
+            auto continuationFuture = continuationPromise.GetFuture();
 
             // Scope for lock
             {
                 std::unique_lock lck(_state_->_mtx_value_);
 
-                while (!_state_->_value_.has_value() && !_state_->_exception_)
+                if (_state_->_isComplete())
                 {
-                    _state_->_cv_value_.wait(lck);
+                    // If the promise has already been fulfilled,
+                    // call the continuation function immediately
+                    _internal_call_on_complete(fn, _takeResult(), continuationPromise);
                 }
-
-                if (_state_->_exception_)
+                else
                 {
-                    std::rethrow_exception(_state_->_exception_);
+                    _state_->_setCompletion(std::move(fn), std::move(continuationPromise));
                 }
-
-                val = std::move(*_state_->_value_);
             }
 
             _state_->_release();
             _state_ = nullptr;
 
-            if constexpr (!std::is_same_v<ValueT, void>)
-                return val;
+            return continuationFuture;
         }
 
-        // If the continuation function itself returns another Future object,
-        // we don't want to end up with something that looks like this on the top level: Future<Future<Future<Future<int>>>>.
-        // This specialization causes the Future on the top level to still be a simple Future<int> that can be awaited.
-        template<typename FnT>
-        std::enable_if_t<
-            _is_future_v<_internal_invoke_result_t<FnT, ValueT>>,
-            _internal_invoke_result_t<FnT, ValueT>> Then(FnT fn)
+        // Passes the value through, or replaces a failure with the value returned by fn(exception_ptr).
+        // An error code is handed to fn as a std::system_error.
+        template <typename FnT>
+        Future<ValueT, SyncT> Recover(FnT fn)
         {
-            using resultType = typename _internal_invoke_result_t<FnT, ValueT>::value_type;
+            return OnComplete([fn = std::move(fn)](Result<ValueT> result) mutable -> ValueT
+                {
+                    if (result.HasException())
+                        return fn(result.GetException());
+
+                    if (result.HasError())
+                        return fn(std::make_exception_ptr(std::system_error(result.GetError())));
 
+                    return result.Get();
+                });
+        }
+
+        // Like Recover, but only for exceptions of type ExceptionT (std::system_error for error codes).
+        // fn gets the caught exception, anything else is passed on to the returned future unchanged.
+        template <typename ExceptionT, typename FnT>
+        Future<ValueT, SyncT> OnError(FnT fn)
+        {
+            return OnComplete([fn = std::move(fn)](Result<ValueT> result) mutable -> ValueT
+                {
+                    if (!result.HasValue())
+                    {
+                        try
+                        {
+                            return result.Get();
+                        }
+                        catch (ExceptionT const& e)
+                        {
+                            return fn(e);
+                        }
+                    }
+
+                    return result.Get();
+                });
+        }
+
+        // Calls fn only if the future ends with an exception (or an error code, as a std::system_error),
+        // a value is dropped
+        template <typename FnT>
+        void OnException(FnT fn)
+        {
             if (!_state_)
             {
-                throw FutureError(FutureErrorCode::NoState, "Future has no state!");
+                // Not really sure if we should throw here or call the function
+                fn(std::make_exception_ptr(FutureError(FutureErrorCode::NoState, "Future has no state!")));
+                return;
             }
 
-            Future<resultType> continuationFuture;
-
             // Scope for lock
             {
                 std::unique_lock lck(_state_->_mtx_value_);
 
                 if (_state_->_exception_)
                 {
-                    Promise<resultType> continuationPromise;
-                    continuationFuture = continuationPromise.GetFuture();
-                    continuationPromise.SetException(_state_->_exception_);
+                    fn(_state_->_exception_);
+                }
+                else if (_state_->_error_)
+                {
+                    fn(std::make_exception_ptr(std::system_error(_state_->_error_)));
                 }
                 else if (_state_->_value_.has_value())
                 {
-                    // If the promise has already been fulfilled,
-                    // call the continuation function immediately
-                    try
-                    {
-                        if constexpr (std::is_same_v<ValueT, void>)
-                        {
-                            continuationFuture = fn();
-                        }
-                        else
-                        {
-                            continuationFuture = fn(std::move(*_state_->_value_));
-                        }
-                    }
-                    catch (...)
-                    {
-                        Promise<resultType> continuationPromise;
-                        continuationFuture = continuationPromise.GetFuture();
-                        continuationPromise.SetException(std::current_exception());
-                    }
+                    // Already complete
                 }
                 else
                 {
-                    Promise<resultType> continuationPromise;
-                    continuationFuture = continuationPromise.GetFuture();
-                    _state_->_setChainedContinuation(std::move(fn), std::move(continuationPromise));
+                    _state_->_on_exception_ = std::move(fn);
                 }
             }
 
             _state_->_release();
             _state_ = nullptr;
-
-            return continuationFuture;
         }
 
-        template<typename FnT>
-        std::enable_if_t<
-            _is_not_future_v<_internal_invoke_result_t<FnT, ValueT>>,
-            Future<_internal_invoke_result_t<FnT, ValueT>>> Then(FnT fn)
+        // Fans the result out to N futures, for forks that are too small to be worth a SharedFuture.
+        // The value is copied into all but the last branch, which gets it moved.
+        template <size_t N>
+        std::array<Future<ValueT, SyncT>, N> Split()
         {
-            using resultType = _internal_invoke_result_t<FnT, ValueT>;
+            static_assert(N >= 2 && N <= 8, "Split supports between 2 and 8 branches!");
+            static_assert(std::is_void_v<ValueT> || std::is_reference_v<ValueT> || std::is_copy_constructible_v<ValueT>,
+                "Split needs a copyable value, use Share() for move-only types!");
 
             if (!_state_)
             {
                 throw FutureError(FutureErrorCode::NoState, "Future has no state!");
             }
 
-            Promise<resultType> continuationPromise;
-            auto continuationFuture = continuationPromise.GetFuture();
+            std::array<Promise<ValueT, SyncT>, N> splitPromises;
+            std::array<Future<ValueT, SyncT>, N> splitFutures;
+
+            for (size_t i = 0; i < N; ++i)
+                splitFutures[i] = splitPromises[i].GetFuture();
 
             // Scope for lock
             {
                 std::unique_lock lck(_state_->_mtx_value_);
-                
-                if (_state_->_exception_)
+
+                if (_state_->_hasFailed())
+                {
+                    for (auto& promise : splitPromises)
+                        _state_->_forwardFailure(promise);
+                }
+                else if (_state_->_value_.has_value())
+                {
+                    _internal_fan_out<ValueT>(splitPromises, *_state_->_value_);
+                }
+                else
+                {
+                    _state_->_setSplit(std::move(splitPromises));
+                }
+            }
+
+            _state_->_release();
+            _state_ = nullptr;
+
+            return splitFutures;
+        }
+
+        ValueT Get()
+        {
+            if (!_state_)
+            {
+                throw FutureError(FutureErrorCode::NoState, "Future has no state!");
+            }
+
+            std::unique_lock lck(_state_->_mtx_value_);
+            _waitComplete(lck);
+
+            if (_state_->_exception_)
+            {
+                std::rethrow_exception(_state_->_exception_);
+            }
+
+            if (_state_->_error_)
+            {
+                throw std::system_error(_state_->_error_);
+            }
+
+            if constexpr (std::is_same_v<ValueT, void>)
+            {
+                lck.unlock();
+
+                _state_->_release();
+                _state_ = nullptr;
+            }
+            else
+            {
+                return _takeValue(lck);
+            }
+        }
+
+        // Waits like Get, but a failure is returned in the Result instead of being thrown
+        Result<ValueT> GetResult()
+        {
+            if (!_state_)
+            {
+                throw FutureError(FutureErrorCode::NoState, "Future has no state!");
+            }
+
+            std::unique_lock lck(_state_->_mtx_value_);
+            _waitComplete(lck);
+
+            Result<ValueT> result = _takeResult();
+            lck.unlock();
+
+            _state_->_release();
+            _state_ = nullptr;
+
+            return result;
+        }
+
+        // If the continuation function itself returns another Future object,
+        // we don't want to end up with something that looks like this on the top level: Future<Future<Future<Future<int>>>>.
+        // This specialization causes the Future on the top level to still be a simple Future<int> that can be awaited.
+        template<typename FnT>
+        std::enable_if_t<
+            _is_future_v<_internal_invoke_result_t<FnT, ValueT>>,
+            Future<typename _internal_invoke_result_t<FnT, ValueT>::value_type, SyncT>> Then(FnT fn)
+        {
+            using resultType = typename _internal_invoke_result_t<FnT, ValueT>::value_type;
+
+            if (!_state_)
+            {
+                throw FutureError(FutureErrorCode::NoState, "Future has no state!");
+            }
+
+            Future<resultType, SyncT> continuationFuture;
+
+            // Scope for lock
+            {
+                std::unique_lock lck(_state_->_mtx_value_);
+
+                if (_state_->_hasFailed())
                 {
-                    continuationPromise.SetException(_state_->_exception_);
+                    Promise<resultType, SyncT> continuationPromise;
+                    continuationFuture = continuationPromise.GetFuture();
+                    _state_->_forwardFailure(continuationPromise);
                 }
                 else if (_state_->_value_.has_value())
                 {
                     // If the promise has already been fulfilled,
                     // call the continuation function immediately
-                    try
+                    auto callContinuation = [this, &fn, &continuationFuture]() noexcept(_internal_is_nothrow_continuation_v<FnT, ValueT>)
                     {
-                        if constexpr (std::is_same_v<resultType, void>)
+                        if constexpr (std::is_same_v<ValueT, void>)
                         {
-                            if constexpr (std::is_same_v<ValueT, void>)
-                            {
-                                fn();
-                            }
-                            else
-                            {
-                                fn(std::move(*_state_->_value_));
-                            }
-
-                            continuationPromise.SetDone();
+                            continuationFuture = fn();
                         }
                         else
                         {
-                            resultType result;
+                            continuationFuture = fn(_internal_take_value<ValueT>(*_state_->_value_));
+                        }
+                    };
+
+                    if constexpr (_internal_is_nothrow_continuation_v<FnT, ValueT>)
+                    {
+                        callContinuation();
+                    }
+                    else
+                    {
+                        try
+                        {
+                            callContinuation();
+                        }
+                        catch (...)
+                        {
+                            Promise<resultType, SyncT> continuationPromise;
+                            continuationFuture = continuationPromise.GetFuture();
+                            continuationPromise.SetException(std::current_exception());
+                        }
+                    }
+                }
+                else
+                {
+                    Promise<resultType, SyncT> continuationPromise;
+                    continuationFuture = continuationPromise.GetFuture();
+                    _state_->_setChainedContinuation(std::move(fn), std::move(continuationPromise));
+                }
+            }
+
+            _state_->_release();
+            _state_ = nullptr;
+
+            return continuationFuture;
+        }
+
+        template<typename FnT>
+        std::enable_if_t<
+            _is_not_future_v<_internal_invoke_result_t<FnT, ValueT>>,
+            Future<_internal_invoke_result_t<FnT, ValueT>, SyncT>> Then(FnT fn)
+        {
+            using resultType = _internal_invoke_result_t<FnT, ValueT>;
+
+            if (!_state_)
+            {
+                throw FutureError(FutureErrorCode::NoState, "Future has no state!");
+            }
+
+            Promise<resultType, SyncT> continuationPromise;
+            auto continuationFuture = continuationPromise.GetFuture();
 
+            // Scope for lock
+            {
+                std::unique_lock lck(_state_->_mtx_value_);
+                
+                if (_state_->_hasFailed())
+                {
+                    _state_->_forwardFailure(continuationPromise);
+                }
+                else if (_state_->_value_.has_value())
+                {
+                    // If the promise has already been fulfilled,
+                    // call the continuation function immediately
+                    _internal_call_continuation(continuationPromise, [this, &fn]() noexcept(_internal_is_nothrow_continuation_v<FnT, ValueT>) -> resultType
+                        {
                             if constexpr (std::is_same_v<ValueT, void>)
                             {
-                                result = fn();
+                                return fn();
                             }
                             else
                             {
-                                result = fn(std::move(*_state_->_value_));
+                                return fn(_internal_take_value<ValueT>(*_state_->_value_));
                             }
-
-                            continuationPromise.SetValue(std::move(result));
-                        }
-                    }
-                    catch (...)
-                    {
-                        continuationPromise.SetException(std::current_exception());
-                    }
+                        });
                 }
                 else
                 {
@@ -662,17 +1561,17 @@ namespace TaskStuff
         }
     };
 
-    template <typename ValueT>
-    class Future : public _InternalFutureBase<ValueT>
+    template <typename ValueT, typename SyncT>
+    class Future : public _InternalFutureBase<ValueT, SyncT>
     {
     private:
 
-        Future(PromiseFutureState<ValueT>* state)
+        Future(PromiseFutureState<ValueT, SyncT>* state)
         {
-            _InternalFutureBase<ValueT>::_state_ = state;
+            _InternalFutureBase<ValueT, SyncT>::_state_ = state;
         }
 
-        friend class _InternalPromiseBase<ValueT>;
+        friend class _InternalPromiseBase<ValueT, SyncT>;
 
     public:
 
@@ -684,38 +1583,39 @@ namespace TaskStuff
 
         Future(Future&& other) noexcept
         {
-            _InternalFutureBase<ValueT>::_state_ = other._state_;
+            _InternalFutureBase<ValueT, SyncT>::_state_ = other._state_;
             other._state_ = nullptr;
         }
 
         Future& operator=(Future&& other) noexcept
         {
-            if (_InternalFutureBase<ValueT>::_state_)
-                _InternalFutureBase<ValueT>::_state_->_release();
+            if (_InternalFutureBase<ValueT, SyncT>::_state_)
+                _InternalFutureBase<ValueT, SyncT>::_state_->_release();
 
-            _InternalFutureBase<ValueT>::_state_ = other._state_;
+            _InternalFutureBase<ValueT, SyncT>::_state_ = other._state_;
             other._state_ = nullptr;
             return *this;
         }
 
         Future(ValueT value)
         {
-            _InternalFutureBase<ValueT>::_state_ = new PromiseFutureState<ValueT>();
-            _InternalFutureBase<ValueT>::_state_->_value_ = std::move(value);
+            _InternalFutureBase<ValueT, SyncT>::_state_ = new PromiseFutureState<ValueT, SyncT>();
+            _InternalFutureBase<ValueT, SyncT>::_state_->_value_.emplace(std::forward<ValueT>(value));
+            _InternalFutureBase<ValueT, SyncT>::_state_->_status_.store(_InternalFutureStatus::Value, std::memory_order_relaxed);
         }
     };
 
-    template <>
-    class Future<void> : public _InternalFutureBase<void>
+    template <typename SyncT>
+    class Future<void, SyncT> : public _InternalFutureBase<void, SyncT>
     {
     private:
 
-        Future(PromiseFutureState<void>* state)
+        Future(PromiseFutureState<void, SyncT>* state)
         {
-            _state_ = state;
+            _InternalFutureBase<void, SyncT>::_state_ = state;
         }
 
-        friend class _InternalPromiseBase<void>;
+        friend class _InternalPromiseBase<void, SyncT>;
 
     public:
 
@@ -727,22 +1627,19 @@ namespace TaskStuff
 
         Future(Future&& other) noexcept
         {
-            _state_ = other._state_;
+            _InternalFutureBase<void, SyncT>::_state_ = other._state_;
             other._state_ = nullptr;
         }
 
         Future& operator=(Future&& other) noexcept;
-
-        template<typename FnT>
-        void OnException(FnT fn);
     };
 
-    template <typename ValueT>
+    template <typename ValueT, typename SyncT>
     class _InternalPromiseBase
     {
     protected:
 
-        PromiseFutureState<ValueT>* _state_;
+        PromiseFutureState<ValueT, SyncT>* _state_;
         bool _future_retrieved_;
         bool _value_set_;
 
@@ -764,12 +1661,50 @@ namespace TaskStuff
         }
 
         _InternalPromiseBase()
-            : _state_(new PromiseFutureState<ValueT>())
+            : _state_(new PromiseFutureState<ValueT, SyncT>())
             , _future_retrieved_(false)
             , _value_set_(false)
         {
         }
 
+        _InternalPromiseBase(_InternalPromiseBase&& other) noexcept
+            : _state_(other._state_)
+            , _future_retrieved_(other._future_retrieved_)
+            , _value_set_(other._value_set_)
+        {
+            other._state_ = nullptr;
+            other._future_retrieved_ = false;
+            other._value_set_ = false;
+        }
+
+        // If the only thing waiting on our state is a chained promise, take over that promise and
+        // drop our own state. This collapses chains of forwarding promises built up by async recursion
+        // so the outermost promise always ends up attached directly to the innermost state.
+        void _collapseChain()
+        {
+            while (_state_ && !_value_set_)
+            {
+                std::optional<Promise<ValueT, SyncT>> forwardedPromise;
+
+                // Scope for lock
+                {
+                    std::unique_lock lck(_state_->_mtx_value_);
+
+                    if (!_state_->_chained_promise_)
+                        return;
+
+                    forwardedPromise = std::move(_state_->_chained_promise_);
+                    _state_->_chained_promise_.reset();
+                }
+
+                // Nobody can observe our state anymore so it is abandoned rather than broken
+                _value_set_ = true;
+                static_cast<Promise<ValueT, SyncT>&>(*this) = std::move(*forwardedPromise);
+            }
+        }
+
+        friend class _InternalFutureBase<ValueT, SyncT>;
+
     public:
 
         ~_InternalPromiseBase()
@@ -777,7 +1712,7 @@ namespace TaskStuff
             _clear();
         }
 
-        Future<ValueT> GetFuture()
+        Future<ValueT, SyncT> GetFuture()
         {
             if (_future_retrieved_)
             {
@@ -792,7 +1727,7 @@ namespace TaskStuff
             _future_retrieved_ = true;
             _state_->_addRef();
 
-            return Future<ValueT>(_state_);
+            return Future<ValueT, SyncT>(_state_);
         }
 
         void SetException(std::exception_ptr exceptionPtr)
@@ -825,7 +1760,7 @@ namespace TaskStuff
             else
             {
                 _state_->_exception_ = exceptionPtr;
-                _state_->_cv_value_.notify_all();
+                _state_->_publish(_InternalFutureStatus::Exception);
             }
         }
 
@@ -834,10 +1769,51 @@ namespace TaskStuff
         {
             SetException(std::make_exception_ptr(exception));
         }
+
+        // Fails the promise with an error code. Unlike an exception this never allocates and
+        // continuations pass it on without unwinding, use it for expected failures.
+        void SetError(std::error_code code)
+        {
+            if (_value_set_)
+            {
+                throw FutureError(FutureErrorCode::PromiseAlreadySatisfied, "Promise value already set!");
+            }
+
+            if (!_state_)
+            {
+                throw FutureError(FutureErrorCode::NoState, "Promise has no state!");
+            }
+
+            if (!code)
+            {
+                throw FutureError(FutureErrorCode::InvalidErrorCode, "Error code doesn't represent an error!");
+            }
+
+            std::unique_lock lck(_state_->_mtx_value_);
+            _value_set_ = true;
+
+            if (_state_->_continuation_)
+            {
+                _state_->_continuation_->SetError(code);
+            }
+            else if (_state_->_chained_promise_)
+            {
+                _state_->_chained_promise_->SetError(code);
+            }
+            else if (_state_->_on_exception_)
+            {
+                (*_state_->_on_exception_)(std::make_exception_ptr(std::system_error(code)));
+            }
+            else
+            {
+                _state_->_error_ = code;
+                _state_->_publish(_InternalFutureStatus::Error);
+            }
+        }
     };
 
-    template <typename ValueT>
-    class Promise : public _InternalPromiseBase<ValueT>
+    template <typename ValueT, typename SyncT>
+    class Promise : public _InternalPromiseBase<ValueT, SyncT>
     {
     public:
 
@@ -845,23 +1821,16 @@ namespace TaskStuff
         { }
 
         Promise(Promise&& other) noexcept
-        {
-            _InternalPromiseBase<ValueT>::_state_ = other._state_;
-            _InternalPromiseBase<ValueT>::_future_retrieved_ = other._future_retrieved_;
-            _InternalPromiseBase<ValueT>::_value_set_ = other._value_set_;
-
-            other._state_ = nullptr;
-            other._future_retrieved_ = false;
-            other._value_set_ = false;
-        }
+            : _InternalPromiseBase<ValueT, SyncT>(std::move(other))
+        { }
 
         Promise& operator=(Promise&& other) noexcept
         {
-            _InternalPromiseBase<ValueT>::_clear();
+            _InternalPromiseBase<ValueT, SyncT>::_clear();
 
-            _InternalPromiseBase<ValueT>::_state_ = other._state_;
-            _InternalPromiseBase<ValueT>::_future_retrieved_ = other._future_retrieved_;
-            _InternalPromiseBase<ValueT>::_value_set_ = other._value_set_;
+            _InternalPromiseBase<ValueT, SyncT>::_state_ = other._state_;
+            _InternalPromiseBase<ValueT, SyncT>::_future_retrieved_ = other._future_retrieved_;
+            _InternalPromiseBase<ValueT, SyncT>::_value_set_ = other._value_set_;
 
             other._state_ = nullptr;
             other._future_retrieved_ = false;
@@ -870,41 +1839,59 @@ namespace TaskStuff
             return *this;
         }
 
-        void SetValue(ValueT value)
+        void SetValue(ValueT&& value)
+        {
+            Emplace(std::forward<ValueT>(value));
+        }
+
+        void SetValue(ValueT const& value) requires (!std::is_reference_v<ValueT>)
+        {
+            Emplace(value);
+        }
+
+        // Constructs the value directly where it is consumed: in the argument of a waiting
+        // continuation, in a chained promise or in the state itself
+        template <typename... ArgsT>
+        void Emplace(ArgsT&&... args)
         {
-            if (_InternalPromiseBase<ValueT>::_value_set_)
+            if (_InternalPromiseBase<ValueT, SyncT>::_value_set_)
             {
                 throw FutureError(FutureErrorCode::PromiseAlreadySatisfied, "Promise value already set!");
             }
 
-            if (!_InternalPromiseBase<ValueT>::_state_)
+            if (!_InternalPromiseBase<ValueT, SyncT>::_state_)
             {
                 throw FutureError(FutureErrorCode::NoState, "Promise has no state!");
             }
 
-            std::unique_lock lck(_InternalPromiseBase<ValueT>::_state_->_mtx_value_);
-            _InternalPromiseBase<ValueT>::_value_set_ = true;
+            std::unique_lock lck(_InternalPromiseBase<ValueT, SyncT>::_state_->_mtx_value_);
+
+            // The promise only counts as satisfied once the value has been constructed,
+            // if that throws the caller can still set an exception instead
 
             // If a continuation function is set, call it with the value
-            if (_InternalPromiseBase<ValueT>::_state_->_continuation_)
+            if (_InternalPromiseBase<ValueT, SyncT>::_state_->_continuation_)
             {
-                _InternalPromiseBase<ValueT>::_state_->_continuation_argument_holder_->SetValue(std::move(value));
-                _InternalPromiseBase<ValueT>::_state_->_continuation_->Call();
+                _InternalPromiseBase<ValueT, SyncT>::_state_->_continuation_argument_holder_->SetValue(std::forward<ArgsT>(args)...);
+                _InternalPromiseBase<ValueT, SyncT>::_value_set_ = true;
+                _InternalPromiseBase<ValueT, SyncT>::_state_->_continuation_->Call();
             }
-            else if (_InternalPromiseBase<ValueT>::_state_->_chained_promise_)
+            else if (_InternalPromiseBase<ValueT, SyncT>::_state_->_chained_promise_)
             {
-                _InternalPromiseBase<ValueT>::_state_->_chained_promise_->SetValue(std::move(value));
+                _InternalPromiseBase<ValueT, SyncT>::_state_->_chained_promise_->Emplace(std::forward<ArgsT>(args)...);
+                _InternalPromiseBase<ValueT, SyncT>::_value_set_ = true;
             }
             else // Otherwise set the value in the state normally
             {
-                _InternalPromiseBase<ValueT>::_state_->_value_ = std::move(value);
-                _InternalPromiseBase<ValueT>::_state_->_cv_value_.notify_all();
+                _InternalPromiseBase<ValueT, SyncT>::_state_->_value_.emplace(std::forward<ArgsT>(args)...);
+                _InternalPromiseBase<ValueT, SyncT>::_value_set_ = true;
+                _InternalPromiseBase<ValueT, SyncT>::_state_->_publish(_InternalFutureStatus::Value);
             }
         }
     };
 
-    template <>
-    class Promise<void> : public _InternalPromiseBase<void>
+    template <typename SyncT>
+    class Promise<void, SyncT> : public _InternalPromiseBase<void, SyncT>
     {
     public:
 
@@ -913,23 +1900,16 @@ namespace TaskStuff
         }
 
         Promise(Promise&& other) noexcept
-        {
-            _state_ = other._state_;
-            _future_retrieved_ = other._future_retrieved_;
-            _value_set_ = other._value_set_;
-
-            other._state_ = nullptr;
-            other._future_retrieved_ = false;
-            other._value_set_ = false;
-        }
+            : _InternalPromiseBase<void, SyncT>(std::move(other))
+        { }
 
         Promise& operator=(Promise&& other) noexcept
         {
-            _clear();
+            _InternalPromiseBase<void, SyncT>::_clear();
 
-            _state_ = other._state_;
-            _future_retrieved_ = other._future_retrieved_;
-            _value_set_ = other._value_set_;
+            _InternalPromiseBase<void, SyncT>::_state_ = other._state_;
+            _InternalPromiseBase<void, SyncT>::_future_retrieved_ = other._future_retrieved_;
+            _InternalPromiseBase<void, SyncT>::_value_set_ = other._value_set_;
 
             other._state_ = nullptr;
             other._future_retrieved_ = false;
@@ -941,21 +1921,26 @@ namespace TaskStuff
         void SetDone();
     };
 
-    template <typename ValueT>
+    template <typename ValueT, typename SyncT>
     class PromiseFutureState
     {
     private:
 
-        std::atomic_int _ref_count_ = 1;
+        typename SyncT::template atomic_type<int> _ref_count_ = 1;
+
+        // Lets futures be polled without taking the lock
+        typename SyncT::template atomic_type<_InternalFutureStatus> _status_ = _InternalFutureStatus::Pending;
 
-        std::mutex                                                                               _mtx_value_;
-        std::condition_variable                                                                  _cv_value_;
-        std::optional<std::conditional_t<std::is_same_v<ValueT, void>, VoidPlaceHolder, ValueT>> _value_;
+        typename SyncT::mutex_type                                                               _mtx_value_;
+        typename SyncT::condition_variable_type                                                  _cv_value_;
+        std::optional<_internal_storage_t<ValueT>>                                               _value_;
         std::exception_ptr                                                                       _exception_;
+        std::error_code                                                                          _error_;
         std::optional<_InternalCallableHolder>                                                   _continuation_;
         _InternalCallableHolder::_ArgumentHolder<ValueT>*                                        _continuation_argument_holder_;
-        std::optional<Promise<ValueT>>                                                           _chained_promise_;
+        std::optional<Promise<ValueT, SyncT>>                                                    _chained_promise_;
         std::optional<std::function<void(std::exception_ptr)>>                                   _on_exception_;
+        _InternalWaiter*                                                                         _waiter_ = nullptr;
 
         void _addRef() { ++_ref_count_; }
 
@@ -967,293 +1952,1094 @@ namespace TaskStuff
             }
         }
 
+        bool _hasFailed() const
+        {
+            return _exception_ || _error_;
+        }
+
+        // Called with the lock held once the outcome has been stored
+        void _publish(_InternalFutureStatus status)
+        {
+            _status_.store(status, std::memory_order_release);
+            _cv_value_.notify_all();
+
+            if (_waiter_)
+                _waiter_->_signal();
+        }
+
+        bool _isComplete() const
+        {
+            return _value_.has_value() || _hasFailed();
+        }
+
+        // Passes the exception or error code the state failed with on to another promise
+        template <typename PromiseT>
+        void _forwardFailure(PromiseT& promise)
+        {
+            if (_exception_)
+                promise.SetException(_exception_);
+            else
+                promise.SetError(_error_);
+        }
+
+        template <typename FnT>
+        void _setContinuation(FnT fn, Promise<_internal_invoke_result_t<FnT, ValueT>, SyncT> prom)
+        {
+            _continuation_.emplace();
+            _continuation_argument_holder_ = _continuation_->template Init<FnT, ValueT>(std::move(fn), std::move(prom));
+        }
 
         template <typename FnT>
-        void _setContinuation(FnT fn, Promise<_internal_invoke_result_t<FnT, ValueT>> prom)
+        void _setChainedContinuation(FnT fn, Promise<typename _internal_invoke_result_t<FnT, ValueT>::value_type, SyncT> prom)
         {
             _continuation_.emplace();
-            _continuation_argument_holder_ = _continuation_->Init<FnT, ValueT>(std::move(fn), std::move(prom));
+            _continuation_argument_holder_ = _continuation_->template InitChained<FnT, ValueT>(std::move(fn), std::move(prom));
         }
 
         template <typename FnT>
-        void _setChainedContinuation(FnT fn, Promise<typename _internal_invoke_result_t<FnT, ValueT>::value_type> prom)
+        void _setCompletion(FnT fn, Promise<_internal_invoke_result_t<FnT, Result<ValueT>>, SyncT> prom)
         {
             _continuation_.emplace();
-            _continuation_argument_holder_ = _continuation_->InitChained<FnT, ValueT>(std::move(fn), std::move(prom));
+            _continuation_argument_holder_ = _continuation_->template InitCompletion<FnT, ValueT>(std::move(fn), std::move(prom));
         }
 
-        friend class _InternalFutureBase<ValueT>;
-        friend class _InternalPromiseBase<ValueT>;
-        friend class Future<ValueT>;
-        friend class Promise<ValueT>;
+        template <size_t N>
+        void _setSplit(std::array<Promise<ValueT, SyncT>, N> proms)
+        {
+            _continuation_.emplace();
+            _continuation_argument_holder_ = _continuation_->template InitSplit<ValueT, N, SyncT>(std::move(proms));
+        }
+
+        friend class _InternalFutureBase<ValueT, SyncT>;
+        friend class _InternalPromiseBase<ValueT, SyncT>;
+        friend class Future<ValueT, SyncT>;
+        friend class Promise<ValueT, SyncT>;
     };
 
-    template<typename FnT>
-    void Future<void>::OnException(FnT fn)
+    template <typename SyncT>
+    void Promise<void, SyncT>::SetDone()
     {
-        if (!_state_)
+        auto& state = _InternalPromiseBase<void, SyncT>::_state_;
+
+        if (_InternalPromiseBase<void, SyncT>::_value_set_)
         {
-            // Not really sure if we should throw here or call the function
-            fn(std::make_exception_ptr(FutureError(FutureErrorCode::NoState, "Future has no state!")));
-            return;
+            throw FutureError(FutureErrorCode::PromiseAlreadySatisfied, "Promise value already set!");
         }
 
-        // Scope for lock
+        if (!state)
         {
-            std::unique_lock lck(_state_->_mtx_value_);
+            throw FutureError(FutureErrorCode::NoState, "Promise has no state!");
+        }
 
-            if (_state_->_exception_)
+        std::unique_lock lck(state->_mtx_value_);
+        _InternalPromiseBase<void, SyncT>::_value_set_ = true;
+
+        // If a continuation function is set, call it with the value
+        if (state->_continuation_)
+        {
+            state->_continuation_->Call();
+        }
+        else if (state->_chained_promise_)
+        {
+            state->_chained_promise_->SetDone();
+        }
+        else // Otherwise set the value in the state normally
+        {
+            state->_value_.emplace();
+            state->_publish(_InternalFutureStatus::Value);
+        }
+    }
+
+    template <typename SyncT>
+    Future<void, SyncT>& Future<void, SyncT>::operator=(Future<void, SyncT>&& other) noexcept
+    {
+        auto& state = _InternalFutureBase<void, SyncT>::_state_;
+
+        if (state)
+            state->_release();
+
+        state = other._state_;
+        other._state_ = nullptr;
+        return *this;
+    }
+
+    extern template class Future<void, MultiThreaded>;
+    extern template class Promise<void, MultiThreaded>;
+
+    template <typename ValueT, typename SyncT>
+    Future<std::vector<_internal_storage_t<ValueT>>, SyncT> WhenAll(std::span<Future<ValueT, SyncT>> futures)
+    {
+        struct WhenAllContext
+        {
+            std::vector<_internal_slot_t<ValueT>> values;
+            typename SyncT::template atomic_type<int> countdown;
+            Promise<std::vector<_internal_storage_t<ValueT>>, SyncT> promise_all;
+            std::vector<std::exception_ptr> exceptions;
+            typename SyncT::template atomic_type<int> exception_count;
+
+            void Finish()
             {
-                fn(_state_->_exception_);
+                if (exception_count > 0)
+                {
+                    ExceptionAggregate exceptionAggregate;
+                    for (std::exception_ptr e : exceptions)
+                    {
+                        if (e)
+                        {
+                            exceptionAggregate.Add(e);
+                        }
+                    }
+                    promise_all.SetException(std::move(exceptionAggregate));
+                }
+                else if constexpr (std::is_reference_v<ValueT>)
+                {
+                    std::vector<_internal_storage_t<ValueT>> references;
+                    references.reserve(values.size());
+
+                    for (auto* value : values)
+                        references.emplace_back(*value);
+
+                    promise_all.SetValue(std::move(references));
+                }
+                else
+                {
+                    promise_all.SetValue(std::move(values));
+                }
             }
-            else if (_state_->_value_.has_value())
+        };
+
+        auto whenAllContext = std::make_shared<WhenAllContext>();
+        whenAllContext->values.resize(futures.size());
+        whenAllContext->exceptions.resize(futures.size());
+        whenAllContext->countdown = futures.size();
+        whenAllContext->exception_count = 0;
+
+        for (size_t i = 0; i < futures.size(); ++i)
+        {
+            futures[i].OnComplete([whenAllContext = whenAllContext, idx = i](Result<ValueT> result)
+                {
+                    if (!result.HasValue())
+                    {
+                        // Error codes are collected into the aggregate as std::system_error
+                        whenAllContext->exceptions[idx] = result.HasException() ?
+                            result.GetException() :
+                            std::make_exception_ptr(std::system_error(result.GetError()));
+                        ++whenAllContext->exception_count;
+                    }
+                    else
+                    {
+                        _internal_fill_slot<ValueT>(whenAllContext->values[idx], result.Get());
+                    }
+
+                    // The last underlying future to complete will set the value in the overall promise
+                    if (0 == --whenAllContext->countdown)
+                    {
+                        whenAllContext->Finish();
+                    }
+                });
+        }
+
+        return whenAllContext->promise_all.GetFuture();
+    }
+
+    template <size_t current, size_t end, typename FnT>
+    void foreach_number(FnT fn)
+    {
+        if constexpr (current < end)
+        {
+            fn(std::integral_constant<size_t, current>());
+            foreach_number<current + 1, end, FnT>(fn);
+        }
+    }
+
+    template <typename SyncT, typename... ValuesT>
+    Future<std::tuple<ValuesT...>, SyncT> WhenAll(Future<ValuesT, SyncT>... futures)
+    {
+        struct WhenAllContext
+        {
+            std::tuple<Future<ValuesT, SyncT>...> tuple_futures;
+            std::tuple<_internal_slot_t<ValuesT>...> values;
+            typename SyncT::template atomic_type<int> countdown;
+            Promise<std::tuple<ValuesT...>, SyncT> promise_all;
+            std::array<std::exception_ptr, sizeof...(ValuesT)> exceptions;
+            typename SyncT::template atomic_type<int> exception_count;
+
+            void Finish()
             {
-                // Already complete
+                if (exception_count > 0)
+                {
+                    ExceptionAggregate exceptionAggregate;
+                    for (std::exception_ptr e : exceptions)
+                    {
+                        if (e)
+                        {
+                            exceptionAggregate.Add(e);
+                        }
+                    }
+                    promise_all.SetException(std::move(exceptionAggregate));
+                }
+                else
+                {
+                    promise_all.SetValue(std::apply([](auto&... slots)
+                        {
+                            return std::tuple<ValuesT...>(_internal_take_slot<ValuesT>(slots)...);
+                        }, values));
+                }
             }
-            else
+        };
+
+        auto whenAllContext = std::make_shared<WhenAllContext>();
+        whenAllContext->countdown = sizeof...(ValuesT);
+        whenAllContext->tuple_futures = std::tuple<Future<ValuesT, SyncT>...>{ std::move(futures)... };
+        whenAllContext->exception_count = 0;
+
+        foreach_number<0, sizeof...(ValuesT)>([whenAllContext = whenAllContext](auto idx)
             {
-                _state_->_on_exception_ = std::move(fn);
+                auto& current_future = std::get<idx>(whenAllContext->tuple_futures);
+                auto& current_value = std::get<idx>(whenAllContext->values);
+
+                using current_value_type = typename std::remove_reference_t<decltype(current_future)>::value_type;
+
+                current_future.OnComplete([whenAllContext = whenAllContext, v = &current_value, idx = idx](Result<current_value_type> result)
+                    {
+                        if (!result.HasValue())
+                        {
+                            // Error codes are collected into the aggregate as std::system_error
+                            whenAllContext->exceptions[idx] = result.HasException() ?
+                                result.GetException() :
+                                std::make_exception_ptr(std::system_error(result.GetError()));
+                            ++whenAllContext->exception_count;
+                        }
+                        else
+                        {
+                            _internal_fill_slot<current_value_type>(*v, result.Get());
+                        }
+
+                        // The last underlying future to complete will set the value in the overall promise
+                        if (0 == --whenAllContext->countdown)
+                        {
+                            whenAllContext->Finish();
+                        }
+                    });
+            });
+
+        return whenAllContext->promise_all.GetFuture();
+    }
+
+    // Attaches one waiter to all the futures and blocks until count of them have completed.
+    // Without a deadline this always returns true.
+    template <typename ValueT>
+    bool _internal_wait_for(std::span<Future<ValueT>> futures, size_t count, std::optional<std::chrono::steady_clock::time_point> deadline)
+    {
+        for (auto& fut : futures)
+        {
+            if (!fut.Valid())
+            {
+                throw FutureError(FutureErrorCode::NoState, "Future has no state!");
             }
         }
 
-        _state_->_release();
-        _state_ = nullptr;
+        _InternalWaiter waiter;
+
+        for (auto& fut : futures)
+            waiter._attach(fut);
+
+        bool completed = true;
+
+        if (deadline)
+            completed = waiter._waitUntil(count, *deadline);
+        else
+            waiter._wait(count);
+
+        for (auto& fut : futures)
+            waiter._detach(fut);
+
+        return completed;
     }
 
     template <typename ValueT>
-    Future<std::vector<ValueT>> WhenAll(std::span<Future<ValueT>> futures)
+    std::optional<size_t> _internal_first_ready(std::span<Future<ValueT>> futures)
     {
-        struct WhenAllContext
+        for (size_t i = 0; i < futures.size(); ++i)
         {
-            std::vector<ValueT> values;
-            std::atomic_int countdown;
-            Promise<std::vector<ValueT>> promise_all;
-            std::vector<std::exception_ptr> exceptions;
-            std::atomic_int exception_count;
+            if (futures[i].IsReady())
+                return i;
+        }
+
+        return std::nullopt;
+    }
+
+    // Blocks until one of the futures is ready and returns the index of the first ready one.
+    // None of the futures is consumed. Returns futures.size() for an empty span.
+    template <typename ValueT>
+    size_t WaitAny(std::span<Future<ValueT>> futures)
+    {
+        if (futures.empty())
+            return 0;
+
+        if (auto ready = _internal_first_ready(futures))
+            return *ready;
+
+        _internal_wait_for(futures, 1, std::nullopt);
+        return *_internal_first_ready(futures);
+    }
+
+    // Same as above, but gives up after timeout and returns nullopt
+    template <typename ValueT, typename RepT, typename PeriodT>
+    std::optional<size_t> WaitAny(std::span<Future<ValueT>> futures, std::chrono::duration<RepT, PeriodT> timeout)
+    {
+        if (auto ready = _internal_first_ready(futures))
+            return ready;
+
+        if (futures.empty() || !_internal_wait_for(futures, 1, std::chrono::steady_clock::now() + timeout))
+            return std::nullopt;
+
+        return _internal_first_ready(futures);
+    }
+
+    // Blocks until all of the futures are ready without consuming any of them
+    template <typename ValueT>
+    void WaitAll(std::span<Future<ValueT>> futures)
+    {
+        _internal_wait_for(futures, futures.size(), std::nullopt);
+    }
+
+    // Same as above, but gives up after timeout. Returns true if all futures are ready.
+    template <typename ValueT, typename RepT, typename PeriodT>
+    bool WaitAll(std::span<Future<ValueT>> futures, std::chrono::duration<RepT, PeriodT> timeout)
+    {
+        return _internal_wait_for(futures, futures.size(), std::chrono::steady_clock::now() + timeout);
+    }
+
+    // Move-only type erased void() callable, the unit of work handed to an Executor
+    class Task
+    {
+        class _InternalIfc
+        {
+        public:
+
+            virtual void Call() = 0;
+            virtual _InternalIfc* MoveTo(void* dest) = 0;
+            virtual ~_InternalIfc() {}
+        };
+
+        template <typename FnT>
+        class _FunctionHolder final : public _InternalIfc
+        {
+        private:
+
+            FnT _fn_;
+
+        public:
+
+            _FunctionHolder(FnT fn)
+                : _fn_(std::move(fn))
+            { }
+
+            void Call() override
+            {
+                _fn_();
+            }
+
+            _InternalIfc* MoveTo(void* dest) override
+            {
+                // Placement new on buffer
+                return new (dest) _FunctionHolder<FnT>(std::move(_fn_));
+            }
+        };
+
+    private:
+
+        static const size_t INTERNAL_BUFFER_SIZE = 64;
+
+        _InternalIfc* _internal_instance_;
+        alignas(std::max_align_t) std::array<uint8_t, INTERNAL_BUFFER_SIZE> _buf_;
+
+        Task(Task const& other) = delete;
+        Task& operator=(Task const& other) = delete;
+
+        void _clear()
+        {
+            if (static_cast<void*>(_internal_instance_) == _buf_.data())
+                _internal_instance_->~_InternalIfc();
+            else
+                delete _internal_instance_;
+
+            _internal_instance_ = nullptr;
+        }
+
+        void _moveFrom(Task& other)
+        {
+            if (static_cast<void*>(other._internal_instance_) == other._buf_.data())
+            {
+                _internal_instance_ = other._internal_instance_->MoveTo(_buf_.data());
+                other._internal_instance_->~_InternalIfc();
+            }
+            else
+            {
+                _internal_instance_ = other._internal_instance_;
+            }
+
+            other._internal_instance_ = nullptr;
+        }
+
+    public:
+
+        Task() noexcept
+            : _internal_instance_(nullptr)
+        { }
+
+        template <typename FnT, typename = std::enable_if_t<!std::is_same_v<std::decay_t<FnT>, Task>>>
+        Task(FnT fn)
+        {
+            if constexpr (sizeof(_FunctionHolder<FnT>) <= INTERNAL_BUFFER_SIZE && alignof(_FunctionHolder<FnT>) <= alignof(std::max_align_t))
+                _internal_instance_ = new (_buf_.data()) _FunctionHolder<FnT>(std::move(fn));
+            else
+                _internal_instance_ = new _FunctionHolder<FnT>(std::move(fn));
+        }
+
+        Task(Task&& other) noexcept
+            : _internal_instance_(nullptr)
+        {
+            _moveFrom(other);
+        }
+
+        Task& operator=(Task&& other) noexcept
+        {
+            _clear();
+            _moveFrom(other);
+            return *this;
+        }
+
+        ~Task()
+        {
+            _clear();
+        }
+
+        explicit operator bool() const
+        {
+            return _internal_instance_ != nullptr;
+        }
+
+        void operator()()
+        {
+            _internal_instance_->Call();
+        }
+    };
+
+    class Executor
+    {
+    public:
+
+        virtual void Execute(Task task) = 0;
+        virtual ~Executor() {}
+    };
+
+    // Fixed size pool of worker threads sharing one FIFO queue.
+    // Tasks still queued when the pool is destroyed are run before the workers are joined.
+    class ThreadPool final : public Executor
+    {
+    private:
+
+        std::mutex               _mtx_queue_;
+        std::condition_variable  _cv_queue_;
+        std::deque<Task>         _queue_;
+        bool                     _stopping_;
+        std::vector<std::thread> _threads_;
+
+        // Workers blocked in Future::Get, signalled so they pick up new tasks
+        std::vector<_InternalWaiter*> _helpers_;
+
+        ThreadPool(ThreadPool const&) = delete;
+        ThreadPool& operator=(ThreadPool const&) = delete;
+
+        void _workerLoop();
+        bool _runOne();
+
+        friend bool _internal_help_current_pool();
+        friend void _internal_watch_current_pool(_InternalWaiter* waiter);
+        friend void _internal_unwatch_current_pool(_InternalWaiter* waiter);
+
+    public:
+
+        explicit ThreadPool(size_t threadCount = std::thread::hardware_concurrency());
+        ~ThreadPool();
+
+        void Execute(Task task) override;
+
+        size_t ThreadCount() const
+        {
+            return _threads_.size();
+        }
+    };
+
+    // Defined in task_stuff.cpp. Completes on a shared timer thread once delay has passed,
+    // continuations attached to it should hand longer work to an executor. The thread stops when
+    // the process exits, delays still pending then never complete.
+    Future<void> _internal_delay(std::chrono::steady_clock::duration delay);
+
+    // Completion state shared by the futures that broadcast one value to many continuations.
+    // The value is stored inline, readiness is a single atomic and waiting continuations are kept
+    // in a lock-free intrusive stack that the completing thread swaps out in one exchange.
+    template <typename ValueT, typename ArgumentT>
+    class _InternalBroadcastState
+    {
+    public:
+
+        using _status = _InternalFutureStatus;
+
+        struct _subscriber
+        {
+            _InternalCallableHolder                              _continuation_;
+            _InternalCallableHolder::_ArgumentHolder<ArgumentT>* _argument_holder_ = nullptr;
+            _subscriber*                                         _next_ = nullptr;
         };
 
-        auto whenAllContext = std::make_shared<WhenAllContext>();
-        whenAllContext->values.resize(futures.size());
-        whenAllContext->exceptions.resize(futures.size());
-        whenAllContext->countdown = futures.size();
-        whenAllContext->exception_count = 0;
+        std::atomic<_status>                       _status_ = _status::Pending;
+        std::optional<_internal_storage_t<ValueT>> _value_;
+        std::exception_ptr                         _exception_;
+        std::error_code                            _error_;
+
+        // Swapped for _closed() by the thread completing the state, whoever
+        // subscribes after that runs the continuation on its own.
+        std::atomic<_subscriber*>                  _subscribers_ = nullptr;
+
+        _InternalBroadcastState() = default;
+        _InternalBroadcastState(_InternalBroadcastState const&) = delete;
+        _InternalBroadcastState& operator=(_InternalBroadcastState const&) = delete;
+
+        ~_InternalBroadcastState()
+        {
+            _subscriber* sub = _subscribers_.load(std::memory_order_acquire);
+
+            while (sub && sub != _closed())
+            {
+                _subscriber* next = sub->_next_;
+                delete sub;
+                sub = next;
+            }
+        }
+
+        _subscriber* _closed()
+        {
+            // Never a valid subscriber so it works as a marker
+            return reinterpret_cast<_subscriber*>(this);
+        }
+
+        _status _wait()
+        {
+            _status status = _status_.load(std::memory_order_acquire);
+
+            while (status == _status::Pending)
+            {
+                _status_.wait(_status::Pending, std::memory_order_acquire);
+                status = _status_.load(std::memory_order_acquire);
+            }
+
+            return status;
+        }
+
+        static bool _hasFailed(_status status)
+        {
+            return status == _status::Exception || status == _status::Error;
+        }
+
+        // Passes the exception or error code the state failed with on to a promise
+        template <typename PromiseT>
+        void _forwardFailure(PromiseT& promise) const
+        {
+            if (_status_.load(std::memory_order_acquire) == _status::Error)
+                promise.SetError(_error_);
+            else
+                promise.SetException(_exception_);
+        }
+
+        [[noreturn]] void _rethrow() const
+        {
+            if (_status_.load(std::memory_order_acquire) == _status::Error)
+                throw std::system_error(_error_);
+
+            std::rethrow_exception(_exception_);
+        }
+
+        // Stores what a completed future ended with and publishes it, returning the waiting subscribers
+        _subscriber* _closeWith(Result<ValueT>& result)
+        {
+            if (result.HasException())
+            {
+                _exception_ = result.GetException();
+                return _close(_status::Exception);
+            }
+
+            if (result.HasError())
+            {
+                _error_ = result.GetError();
+                return _close(_status::Error);
+            }
+
+            _value_.emplace(result.Get());
+            return _close(_status::Value);
+        }
+
+        std::remove_reference_t<ValueT> const& _valueRef() const
+        {
+            if constexpr (std::is_reference_v<ValueT>)
+                return _value_->get();
+            else
+                return *_value_;
+        }
+
+        // Returns false if the state has already completed, the caller then has to run the subscriber
+        bool _push(_subscriber* sub)
+        {
+            _subscriber* head = _subscribers_.load(std::memory_order_acquire);
+
+            do
+            {
+                if (head == _closed())
+                {
+                    // An earlier failed attempt may have linked us to a subscriber that has run since
+                    sub->_next_ = nullptr;
+                    return false;
+                }
+
+                sub->_next_ = head;
+            }
+            while (!_subscribers_.compare_exchange_weak(head, sub, std::memory_order_release, std::memory_order_acquire));
+
+            return true;
+        }
+
+        // Publishes the outcome (value or exception must already be set) and returns the subscribers
+        // that were waiting for it, in the order they were added
+        _subscriber* _close(_status status)
+        {
+            _status_.store(status, std::memory_order_release);
+            _status_.notify_all();
+
+            _subscriber* sub = _subscribers_.exchange(_closed(), std::memory_order_acq_rel);
+
+            // The stack is LIFO, reverse it
+            _subscriber* ordered = nullptr;
+
+            while (sub)
+            {
+                _subscriber* next = sub->_next_;
+                sub->_next_ = ordered;
+                ordered = sub;
+                sub = next;
+            }
+
+            return ordered;
+        }
+
+        // Runs and frees a list of subscribers, makeArgument produces what each continuation is called with
+        template <typename MakeArgumentFnT>
+        void _run(_subscriber* sub, MakeArgumentFnT const& makeArgument)
+        {
+            _status status = _status_.load(std::memory_order_acquire);
+
+            while (sub)
+            {
+                _subscriber* next = sub->_next_;
+
+                if (status == _status::Value)
+                {
+                    sub->_argument_holder_->SetValue(makeArgument());
+                    sub->_continuation_.Call();
+                }
+                else if (status == _status::Error)
+                {
+                    sub->_continuation_.SetError(_error_);
+                }
+                else
+                {
+                    sub->_continuation_.SetException(_exception_);
+                }
+
+                delete sub;
+                sub = next;
+            }
+        }
+    };
+
+    // "Persistent" future that can be accessed multiple times and have multiple continuation functions
+    template <typename ValueT>
+    class PersistentFuture
+    {
+    public:
+
+        // Continuations get shared ownership of the value. For a PersistentFuture<T&> the pointer
+        // refers to the borrowed object without owning it.
+        using shared_value_type = std::shared_ptr<std::remove_reference_t<ValueT> const>;
+
+    private:
+
+        using _broadcastState = _InternalBroadcastState<ValueT, shared_value_type>;
+        using _status = typename _broadcastState::_status;
+        using _subscriber = typename _broadcastState::_subscriber;
+
+        struct _persistentState : public _broadcastState
+        {
+            // Broadcast mode, subscribers waiting at completion are split into batches run on the executor
+            Executor* _executor_ = nullptr;
+            size_t    _batch_size_ = 0;
+        };
+
+        std::shared_ptr<_persistentState> _persistent_state_;
+
+        // Hands out the inline value without another allocation, the pointer keeps the whole state alive
+        static shared_value_type _sharedValue(std::shared_ptr<_persistentState> const& state)
+        {
+            return shared_value_type(state, &state->_valueRef());
+        }
+
+        static void _runSubscribers(std::shared_ptr<_persistentState> const& state, _subscriber* sub)
+        {
+            state->_run(sub, [&state]()
+                {
+                    return _sharedValue(state);
+                });
+        }
+
+        static void _complete(std::shared_ptr<_persistentState> const& state, Result<ValueT>& result)
+        {
+            _subscriber* ordered = state->_closeWith(result);
+
+            // Hand off all but the last batch to the executor and run the last one on this thread
+            while (state->_executor_ && ordered)
+            {
+                _subscriber* batchEnd = ordered;
+                for (size_t i = 1; i < state->_batch_size_ && batchEnd->_next_; ++i)
+                    batchEnd = batchEnd->_next_;
+
+                if (!batchEnd->_next_)
+                    break;
+
+                _subscriber* batch = ordered;
+                ordered = batchEnd->_next_;
+                batchEnd->_next_ = nullptr;
+
+                state->_executor_->Execute([state, batch]()
+                    {
+                        _runSubscribers(state, batch);
+                    });
+            }
+
+            _runSubscribers(state, ordered);
+        }
+
+        void _subscribe(_subscriber* sub)
+        {
+            // Completed while the subscriber was being set up
+            if (!_persistent_state_->_push(sub))
+                _runSubscribers(_persistent_state_, sub);
+        }
+
+        template <typename FnT>
+        void _addContinuation(FnT fn, Promise<std::invoke_result_t<FnT, shared_value_type>> prom)
+        {
+            _subscriber* sub = new _subscriber();
+            sub->_argument_holder_ = sub->_continuation_.template Init<FnT, shared_value_type>(std::move(fn), std::move(prom));
+            _subscribe(sub);
+        }
+
+        template <typename FnT>
+        void _addChainedContinuation(FnT fn, Promise<typename std::invoke_result_t<FnT, shared_value_type>::value_type> prom)
+        {
+            _subscriber* sub = new _subscriber();
+            sub->_argument_holder_ = sub->_continuation_.template InitChained<FnT, shared_value_type>(std::move(fn), std::move(prom));
+            _subscribe(sub);
+        }
+
+        void _attach(Future<ValueT> fut)
+        {
+            // Set a "proxy" continuation function on the base future that will set
+            // the value in the persistent state and call all continuation functions.
+            fut.OnComplete([persistent_state = _persistent_state_](Result<ValueT> result)
+                {
+                    _complete(persistent_state, result);
+                });
+        }
+
+    public:
+
+        PersistentFuture()
+            : _persistent_state_(nullptr)
+        { }
+
+        PersistentFuture(Future<ValueT> fut)
+            : _persistent_state_(std::make_shared<_persistentState>())
+        {
+            _attach(std::move(fut));
+        }
+
+        // Broadcast mode: when the value arrives the waiting continuations are split into batches
+        // of batchSize that run on the executor, instead of all being called on the completing thread
+        PersistentFuture(Future<ValueT> fut, Executor& executor, size_t batchSize = 64)
+            : _persistent_state_(std::make_shared<_persistentState>())
+        {
+            _persistent_state_->_executor_ = &executor;
+            _persistent_state_->_batch_size_ = batchSize > 0 ? batchSize : 1;
+            _attach(std::move(fut));
+        }
+
+        std::remove_reference_t<ValueT> const& Get()
+        {
+            if (_persistent_state_->_wait() != _status::Value)
+                _persistent_state_->_rethrow();
+
+            return _persistent_state_->_valueRef();
+        }
+
+        // If the continuation function itself returns another Future object,
+        // we don't want to end up with something that looks like this on the top level: Future<Future<Future<Future<int>>>>.
+        // This specialization causes the Future on the top level to still be a simple Future<int> that can be awaited.
+        template<typename FnT>
+        std::enable_if_t<
+            _is_future_v<_internal_invoke_result_t<FnT, shared_value_type>>,
+            _internal_invoke_result_t<FnT, shared_value_type>> Then(FnT fn)
+        {
+            using resultType = typename _internal_invoke_result_t<FnT, shared_value_type>::value_type;
+
+            if (!_persistent_state_)
+            {
+                throw FutureError(FutureErrorCode::NoState, "Future has no state!");
+            }
+
+            Future<resultType> continuationFuture;
 
-        for (size_t i = 0; i < futures.size(); ++i)
-        {
-            futures[i].Then([whenAllContext = whenAllContext, idx = i](ValueT val)
+            _status status = _persistent_state_->_status_.load(std::memory_order_acquire);
+
+            if (_broadcastState::_hasFailed(status))
+            {
+                Promise<resultType> continuationPromise;
+                continuationFuture = continuationPromise.GetFuture();
+                _persistent_state_->_forwardFailure(continuationPromise);
+            }
+            else if (status == _status::Value)
+            {
+                // If the promise has already been fulfilled,
+                // call the continuation function immediately
+                if constexpr (_internal_is_nothrow_continuation_v<FnT, shared_value_type>)
+                {
+                    continuationFuture = fn(_sharedValue(_persistent_state_));
+                }
+                else
                 {
-                    whenAllContext->values[idx] = std::move(val);
-                    if (0 == --whenAllContext->countdown) // The last underlying future to complete will set the value in the overall promise
+                    try
                     {
-                        if (whenAllContext->exception_count > 0)
-                        {
-                            ExceptionAggregate exceptionAggregate;
-                            for (std::exception_ptr e : whenAllContext->exceptions)
-                            {
-                                if (e)
-                                {
-                                    exceptionAggregate.Add(e);
-                                }
-                            }
-                            whenAllContext->promise_all.SetException(std::move(exceptionAggregate));
-                        }
-                        else
-                        {
-                            whenAllContext->promise_all.SetValue(std::move(whenAllContext->values));
-                        }
+                        continuationFuture = fn(_sharedValue(_persistent_state_));
                     }
-                }).OnException([whenAllContext = whenAllContext, idx = i](std::exception_ptr e)
+                    catch (...)
                     {
-                        whenAllContext->exceptions[idx] = e;
-                        ++whenAllContext->exception_count;
+                        Promise<resultType> continuationPromise;
+                        continuationFuture = continuationPromise.GetFuture();
+                        continuationPromise.SetException(std::current_exception());
+                    }
+                }
+            }
+            else
+            {
+                Promise<resultType> continuationPromise;
+                continuationFuture = continuationPromise.GetFuture();
+                _addChainedContinuation(std::move(fn), std::move(continuationPromise));
+            }
 
-                        // The regular continuation won't be called if there is an exception so we need to do the countdown here to not get hanged
-                        if (0 == --whenAllContext->countdown)
-                        {
-                            ExceptionAggregate exceptionAggregate;
-                            for (std::exception_ptr e : whenAllContext->exceptions)
-                            {
-                                if (e)
-                                {
-                                    exceptionAggregate.Add(e);
-                                }
-                            }
-                            whenAllContext->promise_all.SetException(std::move(exceptionAggregate));
-                        }
-                    });
+            return continuationFuture;
         }
 
-        return whenAllContext->promise_all.GetFuture();
-    }
-
-    template <size_t current, size_t end, typename FnT>
-    void foreach_number(FnT fn)
-    {
-        if constexpr (current < end)
+        template<typename FnT>
+        std::enable_if_t<
+            _is_not_future_v<_internal_invoke_result_t<FnT, shared_value_type>>,
+            Future<_internal_invoke_result_t<FnT, shared_value_type>>> Then(FnT fn)
         {
-            fn(std::integral_constant<size_t, current>());
-            foreach_number<current + 1, end, FnT>(fn);
-        }
-    }
+            using resultType = _internal_invoke_result_t<FnT, shared_value_type>;
 
-    template <typename... ValuesT>
-    Future<std::tuple<ValuesT...>> WhenAll(Future<ValuesT>... futures)
-    {
-        struct WhenAllContext
-        {
-            std::tuple<Future<ValuesT>...> tuple_futures;
-            std::tuple<ValuesT...> values;
-            std::atomic_int countdown;
-            Promise<std::tuple<ValuesT...>> promise_all;
-            std::array<std::exception_ptr, sizeof...(ValuesT)> exceptions;
-            std::atomic_int exception_count;
-        };
+            if (!_persistent_state_)
+            {
+                throw FutureError(FutureErrorCode::NoState, "Future has no state!");
+            }
 
-        auto whenAllContext = std::make_shared<WhenAllContext>();
-        whenAllContext->countdown = sizeof...(ValuesT);
-        whenAllContext->tuple_futures = std::tuple<Future<ValuesT>...>{ std::move(futures)... };
-        whenAllContext->exception_count = 0;
+            Promise<resultType> continuationPromise;
+            auto continuationFuture = continuationPromise.GetFuture();
 
-        foreach_number<0, sizeof...(ValuesT)>([whenAllContext = whenAllContext](auto idx)
-            {
-                auto& current_future = std::get<idx>(whenAllContext->tuple_futures);
-                auto& current_value = std::get<idx>(whenAllContext->values);
+            _status status = _persistent_state_->_status_.load(std::memory_order_acquire);
 
-                current_future.Then([whenAllContext = whenAllContext, v = &current_value](auto val)
+            if (_broadcastState::_hasFailed(status))
+            {
+                _persistent_state_->_forwardFailure(continuationPromise);
+            }
+            else if (status == _status::Value)
+            {
+                // If the promise has already been fulfilled,
+                // call the continuation function immediately
+                _internal_call_continuation(continuationPromise, [this, &fn]() noexcept(_internal_is_nothrow_continuation_v<FnT, shared_value_type>) -> resultType
                     {
-                        *v = std::move(val);
-                        if (0 == --whenAllContext->countdown) // The last underlying future to complete will set the value in the overall promise
-                        {
-                            if (whenAllContext->exception_count > 0)
-                            {
-                                ExceptionAggregate exceptionAggregate;
-                                for (std::exception_ptr e : whenAllContext->exceptions)
-                                {
-                                    if (e)
-                                    {
-                                        exceptionAggregate.Add(e);
-                                    }
-                                }
-                                whenAllContext->promise_all.SetException(std::move(exceptionAggregate));
-                            }
-                            else
-                            {
-                                whenAllContext->promise_all.SetValue(std::move(whenAllContext->values));
-                            }
-                        }
-                    }).OnException([whenAllContext = whenAllContext, idx = idx](std::exception_ptr e)
-                        {
-                            whenAllContext->exceptions[idx] = e;
-                            ++whenAllContext->exception_count;
-
-                            // The regular continuation won't be called if there is an exception so we need to do the countdown here to not get hanged
-                            if (0 == --whenAllContext->countdown)
-                            {
-                                ExceptionAggregate exceptionAggregate;
-                                for (std::exception_ptr e : whenAllContext->exceptions)
-                                {
-                                    if (e)
-                                    {
-                                        exceptionAggregate.Add(e);
-                                    }
-                                }
-                                whenAllContext->promise_all.SetException(std::move(exceptionAggregate));
-                            }
-                        });
-            });
+                        return fn(_sharedValue(_persistent_state_));
+                    });
+            }
+            else
+            {
+                _addContinuation(std::move(fn), std::move(continuationPromise));
+            }
 
-        return whenAllContext->promise_all.GetFuture();
-    }
+            return continuationFuture;
+        }
+    };
 
-    // "Persistent" future that can be accessed multiple times and have multiple continuation functions
+    // Future that can be copied and waited on or continued from any number of times.
+    // Continuations get a const reference to the value, so move-only types work and there is no
+    // reference counting per continuation. All copies share one intrusively counted state.
+    // There is no SharedFuture<void>, Split covers continuing a Future<void> more than once.
     template <typename ValueT>
-    class PersistentFuture
+    class SharedFuture
     {
+        static_assert(!std::is_same_v<ValueT, void>, "There is no SharedFuture<void>, use Future::Split!");
+
+    public:
+
+        using value_type = ValueT;
+        using argument_type = std::remove_reference_t<ValueT> const&;
+
     private:
 
-        struct _persistentState
+        using _broadcastState = _InternalBroadcastState<ValueT, argument_type>;
+        using _status = typename _broadcastState::_status;
+        using _subscriber = typename _broadcastState::_subscriber;
+
+        struct _sharedState : public _broadcastState
         {
-            std::mutex                    _mtx_value_;
-            std::condition_variable       _cv_value_;
-            std::shared_ptr<ValueT const> _value_;
-            std::exception_ptr            _exception_;
+            std::atomic_int _ref_count_ = 1;
 
-            std::vector<
-                std::pair<
-                    _InternalCallableHolder,
-                    _InternalCallableHolder::_ArgumentHolder<std::shared_ptr<ValueT const>>*>> _continuations_;
+            void _addRef() { ++_ref_count_; }
+
+            void _release()
+            {
+                if (0 == --_ref_count_)
+                {
+                    delete this;
+                }
+            }
         };
 
-        std::shared_ptr<_persistentState> _persistent_state_;
+        _sharedState* _state_;
+
+        void _complete(Result<ValueT>& result)
+        {
+            _subscriber* ordered = _state_->_closeWith(result);
+
+            _state_->_run(ordered, [state = _state_]() -> argument_type
+                {
+                    return state->_valueRef();
+                });
+        }
+
+        void _subscribe(_subscriber* sub) const
+        {
+            // Completed while the subscriber was being set up
+            if (!_state_->_push(sub))
+            {
+                _state_->_run(sub, [state = _state_]() -> argument_type
+                    {
+                        return state->_valueRef();
+                    });
+            }
+        }
 
         template <typename FnT>
-        void _addContinuation(FnT fn, Promise<std::invoke_result_t<FnT, std::shared_ptr<ValueT const>>> prom)
+        void _addContinuation(FnT fn, Promise<_internal_invoke_result_t<FnT, argument_type>> prom) const
         {
-            _persistent_state_->_continuations_.push_back({});
-            _persistent_state_->_continuations_.back().second =
-                _persistent_state_->_continuations_.back().first.template Init<FnT, std::shared_ptr<ValueT const>>(std::move(fn), std::move(prom));
+            _subscriber* sub = new _subscriber();
+            sub->_argument_holder_ = sub->_continuation_.template Init<FnT, argument_type>(std::move(fn), std::move(prom));
+            _subscribe(sub);
         }
 
         template <typename FnT>
-        void _addChainedContinuation(FnT fn, Promise<typename std::invoke_result_t<FnT, std::shared_ptr<ValueT const>>::value_type> prom)
+        void _addChainedContinuation(FnT fn, Promise<typename _internal_invoke_result_t<FnT, argument_type>::value_type> prom) const
         {
-            _persistent_state_->_continuations_.push_back({});
-            _persistent_state_->_continuations_.back().second =
-                _persistent_state_->_continuations_.back().first.template InitChained<FnT, std::shared_ptr<ValueT const>>(std::move(fn), std::move(prom));
+            _subscriber* sub = new _subscriber();
+            sub->_argument_holder_ = sub->_continuation_.template InitChained<FnT, argument_type>(std::move(fn), std::move(prom));
+            _subscribe(sub);
         }
 
     public:
 
-        PersistentFuture()
-            : _persistent_state_(nullptr)
+        SharedFuture() noexcept
+            : _state_(nullptr)
         { }
 
-        PersistentFuture(Future<ValueT> fut)
-            : _persistent_state_(std::make_shared<_persistentState>())
+        explicit SharedFuture(Future<ValueT> fut)
+            : _state_(new _sharedState())
         {
-            // Set a "proxy" continuation function on the base future that will set
-            // the value in the persistent state and call all continuation functions.
-            fut.Then([persistent_state = _persistent_state_](ValueT value)
+            // The proxy continuation holds a copy of us so the state lives until the value has been broadcast
+            fut.OnComplete([self = *this](Result<ValueT> result) mutable
                 {
-                    std::unique_lock lock(persistent_state->_mtx_value_);
-                    persistent_state->_value_ = std::make_shared<ValueT>(std::move(value));
+                    self._complete(result);
+                });
+        }
 
-                    for (auto& [fn, argHolder] : persistent_state->_continuations_)
-                    {
-                        argHolder->SetValue(persistent_state->_value_);
-                        fn.Call();
-                    }
+        SharedFuture(SharedFuture const& other) noexcept
+            : _state_(other._state_)
+        {
+            if (_state_)
+                _state_->_addRef();
+        }
+
+        SharedFuture(SharedFuture&& other) noexcept
+            : _state_(other._state_)
+        {
+            other._state_ = nullptr;
+        }
+
+        SharedFuture& operator=(SharedFuture const& other) noexcept
+        {
+            if (other._state_)
+                other._state_->_addRef();
 
-                    persistent_state->_continuations_.clear();
+            if (_state_)
+                _state_->_release();
 
-                    persistent_state->_cv_value_.notify_all();
-                }).OnException([persistent_state = _persistent_state_](std::exception_ptr e)
-                    {
-                        std::unique_lock lock(persistent_state->_mtx_value_);
-                        persistent_state->_exception_ = e;
-                        
-                        for (auto& [fn, argHolder] : persistent_state->_continuations_)
-                            fn.SetException(e);
+            _state_ = other._state_;
+            return *this;
+        }
+
+        SharedFuture& operator=(SharedFuture&& other) noexcept
+        {
+            if (this != &other)
+            {
+                if (_state_)
+                    _state_->_release();
+
+                _state_ = other._state_;
+                other._state_ = nullptr;
+            }
 
-                        persistent_state->_continuations_.clear();
+            return *this;
+        }
 
-                        persistent_state->_cv_value_.notify_all();
-                    });;
+        ~SharedFuture()
+        {
+            if (_state_)
+                _state_->_release();
         }
 
-        ValueT const& Get()
+        bool Valid() const
         {
-            std::unique_lock lck(_persistent_state_->_mtx_value_);
+            return _state_ != nullptr;
+        }
 
-            while (!_persistent_state_->_value_ && !_persistent_state_->_exception_)
+        argument_type Get() const
+        {
+            if (!_state_)
             {
-                _persistent_state_->_cv_value_.wait(lck);
+                throw FutureError(FutureErrorCode::NoState, "Future has no state!");
             }
 
-            if (_persistent_state_->_exception_)
-                std::rethrow_exception(_persistent_state_->_exception_);
+            if (_state_->_wait() != _status::Value)
+                _state_->_rethrow();
 
-            return *_persistent_state_->_value_;
+            return _state_->_valueRef();
         }
 
         // If the continuation function itself returns another Future object,
@@ -1261,35 +3047,39 @@ namespace TaskStuff
         // This specialization causes the Future on the top level to still be a simple Future<int> that can be awaited.
         template<typename FnT>
         std::enable_if_t<
-            _is_future_v<_internal_invoke_result_t<FnT, std::shared_ptr<ValueT const>>>,
-            _internal_invoke_result_t<FnT, std::shared_ptr<ValueT const>>> Then(FnT fn)
+            _is_future_v<_internal_invoke_result_t<FnT, argument_type>>,
+            Future<typename _internal_invoke_result_t<FnT, argument_type>::value_type>> Then(FnT fn) const
         {
-            using resultType = typename _internal_invoke_result_t<FnT, std::shared_ptr<ValueT const>>::value_type;
+            using resultType = typename _internal_invoke_result_t<FnT, argument_type>::value_type;
 
-            if (!_persistent_state_)
+            if (!_state_)
             {
                 throw FutureError(FutureErrorCode::NoState, "Future has no state!");
             }
 
             Future<resultType> continuationFuture;
 
-            // Scope for lock
-            {
-                std::unique_lock lck(_persistent_state_->_mtx_value_);
+            _status status = _state_->_status_.load(std::memory_order_acquire);
 
-                if (_persistent_state_->_exception_)
+            if (_broadcastState::_hasFailed(status))
+            {
+                Promise<resultType> continuationPromise;
+                continuationFuture = continuationPromise.GetFuture();
+                _state_->_forwardFailure(continuationPromise);
+            }
+            else if (status == _status::Value)
+            {
+                // If the promise has already been fulfilled,
+                // call the continuation function immediately
+                if constexpr (_internal_is_nothrow_continuation_v<FnT, argument_type>)
                 {
-                    Promise<resultType> continuationPromise;
-                    continuationFuture = continuationPromise.GetFuture();
-                    continuationPromise.SetException(_persistent_state_->_exception_);
+                    continuationFuture = fn(_state_->_valueRef());
                 }
-                else if (_persistent_state_->_value_)
+                else
                 {
-                    // If the promise has already been fulfilled,
-                    // call the continuation function immediately
                     try
                     {
-                        continuationFuture = fn(_persistent_state_->_value_);
+                        continuationFuture = fn(_state_->_valueRef());
                     }
                     catch (...)
                     {
@@ -1298,12 +3088,12 @@ namespace TaskStuff
                         continuationPromise.SetException(std::current_exception());
                     }
                 }
-                else
-                {
-                    Promise<resultType> continuationPromise;
-                    continuationFuture = continuationPromise.GetFuture();
-                    _addChainedContinuation(std::move(fn), std::move(continuationPromise));
-                }
+            }
+            else
+            {
+                Promise<resultType> continuationPromise;
+                continuationFuture = continuationPromise.GetFuture();
+                _addChainedContinuation(std::move(fn), std::move(continuationPromise));
             }
 
             return continuationFuture;
@@ -1311,12 +3101,12 @@ namespace TaskStuff
 
         template<typename FnT>
         std::enable_if_t<
-            _is_not_future_v<_internal_invoke_result_t<FnT, std::shared_ptr<ValueT const>>>,
-            Future<_internal_invoke_result_t<FnT, std::shared_ptr<ValueT const>>>> Then(FnT fn)
+            _is_not_future_v<_internal_invoke_result_t<FnT, argument_type>>,
+            Future<_internal_invoke_result_t<FnT, argument_type>>> Then(FnT fn) const
         {
-            using resultType = _internal_invoke_result_t<FnT, std::shared_ptr<ValueT const>>;
+            using resultType = _internal_invoke_result_t<FnT, argument_type>;
 
-            if (!_persistent_state_)
+            if (!_state_)
             {
                 throw FutureError(FutureErrorCode::NoState, "Future has no state!");
             }
@@ -1324,33 +3114,20 @@ namespace TaskStuff
             Promise<resultType> continuationPromise;
             auto continuationFuture = continuationPromise.GetFuture();
 
-            std::unique_lock lck(_persistent_state_->_mtx_value_);
+            _status status = _state_->_status_.load(std::memory_order_acquire);
 
-            if (_persistent_state_->_exception_)
+            if (_broadcastState::_hasFailed(status))
             {
-                continuationPromise.SetException(_persistent_state_->_exception_);
+                _state_->_forwardFailure(continuationPromise);
             }
-            else if (_persistent_state_->_value_)
+            else if (status == _status::Value)
             {
                 // If the promise has already been fulfilled,
                 // call the continuation function immediately
-                try
-                {
-                    if constexpr (std::is_same_v<resultType, void>)
-                    {
-                        fn(_persistent_state_->_value_);
-                        continuationPromise.SetDone();
-                    }
-                    else
+                _internal_call_continuation(continuationPromise, [this, &fn]() noexcept(_internal_is_nothrow_continuation_v<FnT, argument_type>) -> resultType
                     {
-                        auto result = fn(_persistent_state_->_value_);
-                        continuationPromise.SetValue(std::move(result));
-                    }
-                }
-                catch (...)
-                {
-                    continuationPromise.SetException(std::current_exception());
-                }
+                        return fn(_state_->_valueRef());
+                    });
             }
             else
             {
@@ -1360,4 +3137,111 @@ namespace TaskStuff
             return continuationFuture;
         }
     };
+
+    // co_await on a future suspends the coroutine until the future completes. It resumes on the
+    // thread that completed it, or right away if the future already was.
+    template <typename ValueT, typename SyncT>
+    class _InternalFutureAwaiter
+    {
+    private:
+
+        Future<ValueT, SyncT>          _future_;
+        std::optional<Result<ValueT>> _result_;
+
+    public:
+
+        explicit _InternalFutureAwaiter(Future<ValueT, SyncT> fut)
+            : _future_(std::move(fut))
+        { }
+
+        bool await_ready()
+        {
+            return _future_.IsReady();
+        }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            // The coroutine, and this awaiter with it, may be gone before OnComplete returns
+            Future<ValueT, SyncT> fut = std::move(_future_);
+
+            fut.OnComplete([this, handle](Result<ValueT> result)
+                {
+                    _result_.emplace(std::move(result));
+                    handle.resume();
+                });
+        }
+
+        ValueT await_resume()
+        {
+            if (!_result_)
+                _result_ = _future_.TryTake();
+
+            return _result_->Get();
+        }
+    };
+
+    template <typename ValueT, typename SyncT>
+    _InternalFutureAwaiter<ValueT, SyncT> operator co_await(Future<ValueT, SyncT>&& fut)
+    {
+        return _InternalFutureAwaiter<ValueT, SyncT>(std::move(fut));
+    }
+
+    // A named future is consumed like by Get(), it has no state once the awaiting coroutine resumes
+    template <typename ValueT, typename SyncT>
+    _InternalFutureAwaiter<ValueT, SyncT> operator co_await(Future<ValueT, SyncT>& fut)
+    {
+        return _InternalFutureAwaiter<ValueT, SyncT>(std::move(fut));
+    }
+
+    // Lets a coroutine return Future<T>: it runs eagerly until its first suspension and the
+    // future completes with what it co_returns or the exception that escaped it
+    template <typename ValueT, typename SyncT>
+    struct _InternalFutureCoroutineBase
+    {
+        Promise<ValueT, SyncT> _promise_;
+
+        Future<ValueT, SyncT> get_return_object()
+        {
+            return _promise_.GetFuture();
+        }
+
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void unhandled_exception()
+        {
+            _promise_.SetException(std::current_exception());
+        }
+    };
+
+    template <typename ValueT, typename SyncT>
+    struct _InternalFutureCoroutine : public _InternalFutureCoroutineBase<ValueT, SyncT>
+    {
+        void return_value(ValueT value)
+        {
+            this->_promise_.SetValue(std::forward<ValueT>(value));
+        }
+    };
+
+    template <typename SyncT>
+    struct _InternalFutureCoroutine<void, SyncT> : public _InternalFutureCoroutineBase<void, SyncT>
+    {
+        void return_void()
+        {
+            this->_promise_.SetDone();
+        }
+    };
 }
+
+template <typename ValueT, typename SyncT, typename... ArgsT>
+struct std::coroutine_traits<TaskStuff::Future<ValueT, SyncT>, ArgsT...>
+{
+    using promise_type = TaskStuff::_InternalFutureCoroutine<ValueT, SyncT>;
+};
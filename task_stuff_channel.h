@@ -0,0 +1,924 @@
+#pragma once
+
+#include "task_stuff.h"
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace TaskStuff
+{
+    // Bounded multi-producer multi-consumer ring (Vyukov). Every cell carries a sequence number
+    // telling producers and consumers whose turn it is, so neither side needs a lock.
+    template <typename ValueT>
+    class _InternalRing
+    {
+    private:
+
+        struct _cell
+        {
+            std::atomic<size_t>   _sequence_;
+            std::optional<ValueT> _value_;
+        };
+
+        std::unique_ptr<_cell[]> _cells_;
+        size_t                   _mask_;
+
+        alignas(64) std::atomic<size_t> _enqueue_pos_;
+        alignas(64) std::atomic<size_t> _dequeue_pos_;
+
+        // With a single cell a full ring would look empty to the next producer, so two is the minimum
+        static size_t _roundUp(size_t capacity)
+        {
+            size_t size = 2;
+            while (size < capacity)
+                size <<= 1;
+
+            return size;
+        }
+
+    public:
+
+        explicit _InternalRing(size_t capacity)
+            : _cells_(new _cell[_roundUp(capacity)])
+            , _mask_(_roundUp(capacity) - 1)
+            , _enqueue_pos_(0)
+            , _dequeue_pos_(0)
+        {
+            for (size_t i = 0; i <= _mask_; ++i)
+                _cells_[i]._sequence_.store(i, std::memory_order_relaxed);
+        }
+
+        size_t _capacity() const
+        {
+            return _mask_ + 1;
+        }
+
+        // Moves from value only on success
+        bool _tryPush(ValueT& value)
+        {
+            size_t pos = _enqueue_pos_.load(std::memory_order_relaxed);
+            _cell* cell;
+
+            while (true)
+            {
+                cell = &_cells_[pos & _mask_];
+                size_t sequence = cell->_sequence_.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+                if (diff == 0)
+                {
+                    if (_enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = _enqueue_pos_.load(std::memory_order_relaxed);
+                }
+            }
+
+            cell->_value_.emplace(std::move(value));
+            cell->_sequence_.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool _tryPop(std::optional<ValueT>& value)
+        {
+            size_t pos = _dequeue_pos_.load(std::memory_order_relaxed);
+            _cell* cell;
+
+            while (true)
+            {
+                cell = &_cells_[pos & _mask_];
+                size_t sequence = cell->_sequence_.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+
+                if (diff == 0)
+                {
+                    if (_dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = _dequeue_pos_.load(std::memory_order_relaxed);
+                }
+            }
+
+            value.emplace(std::move(*cell->_value_));
+            cell->_value_.reset();
+            cell->_sequence_.store(pos + _mask_ + 1, std::memory_order_release);
+            return true;
+        }
+    };
+
+    // Decides which branch of a Select runs. A channel holds the token reserved while it tries to
+    // move a value for one of the branches, other claimants sleep on the token until that resolves,
+    // so a value is never taken for a branch that then doesn't run.
+    class _InternalSelectToken
+    {
+    private:
+
+        static constexpr intptr_t _free = -1;
+        static constexpr intptr_t _reserved = -2;
+
+        std::atomic<intptr_t> _winner_;
+
+    public:
+
+        _InternalSelectToken()
+            : _winner_(_free)
+        { }
+
+        // False if another branch already won
+        bool _reserve()
+        {
+            intptr_t expected = _free;
+
+            while (!_winner_.compare_exchange_weak(expected, _reserved, std::memory_order_acquire))
+            {
+                if (expected >= 0)
+                    return false;
+
+                // Held only for a single ring operation, but that may be preempted
+                if (expected == _reserved)
+                    _winner_.wait(_reserved, std::memory_order_acquire);
+
+                expected = _free;
+            }
+
+            return true;
+        }
+
+        void _unreserve()
+        {
+            _winner_.store(_free, std::memory_order_release);
+            _winner_.notify_all();
+        }
+
+        void _commit(size_t branch)
+        {
+            _winner_.store(static_cast<intptr_t>(branch), std::memory_order_release);
+            _winner_.notify_all();
+        }
+
+        bool _tryClaim(size_t branch)
+        {
+            if (!_reserve())
+                return false;
+
+            _commit(branch);
+            return true;
+        }
+
+        bool _won(size_t branch) const
+        {
+            return _winner_.load(std::memory_order_acquire) == static_cast<intptr_t>(branch);
+        }
+
+        bool _decided() const
+        {
+            return _winner_.load(std::memory_order_acquire) >= 0;
+        }
+    };
+
+    template <typename ValueT>
+    class _InternalChannelState
+    {
+    public:
+
+        // Promises completed while the lock was held, fulfilled once it is released so
+        // continuations can use the channel again
+        struct _completions
+        {
+            std::vector<std::pair<Promise<ValueT>, ValueT>> _received_;
+            std::vector<Promise<void>>                      _sent_;
+            std::vector<Promise<ValueT>>                    _receivers_closed_;
+            std::vector<Promise<void>>                      _senders_closed_;
+
+            // Select branches that lost, broken only once the lock is released
+            std::vector<Promise<ValueT>>                    _receivers_dropped_;
+            std::vector<Promise<void>>                      _senders_dropped_;
+
+            void _run()
+            {
+                for (auto& [promise, value] : _received_)
+                    promise.SetValue(std::move(value));
+
+                for (auto& promise : _sent_)
+                    promise.SetDone();
+
+                for (auto& promise : _receivers_closed_)
+                    promise.SetException(FutureError(FutureErrorCode::ChannelClosed, "Channel is closed!"));
+
+                for (auto& promise : _senders_closed_)
+                    promise.SetException(FutureError(FutureErrorCode::ChannelClosed, "Channel is closed!"));
+            }
+        };
+
+        // Parked operation, a Select branch if it carries a token
+        template <typename PromiseT>
+        struct _waiter
+        {
+            PromiseT                              _promise_;
+            std::shared_ptr<_InternalSelectToken> _select_;
+            size_t                                _branch_;
+
+            _waiter(PromiseT promise, std::shared_ptr<_InternalSelectToken> select, size_t branch)
+                : _promise_(std::move(promise))
+                , _select_(std::move(select))
+                , _branch_(branch)
+            { }
+        };
+
+        struct _sender : public _waiter<Promise<void>>
+        {
+            ValueT _value_;
+
+            _sender(ValueT value, Promise<void> promise, std::shared_ptr<_InternalSelectToken> select, size_t branch)
+                : _waiter<Promise<void>>(std::move(promise), std::move(select), branch)
+                , _value_(std::move(value))
+            { }
+        };
+
+        using _receiver = _waiter<Promise<ValueT>>;
+
+        _InternalRing<ValueT> _ring_;
+
+        // Only touched with the lock held, the counters mirror the queue sizes for the fast paths
+        std::mutex            _mtx_;
+        std::deque<_sender>   _senders_;
+        std::deque<_receiver> _receivers_;
+        std::atomic<size_t>   _parked_senders_;
+        std::atomic<size_t>   _parked_receivers_;
+        std::atomic<bool>     _closed_;
+
+        explicit _InternalChannelState(size_t capacity)
+            : _ring_(capacity)
+            , _parked_senders_(0)
+            , _parked_receivers_(0)
+            , _closed_(false)
+        { }
+
+        // Called with the lock held. Select branches have to win their Select before they are
+        // completed, the ones that lost are dropped.
+        template <typename WaiterT, typename PromiseT>
+        static bool _claim(WaiterT& waiter, std::vector<PromiseT>& dropped)
+        {
+            if (!waiter._select_ || waiter._select_->_reserve())
+                return true;
+
+            dropped.push_back(std::move(waiter._promise_));
+            return false;
+        }
+
+        template <typename WaiterT>
+        static void _settle(WaiterT& waiter, bool done)
+        {
+            if (!waiter._select_)
+                return;
+
+            if (done)
+                waiter._select_->_commit(waiter._branch_);
+            else
+                waiter._select_->_unreserve();
+        }
+
+        template <typename QueueT, typename PromiseT>
+        static void _dropDecided(QueueT& waiters, std::vector<PromiseT>& dropped)
+        {
+            std::erase_if(waiters, [&](auto& waiter)
+                {
+                    if (!waiter._select_ || !waiter._select_->_decided())
+                        return false;
+
+                    dropped.push_back(std::move(waiter._promise_));
+                    return true;
+                });
+        }
+
+        // Called with the lock held. Moves values from the ring to parked receivers and from parked
+        // senders into the ring until neither side can make progress.
+        void _pump(_completions& done)
+        {
+            bool progress = true;
+
+            while (progress)
+            {
+                progress = false;
+
+                while (!_receivers_.empty())
+                {
+                    _receiver& receiver = _receivers_.front();
+
+                    if (!_claim(receiver, done._receivers_dropped_))
+                    {
+                        _receivers_.pop_front();
+                        continue;
+                    }
+
+                    std::optional<ValueT> value;
+                    bool popped = _ring_._tryPop(value);
+                    _settle(receiver, popped);
+
+                    if (!popped)
+                        break;
+
+                    done._received_.emplace_back(std::move(receiver._promise_), std::move(*value));
+                    _receivers_.pop_front();
+                    progress = true;
+                }
+
+                while (!_senders_.empty())
+                {
+                    _sender& sender = _senders_.front();
+
+                    if (!_claim(sender, done._senders_dropped_))
+                    {
+                        _senders_.pop_front();
+                        continue;
+                    }
+
+                    bool pushed = _ring_._tryPush(sender._value_);
+                    _settle(sender, pushed);
+
+                    if (!pushed)
+                        break;
+
+                    done._sent_.push_back(std::move(sender._promise_));
+                    _senders_.pop_front();
+                    progress = true;
+                }
+            }
+
+            // Receivers still waiting on a closed channel found it drained
+            if (_closed_.load(std::memory_order_relaxed))
+            {
+                for (_receiver& receiver : _receivers_)
+                {
+                    if (_claim(receiver, done._receivers_dropped_))
+                    {
+                        _settle(receiver, true);
+                        done._receivers_closed_.push_back(std::move(receiver._promise_));
+                    }
+                }
+
+                _receivers_.clear();
+            }
+
+            _parked_senders_.store(_senders_.size());
+            _parked_receivers_.store(_receivers_.size());
+        }
+
+        // Called with the lock held
+        void _parkSender(ValueT value, Promise<void> promise, std::shared_ptr<_InternalSelectToken> select, size_t branch, _completions& done)
+        {
+            if (_closed_.load(std::memory_order_relaxed))
+            {
+                _sender sender(std::move(value), std::move(promise), std::move(select), branch);
+
+                if (_claim(sender, done._senders_dropped_))
+                {
+                    _settle(sender, true);
+                    done._senders_closed_.push_back(std::move(sender._promise_));
+                }
+
+                return;
+            }
+
+            _senders_.emplace_back(std::move(value), std::move(promise), std::move(select), branch);
+            _parked_senders_.store(_senders_.size());
+
+            // Pairs with the fence of a receiver that took a value without the lock
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            _pump(done);
+        }
+
+        // Called with the lock held
+        void _parkReceiver(Promise<ValueT> promise, std::shared_ptr<_InternalSelectToken> select, size_t branch, _completions& done)
+        {
+            _receivers_.emplace_back(std::move(promise), std::move(select), branch);
+
+            _parked_receivers_.store(_receivers_.size());
+
+            // Pairs with the fence of a sender that pushed without the lock
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            _pump(done);
+        }
+
+        // Drops the parked branches of Selects that another branch already won. Until then they
+        // would keep the fast paths disabled on an otherwise idle channel.
+        void _prune()
+        {
+            _completions done;
+
+            // Scope for lock
+            {
+                std::unique_lock lck(_mtx_);
+
+                _dropDecided(_receivers_, done._receivers_dropped_);
+                _dropDecided(_senders_, done._senders_dropped_);
+
+                _parked_senders_.store(_senders_.size());
+                _parked_receivers_.store(_receivers_.size());
+            }
+        }
+
+        // Lets parked operations make progress after the fast path changed the ring
+        void _wake()
+        {
+            _completions done;
+
+            // Scope for lock
+            {
+                std::unique_lock lck(_mtx_);
+                _pump(done);
+            }
+
+            done._run();
+        }
+    };
+
+    // Bounded channel streaming values from any number of producers to any number of consumers.
+    // While there is room (or a value) Send and Receive go through the lock-free ring only; otherwise
+    // the operation is parked and its future completes once the other side makes room (backpressure).
+    // Parked operations complete in FIFO order, on the thread of the operation that freed them.
+    // Copies of a Channel refer to the same channel. Capacity is rounded up to a power of two (at least 2).
+    template <typename ValueT>
+    class Channel
+    {
+    private:
+
+        using _state = _InternalChannelState<ValueT>;
+
+        std::shared_ptr<_state> _state_;
+
+        friend class Select;
+
+        static Future<void> _closedSend()
+        {
+            Promise<void> promise;
+            auto fut = promise.GetFuture();
+            promise.SetException(FutureError(FutureErrorCode::ChannelClosed, "Channel is closed!"));
+            return fut;
+        }
+
+        void _checkState() const
+        {
+            if (!_state_)
+            {
+                throw FutureError(FutureErrorCode::NoState, "Channel has no state!");
+            }
+        }
+
+    public:
+
+        Channel() noexcept
+        { }
+
+        explicit Channel(size_t capacity)
+            : _state_(std::make_shared<_state>(capacity))
+        { }
+
+        bool Valid() const
+        {
+            return _state_ != nullptr;
+        }
+
+        size_t Capacity() const
+        {
+            _checkState();
+            return _state_->_ring_._capacity();
+        }
+
+        bool IsClosed() const
+        {
+            _checkState();
+            return _state_->_closed_.load(std::memory_order_acquire);
+        }
+
+        // Completes once the value is in the channel. Fails with FutureErrorCode::ChannelClosed
+        // if the channel is closed before that, the value is dropped then.
+        Future<void> Send(ValueT value)
+        {
+            _checkState();
+
+            _state& state = *_state_;
+
+            if (state._closed_.load(std::memory_order_acquire))
+                return _closedSend();
+
+            // Going around parked senders would reorder the values of a producer
+            if (state._parked_senders_.load() == 0 && state._ring_._tryPush(value))
+            {
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+
+                if (state._parked_receivers_.load() > 0)
+                    state._wake();
+
+                Promise<void> promise;
+                auto fut = promise.GetFuture();
+                promise.SetDone();
+                return fut;
+            }
+
+            Promise<void> promise;
+            auto fut = promise.GetFuture();
+            typename _state::_completions done;
+
+            // Scope for lock
+            {
+                std::unique_lock lck(state._mtx_);
+
+                state._parkSender(std::move(value), std::move(promise), nullptr, 0, done);
+            }
+
+            done._run();
+            return fut;
+        }
+
+        // Completes with the next value. Values sent before Close are still delivered,
+        // afterwards it fails with FutureErrorCode::ChannelClosed.
+        Future<ValueT> Receive()
+        {
+            _checkState();
+
+            _state& state = *_state_;
+
+            if (state._parked_receivers_.load() == 0)
+            {
+                std::optional<ValueT> value;
+
+                if (state._ring_._tryPop(value))
+                {
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+                    if (state._parked_senders_.load() > 0)
+                        state._wake();
+
+                    return Future<ValueT>(std::move(*value));
+                }
+            }
+
+            Promise<ValueT> promise;
+            auto fut = promise.GetFuture();
+            typename _state::_completions done;
+
+            // Scope for lock
+            {
+                std::unique_lock lck(state._mtx_);
+
+                state._parkReceiver(std::move(promise), nullptr, 0, done);
+            }
+
+            done._run();
+            return fut;
+        }
+
+        // Completes with between 1 and maxCount values: whatever is buffered once the first one is there.
+        // A maxCount of 0 completes right away with no values.
+        Future<std::vector<ValueT>> ReceiveMany(size_t maxCount)
+        {
+            _checkState();
+
+            if (maxCount == 0)
+                return Future<std::vector<ValueT>>(std::vector<ValueT>());
+
+            auto drain = [state = _state_, maxCount](std::vector<ValueT> values)
+                {
+                    std::optional<ValueT> value;
+
+                    while (values.size() < maxCount && state->_parked_receivers_.load() == 0 && state->_ring_._tryPop(value))
+                    {
+                        values.push_back(std::move(*value));
+                        value.reset();
+                    }
+
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+                    if (state->_parked_senders_.load() > 0)
+                        state->_wake();
+
+                    return values;
+                };
+
+            return Receive().Then([drain = std::move(drain)](ValueT first)
+                {
+                    std::vector<ValueT> values;
+                    values.push_back(std::move(first));
+                    return drain(std::move(values));
+                });
+        }
+
+        // Wakes parked senders with FutureErrorCode::ChannelClosed. Receivers drain what is buffered first.
+        void Close()
+        {
+            _checkState();
+
+            typename _state::_completions done;
+
+            // Scope for lock
+            {
+                std::unique_lock lck(_state_->_mtx_);
+
+                _state_->_closed_.store(true, std::memory_order_release);
+
+                for (auto& sender : _state_->_senders_)
+                {
+                    if (_state::_claim(sender, done._senders_dropped_))
+                    {
+                        _state::_settle(sender, true);
+                        done._senders_closed_.push_back(std::move(sender._promise_));
+                    }
+                }
+
+                _state_->_senders_.clear();
+                _state_->_pump(done);
+            }
+
+            done._run();
+        }
+    };
+
+    // Waits for whichever of several channel operations and futures is ready first, without blocking
+    // a thread. Exactly one branch runs: the first one to become ready claims the select, the channel
+    // operations of the others are withdrawn without taking or giving a value and the results of the
+    // other futures are dropped. Branches are tried in the order they were added.
+    class Select
+    {
+    private:
+
+        struct _state
+        {
+            _InternalSelectToken _token_;
+            Promise<size_t>      _promise_;
+
+            // Withdraw the channel operations of the branches that lost
+            std::mutex                         _mtx_;
+            std::vector<std::function<void()>> _prunes_;
+            bool                               _pruned_ = false;
+
+            // Called by channel branches once they are parked
+            void _addPrune(std::function<void()> prune)
+            {
+                // Scope for lock
+                {
+                    std::unique_lock lck(_mtx_);
+
+                    if (!_pruned_)
+                    {
+                        _prunes_.push_back(std::move(prune));
+                        return;
+                    }
+                }
+
+                // Parked after the select was decided
+                prune();
+            }
+
+            void _pruneLosers()
+            {
+                std::vector<std::function<void()>> prunes;
+
+                // Scope for lock
+                {
+                    std::unique_lock lck(_mtx_);
+                    _pruned_ = true;
+                    prunes.swap(_prunes_);
+                }
+
+                for (auto& prune : prunes)
+                    prune();
+            }
+
+            // Runs the handler of the winning branch, then completes the select with its index
+            template <typename FnT>
+            void _finish(size_t branch, FnT fn)
+            {
+                _pruneLosers();
+
+                try
+                {
+                    fn();
+                    _promise_.SetValue(branch);
+                }
+                catch (...)
+                {
+                    _promise_.SetException(std::current_exception());
+                }
+            }
+        };
+
+        // Weak, so a select that never completes doesn't keep its channels alive
+        template <typename ValueT>
+        static std::function<void()> _pruneOf(Channel<ValueT> const& channel)
+        {
+            return [weak = std::weak_ptr<_InternalChannelState<ValueT>>(channel._state_)]()
+                {
+                    if (auto channelState = weak.lock())
+                        channelState->_prune();
+                };
+        }
+
+        class _branch
+        {
+        public:
+
+            virtual void _register(std::shared_ptr<_state> const& state, size_t branch) = 0;
+            virtual ~_branch() {}
+        };
+
+        template <typename ValueT, typename FnT>
+        class _receiveBranch final : public _branch
+        {
+        private:
+
+            Channel<ValueT> _channel_;
+            FnT             _fn_;
+
+        public:
+
+            _receiveBranch(Channel<ValueT> channel, FnT fn)
+                : _channel_(std::move(channel))
+                , _fn_(std::move(fn))
+            { }
+
+            void _register(std::shared_ptr<_state> const& state, size_t branch) override
+            {
+                Promise<ValueT> promise;
+
+                promise.GetFuture().OnComplete([state, branch, fn = std::move(_fn_)](Result<ValueT> result) mutable
+                    {
+                        // Broken promises of withdrawn branches end up here too
+                        if (!state->_token_._won(branch))
+                            return;
+
+                        state->_finish(branch, [&]()
+                            {
+                                fn(result.Get());
+                            });
+                    });
+
+                auto& channelState = *_channel_._state_;
+                typename _InternalChannelState<ValueT>::_completions done;
+
+                // Scope for lock
+                {
+                    std::unique_lock lck(channelState._mtx_);
+                    channelState._parkReceiver(std::move(promise), std::shared_ptr<_InternalSelectToken>(state, &state->_token_), branch, done);
+                }
+
+                done._run();
+                state->_addPrune(_pruneOf(_channel_));
+            }
+        };
+
+        template <typename ValueT, typename FnT>
+        class _sendBranch final : public _branch
+        {
+        private:
+
+            Channel<ValueT> _channel_;
+            ValueT          _value_;
+            FnT             _fn_;
+
+        public:
+
+            _sendBranch(Channel<ValueT> channel, ValueT value, FnT fn)
+                : _channel_(std::move(channel))
+                , _value_(std::move(value))
+                , _fn_(std::move(fn))
+            { }
+
+            void _register(std::shared_ptr<_state> const& state, size_t branch) override
+            {
+                Promise<void> promise;
+
+                promise.GetFuture().OnComplete([state, branch, fn = std::move(_fn_)](Result<void> result) mutable
+                    {
+                        if (!state->_token_._won(branch))
+                            return;
+
+                        state->_finish(branch, [&]()
+                            {
+                                result.Get();
+                                fn();
+                            });
+                    });
+
+                auto& channelState = *_channel_._state_;
+                typename _InternalChannelState<ValueT>::_completions done;
+
+                // Scope for lock
+                {
+                    std::unique_lock lck(channelState._mtx_);
+                    channelState._parkSender(std::move(_value_), std::move(promise), std::shared_ptr<_InternalSelectToken>(state, &state->_token_), branch, done);
+                }
+
+                done._run();
+                state->_addPrune(_pruneOf(_channel_));
+            }
+        };
+
+        template <typename ValueT, typename SyncT, typename FnT>
+        class _futureBranch final : public _branch
+        {
+        private:
+
+            Future<ValueT, SyncT> _future_;
+            FnT                   _fn_;
+
+        public:
+
+            _futureBranch(Future<ValueT, SyncT> fut, FnT fn)
+                : _future_(std::move(fut))
+                , _fn_(std::move(fn))
+            { }
+
+            void _register(std::shared_ptr<_state> const& state, size_t branch) override
+            {
+                _future_.OnComplete([state, branch, fn = std::move(_fn_)](Result<ValueT> result) mutable
+                    {
+                        if (!state->_token_._tryClaim(branch))
+                            return;
+
+                        state->_finish(branch, [&]()
+                            {
+                                fn(std::move(result));
+                            });
+                    });
+            }
+        };
+
+        std::vector<std::unique_ptr<_branch>> _branches_;
+
+    public:
+
+        // fn(ValueT) gets the received value. If the channel is closed and drained the select fails
+        // with FutureErrorCode::ChannelClosed instead.
+        template <typename ValueT, typename FnT>
+        Select& Receive(Channel<ValueT> const& channel, FnT fn)
+        {
+            channel._checkState();
+            _branches_.push_back(std::make_unique<_receiveBranch<ValueT, FnT>>(channel, std::move(fn)));
+            return *this;
+        }
+
+        // fn() runs once the value is in the channel. The value is dropped if another branch wins.
+        // If the channel is closed before that the select fails with FutureErrorCode::ChannelClosed
+        // instead, right away if it already is.
+        template <typename ValueT, typename FnT>
+        Select& Send(Channel<ValueT> const& channel, ValueT value, FnT fn)
+        {
+            channel._checkState();
+            _branches_.push_back(std::make_unique<_sendBranch<ValueT, FnT>>(channel, std::move(value), std::move(fn)));
+            return *this;
+        }
+
+        // fn(Result<ValueT>) gets the outcome of the future, failed ones win like any other
+        template <typename ValueT, typename SyncT, typename FnT>
+        Select& OnReady(Future<ValueT, SyncT> fut, FnT fn)
+        {
+            if (!fut.Valid())
+            {
+                throw FutureError(FutureErrorCode::NoState, "Future has no state!");
+            }
+
+            _branches_.push_back(std::make_unique<_futureBranch<ValueT, SyncT, FnT>>(std::move(fut), std::move(fn)));
+            return *this;
+        }
+
+        // Arms all branches. The returned future completes with the index of the branch that ran,
+        // after its handler returned, or with the exception the handler threw.
+        Future<size_t> Run()
+        {
+            if (_branches_.empty())
+            {
+                throw FutureError(FutureErrorCode::NoState, "Select has no branches!");
+            }
+
+            auto state = std::make_shared<_state>();
+            auto fut = state->_promise_.GetFuture();
+
+            // Once a branch completed while being armed the rest can't win anymore
+            for (size_t i = 0; i < _branches_.size() && !state->_token_._decided(); ++i)
+                _branches_[i]->_register(state, i);
+
+            _branches_.clear();
+            return fut;
+        }
+    };
+}
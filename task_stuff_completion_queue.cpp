@@ -0,0 +1,94 @@
+#include "task_stuff_completion_queue.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <iterator>
+#include <system_error>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace TaskStuff
+{
+    _InternalCompletionQueueState::_InternalCompletionQueueState()
+        : _event_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+    {
+        if (_event_fd_ < 0)
+            throw std::system_error(errno, std::system_category(), "eventfd");
+    }
+
+    _InternalCompletionQueueState::~_InternalCompletionQueueState()
+    {
+        close(_event_fd_);
+    }
+
+    void _InternalCompletionQueueState::_wake()
+    {
+        uint64_t one = 1;
+        while (write(_event_fd_, &one, sizeof(one)) < 0 && errno == EINTR)
+        { }
+    }
+
+    void _InternalCompletionQueueState::_push(Task task)
+    {
+        bool wasEmpty = false;
+
+        // Scope for lock
+        {
+            std::unique_lock lck(_mtx_queue_);
+            wasEmpty = _queue_.empty();
+            _queue_.push_back(std::move(task));
+        }
+
+        // Only the first handler of a batch has to wake the loop up
+        if (wasEmpty)
+            _wake();
+    }
+
+    size_t _InternalCompletionQueueState::_dispatch()
+    {
+        // Reset the eventfd before taking the queue, anything pushed after that writes it again
+        uint64_t count = 0;
+        while (read(_event_fd_, &count, sizeof(count)) < 0 && errno == EINTR)
+        { }
+
+        std::deque<Task> ready;
+
+        // Scope for lock
+        {
+            std::unique_lock lck(_mtx_queue_);
+            ready.swap(_queue_);
+        }
+
+        size_t ran = 0;
+
+        try
+        {
+            while (!ready.empty())
+            {
+                Task task = std::move(ready.front());
+                ready.pop_front();
+                ++ran;
+                task();
+            }
+        }
+        catch (...)
+        {
+            // Hand the rest of the batch back, ahead of anything queued meanwhile
+            if (!ready.empty())
+            {
+                // Scope for lock
+                {
+                    std::unique_lock lck(_mtx_queue_);
+                    _queue_.insert(_queue_.begin(), std::make_move_iterator(ready.begin()), std::make_move_iterator(ready.end()));
+                }
+
+                _wake();
+            }
+
+            throw;
+        }
+
+        return ran;
+    }
+}
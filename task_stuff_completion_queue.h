@@ -0,0 +1,85 @@
+#pragma once
+
+#include "task_stuff.h"
+
+#include <deque>
+#include <memory>
+#include <mutex>
+
+namespace TaskStuff
+{
+    // Shared with the completion callbacks so a queue can be destroyed while futures are still pending
+    class _InternalCompletionQueueState
+    {
+    private:
+
+        int              _event_fd_;
+        std::mutex       _mtx_queue_;
+        std::deque<Task> _queue_;
+
+        _InternalCompletionQueueState(_InternalCompletionQueueState const&) = delete;
+        _InternalCompletionQueueState& operator=(_InternalCompletionQueueState const&) = delete;
+
+        void _wake();
+
+    public:
+
+        _InternalCompletionQueueState();
+        ~_InternalCompletionQueueState();
+
+        int _fd() const
+        {
+            return _event_fd_;
+        }
+
+        void _push(Task task);
+        size_t _dispatch();
+    };
+
+    // Lets an epoll/poll/select event loop wait for futures without a bridging thread.
+    // Completed futures queue their handler and make one eventfd readable, the loop then calls
+    // Dispatch to run the handlers on its own thread. Any number of futures can share one queue.
+    class CompletionQueue
+    {
+    private:
+
+        std::shared_ptr<_InternalCompletionQueueState> _state_;
+
+        CompletionQueue(CompletionQueue const&) = delete;
+        CompletionQueue& operator=(CompletionQueue const&) = delete;
+
+    public:
+
+        CompletionQueue()
+            : _state_(std::make_shared<_InternalCompletionQueueState>())
+        { }
+
+        // Becomes readable when handlers are waiting to be dispatched. Non-blocking, owned by the queue.
+        int FileDescriptor() const
+        {
+            return _state_->_fd();
+        }
+
+        // Once fut completes, fn(Result<ValueT>) is queued to run in the next Dispatch
+        template <typename ValueT, typename FnT>
+        void Add(Future<ValueT> fut, FnT fn)
+        {
+            fut.OnComplete([state = _state_, fn = std::move(fn)](Result<ValueT> result) mutable
+                {
+                    state->_push([fn = std::move(fn), result = std::move(result)]() mutable
+                        {
+                            fn(std::move(result));
+                        });
+                });
+        }
+
+        // Runs the handlers of all futures that completed so far and returns how many ran.
+        // Call it whenever FileDescriptor() polls readable. An exception thrown by a handler
+        // leaves Dispatch, the handlers that didn't run yet stay queued for the next call and
+        // the descriptor stays readable.
+        size_t Dispatch()
+        {
+            return _state_->_dispatch();
+        }
+    };
+}
@@ -0,0 +1,632 @@
+#include "task_stuff_file.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace TaskStuff
+{
+    namespace
+    {
+        std::error_code _errnoCode(int error)
+        {
+            return std::error_code(error, std::system_category());
+        }
+
+        // Fulfils the promise of one request from its result, negative results are -errno
+        class _FileOperation
+        {
+        public:
+
+            virtual void Complete(int64_t result) = 0;
+            virtual ~_FileOperation() {}
+        };
+
+        class _TransferOperation final : public _FileOperation
+        {
+        public:
+
+            Promise<size_t> _promise_;
+
+            void Complete(int64_t result) override
+            {
+                if (result < 0)
+                    _promise_.SetError(_errnoCode(static_cast<int>(-result)));
+                else
+                    _promise_.SetValue(static_cast<size_t>(result));
+            }
+        };
+
+        class _FsyncOperation final : public _FileOperation
+        {
+        public:
+
+            Promise<void> _promise_;
+
+            void Complete(int64_t result) override
+            {
+                if (result < 0)
+                    _promise_.SetError(_errnoCode(static_cast<int>(-result)));
+                else
+                    _promise_.SetDone();
+            }
+        };
+    }
+
+    class _InternalFileBackend
+    {
+    public:
+
+        virtual bool UsesIoUring() const = 0;
+        virtual void Read(int fd, std::span<std::byte> buffer, uint64_t offset, _FileOperation* op) = 0;
+        virtual void Write(int fd, std::span<std::byte const> buffer, uint64_t offset, _FileOperation* op) = 0;
+        virtual void Fsync(int fd, _FileOperation* op) = 0;
+        virtual ~_InternalFileBackend() {}
+    };
+
+    namespace
+    {
+        class _IoUringBackend final : public _InternalFileBackend
+        {
+        private:
+
+            int                  _ring_fd_ = -1;
+            void*                _sq_ring_ = MAP_FAILED;
+            size_t               _sq_ring_size_ = 0;
+            void*                _cq_ring_ = MAP_FAILED;
+            size_t               _cq_ring_size_ = 0;
+            io_uring_sqe*        _sqes_ = static_cast<io_uring_sqe*>(MAP_FAILED);
+            size_t               _sqes_size_ = 0;
+
+            unsigned*            _sq_head_ = nullptr;
+            unsigned*            _sq_tail_ = nullptr;
+            unsigned*            _sq_array_ = nullptr;
+            unsigned             _sq_mask_ = 0;
+            unsigned             _sq_entries_ = 0;
+
+            unsigned*            _cq_head_ = nullptr;
+            unsigned*            _cq_tail_ = nullptr;
+            io_uring_cqe*        _cqes_ = nullptr;
+            unsigned             _cq_mask_ = 0;
+            unsigned             _cq_entries_ = 0;
+
+            std::mutex              _mtx_submit_;
+            std::condition_variable _cv_capacity_;
+            unsigned                _unsubmitted_ = 0;
+            size_t                  _in_flight_ = 0;
+            bool                    _flushing_ = false;
+
+            // Requests submitted by continuations on the completion thread while the ring was full,
+            // that thread can't wait for capacity as it is the one freeing it
+            std::deque<io_uring_sqe> _overflow_;
+
+            static inline thread_local _IoUringBackend* _completing_ = nullptr;
+
+            std::thread             _completion_thread_;
+
+            static unsigned* _field(void* ring, uint32_t offset)
+            {
+                return reinterpret_cast<unsigned*>(static_cast<uint8_t*>(ring) + offset);
+            }
+
+            void _unmap()
+            {
+                if (_sqes_ != MAP_FAILED)
+                    munmap(_sqes_, _sqes_size_);
+
+                if (_cq_ring_ != MAP_FAILED && _cq_ring_ != _sq_ring_)
+                    munmap(_cq_ring_, _cq_ring_size_);
+
+                if (_sq_ring_ != MAP_FAILED)
+                    munmap(_sq_ring_, _sq_ring_size_);
+
+                if (_ring_fd_ >= 0)
+                    close(_ring_fd_);
+            }
+
+            int _enter(unsigned toSubmit, unsigned minComplete, unsigned flags)
+            {
+                return static_cast<int>(syscall(__NR_io_uring_enter, _ring_fd_, toSubmit, minComplete, flags, nullptr, 0));
+            }
+
+            bool _hasCapacity() const
+            {
+                unsigned queued = std::atomic_ref<unsigned>(*_sq_tail_).load(std::memory_order_relaxed) -
+                                  std::atomic_ref<unsigned>(*_sq_head_).load(std::memory_order_acquire);
+
+                // Every request in flight needs a completion entry, so never queue more than those
+                return _in_flight_ < _cq_entries_ && queued < _sq_entries_;
+            }
+
+            // Called with the lock held after io_uring_enter failed, which means it consumed none
+            // of the entries it was given. Takes the entries not submitted yet back off the ring
+            // and returns their requests in the order they were queued.
+            std::vector<_FileOperation*> _withdrawUnsubmitted()
+            {
+                std::vector<_FileOperation*> withdrawn;
+                unsigned tail = std::atomic_ref<unsigned>(*_sq_tail_).load(std::memory_order_relaxed);
+
+                for (unsigned i = _unsubmitted_; i > 0; --i)
+                {
+                    io_uring_sqe const& sqe = _sqes_[(tail - i) & _sq_mask_];
+
+                    if (sqe.user_data != 0)
+                        withdrawn.push_back(reinterpret_cast<_FileOperation*>(sqe.user_data));
+                }
+
+                std::atomic_ref<unsigned>(*_sq_tail_).store(tail - _unsubmitted_, std::memory_order_release);
+
+                _in_flight_ -= _unsubmitted_;
+                _unsubmitted_ = 0;
+
+                return withdrawn;
+            }
+
+            // Called with the lock held and capacity available
+            void _place(io_uring_sqe const& entry)
+            {
+                unsigned tail = std::atomic_ref<unsigned>(*_sq_tail_).load(std::memory_order_relaxed);
+                unsigned index = tail & _sq_mask_;
+
+                _sqes_[index] = entry;
+                _sq_array_[index] = index;
+                std::atomic_ref<unsigned>(*_sq_tail_).store(tail + 1, std::memory_order_release);
+
+                ++_in_flight_;
+                ++_unsubmitted_;
+            }
+
+            // Returns false if the ring failed, the requests queued but not submitted by then
+            // (including op) have been completed with the error
+            template <typename FillFnT>
+            bool _submit(FillFnT const& fill, _FileOperation* op)
+            {
+                io_uring_sqe entry;
+                std::memset(&entry, 0, sizeof(entry));
+                fill(&entry);
+                entry.user_data = reinterpret_cast<uint64_t>(op);
+
+                std::unique_lock lck(_mtx_submit_);
+
+                if (_completing_ == this && !_hasCapacity())
+                {
+                    _overflow_.push_back(entry);
+                    return true;
+                }
+
+                _cv_capacity_.wait(lck, [this]() { return _hasCapacity(); });
+
+                _place(entry);
+                return _flush(lck);
+            }
+
+            // Called with the lock held after queuing entries
+            bool _flush(std::unique_lock<std::mutex>& lck)
+            {
+                // The thread that queued the first entry of a batch submits it, entries queued
+                // while it is in io_uring_enter are picked up by its next round
+                if (_flushing_)
+                    return true;
+
+                _flushing_ = true;
+
+                while (_unsubmitted_ > 0)
+                {
+                    unsigned count = _unsubmitted_;
+                    lck.unlock();
+
+                    int submitted = _enter(count, 0, 0);
+                    int error = errno;
+
+                    lck.lock();
+
+                    if (submitted > 0)
+                        _unsubmitted_ -= static_cast<unsigned>(submitted);
+                    else if (submitted < 0 && error != EINTR && error != EAGAIN && error != EBUSY)
+                    {
+                        std::vector<_FileOperation*> failed = _withdrawUnsubmitted();
+                        _flushing_ = false;
+                        lck.unlock();
+
+                        _cv_capacity_.notify_all();
+
+                        // Continuations may submit again, so the requests are failed without the lock
+                        for (_FileOperation* failedOp : failed)
+                        {
+                            failedOp->Complete(-error);
+                            delete failedOp;
+                        }
+
+                        return false;
+                    }
+
+                    _cv_capacity_.notify_all();
+                }
+
+                _flushing_ = false;
+                return true;
+            }
+
+            // A single read or write transfers at most this much, the rest is reported as a short
+            // transfer. Linux caps every read and write a little below 2 GiB anyway.
+            static uint32_t _length(size_t size)
+            {
+                return static_cast<uint32_t>(std::min<size_t>(size, UINT32_MAX));
+            }
+
+            void _completionLoop()
+            {
+                _completing_ = this;
+
+                while (true)
+                {
+                    // Interrupted waits just find nothing to reap
+                    _enter(0, 1, IORING_ENTER_GETEVENTS);
+
+                    unsigned head = std::atomic_ref<unsigned>(*_cq_head_).load(std::memory_order_relaxed);
+                    unsigned tail = std::atomic_ref<unsigned>(*_cq_tail_).load(std::memory_order_acquire);
+
+                    size_t completed = 0;
+                    bool stopping = false;
+
+                    for (; head != tail; ++head)
+                    {
+                        io_uring_cqe const& cqe = _cqes_[head & _cq_mask_];
+
+                        // The no-op submitted by the destructor
+                        if (cqe.user_data == 0)
+                        {
+                            stopping = true;
+                            continue;
+                        }
+
+                        _FileOperation* op = reinterpret_cast<_FileOperation*>(cqe.user_data);
+                        op->Complete(cqe.res);
+                        delete op;
+
+                        ++completed;
+                    }
+
+                    std::atomic_ref<unsigned>(*_cq_head_).store(head, std::memory_order_release);
+
+                    if (completed > 0)
+                    {
+                        // Scope for lock
+                        {
+                            std::unique_lock lck(_mtx_submit_);
+                            _in_flight_ -= completed;
+
+                            bool placed = false;
+
+                            while (!_overflow_.empty() && _hasCapacity())
+                            {
+                                _place(_overflow_.front());
+                                _overflow_.pop_front();
+                                placed = true;
+                            }
+
+                            if (placed)
+                                _flush(lck);
+                        }
+
+                        _cv_capacity_.notify_all();
+                    }
+
+                    if (stopping)
+                        return;
+                }
+            }
+
+        public:
+
+            explicit _IoUringBackend(unsigned queueDepth)
+            {
+                io_uring_params params;
+                std::memset(&params, 0, sizeof(params));
+
+                _ring_fd_ = static_cast<int>(syscall(__NR_io_uring_setup, queueDepth, &params));
+
+                if (_ring_fd_ < 0)
+                    throw std::system_error(errno, std::system_category(), "io_uring_setup");
+
+                // IORING_OP_READ and IORING_OP_WRITE came with the same kernel release
+                if (!(params.features & IORING_FEAT_RW_CUR_POS))
+                {
+                    _unmap();
+                    throw std::system_error(ENOSYS, std::system_category(), "io_uring without IORING_OP_READ");
+                }
+
+                _sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+                _cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+                if (params.features & IORING_FEAT_SINGLE_MMAP)
+                    _sq_ring_size_ = _cq_ring_size_ = std::max(_sq_ring_size_, _cq_ring_size_);
+
+                _sq_ring_ = mmap(nullptr, _sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd_, IORING_OFF_SQ_RING);
+
+                if (params.features & IORING_FEAT_SINGLE_MMAP)
+                    _cq_ring_ = _sq_ring_;
+                else if (_sq_ring_ != MAP_FAILED)
+                    _cq_ring_ = mmap(nullptr, _cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd_, IORING_OFF_CQ_RING);
+
+                _sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+
+                if (_cq_ring_ != MAP_FAILED)
+                    _sqes_ = static_cast<io_uring_sqe*>(mmap(nullptr, _sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd_, IORING_OFF_SQES));
+
+                if (_sqes_ == MAP_FAILED)
+                {
+                    int error = errno;
+                    _unmap();
+                    throw std::system_error(error, std::system_category(), "mmap io_uring");
+                }
+
+                _sq_head_ = _field(_sq_ring_, params.sq_off.head);
+                _sq_tail_ = _field(_sq_ring_, params.sq_off.tail);
+                _sq_array_ = _field(_sq_ring_, params.sq_off.array);
+                _sq_mask_ = *_field(_sq_ring_, params.sq_off.ring_mask);
+                _sq_entries_ = params.sq_entries;
+
+                _cq_head_ = _field(_cq_ring_, params.cq_off.head);
+                _cq_tail_ = _field(_cq_ring_, params.cq_off.tail);
+                _cqes_ = reinterpret_cast<io_uring_cqe*>(static_cast<uint8_t*>(_cq_ring_) + params.cq_off.cqes);
+                _cq_mask_ = *_field(_cq_ring_, params.cq_off.ring_mask);
+                _cq_entries_ = params.cq_entries;
+
+                _completion_thread_ = std::thread([this]()
+                    {
+                        _completionLoop();
+                    });
+            }
+
+            ~_IoUringBackend()
+            {
+                // Scope for lock
+                {
+                    std::unique_lock lck(_mtx_submit_);
+                    _cv_capacity_.wait(lck, [this]() { return _in_flight_ == 0 && _overflow_.empty(); });
+                }
+
+                // Completions aren't ordered, so the no-op is only sent once everything else is done
+                bool submitted = _submit([](io_uring_sqe* sqe)
+                    {
+                        sqe->opcode = IORING_OP_NOP;
+                    }, nullptr);
+
+                if (!submitted)
+                {
+                    // The ring is broken and the completion thread can't be told to stop. Nothing
+                    // is in flight anymore, leave it waiting on the ring which stays mapped for it.
+                    _completion_thread_.detach();
+                    return;
+                }
+
+                _completion_thread_.join();
+                _unmap();
+            }
+
+            bool UsesIoUring() const override
+            {
+                return true;
+            }
+
+            void Read(int fd, std::span<std::byte> buffer, uint64_t offset, _FileOperation* op) override
+            {
+                _submit([&](io_uring_sqe* sqe)
+                    {
+                        sqe->opcode = IORING_OP_READ;
+                        sqe->fd = fd;
+                        sqe->addr = reinterpret_cast<uint64_t>(buffer.data());
+                        sqe->len = _length(buffer.size());
+                        sqe->off = offset;
+                    }, op);
+            }
+
+            void Write(int fd, std::span<std::byte const> buffer, uint64_t offset, _FileOperation* op) override
+            {
+                _submit([&](io_uring_sqe* sqe)
+                    {
+                        sqe->opcode = IORING_OP_WRITE;
+                        sqe->fd = fd;
+                        sqe->addr = reinterpret_cast<uint64_t>(buffer.data());
+                        sqe->len = _length(buffer.size());
+                        sqe->off = offset;
+                    }, op);
+            }
+
+            void Fsync(int fd, _FileOperation* op) override
+            {
+                _submit([&](io_uring_sqe* sqe)
+                    {
+                        sqe->opcode = IORING_OP_FSYNC;
+                        sqe->fd = fd;
+                    }, op);
+            }
+        };
+
+        class _ThreadPoolBackend final : public _InternalFileBackend
+        {
+        private:
+
+            ThreadPool _pool_;
+
+            template <typename CallT>
+            void _run(_FileOperation* op, CallT call)
+            {
+                _pool_.Execute([op, call]()
+                    {
+                        int64_t result = 0;
+
+                        do
+                        {
+                            result = call();
+                        }
+                        while (result < 0 && errno == EINTR);
+
+                        op->Complete(result < 0 ? -errno : result);
+                        delete op;
+                    });
+            }
+
+        public:
+
+            bool UsesIoUring() const override
+            {
+                return false;
+            }
+
+            void Read(int fd, std::span<std::byte> buffer, uint64_t offset, _FileOperation* op) override
+            {
+                _run(op, [fd, buffer, offset]() -> int64_t
+                    {
+                        return pread(fd, buffer.data(), buffer.size(), static_cast<off_t>(offset));
+                    });
+            }
+
+            void Write(int fd, std::span<std::byte const> buffer, uint64_t offset, _FileOperation* op) override
+            {
+                _run(op, [fd, buffer, offset]() -> int64_t
+                    {
+                        return pwrite(fd, buffer.data(), buffer.size(), static_cast<off_t>(offset));
+                    });
+            }
+
+            void Fsync(int fd, _FileOperation* op) override
+            {
+                _run(op, [fd]() -> int64_t
+                    {
+                        return fsync(fd);
+                    });
+            }
+        };
+    }
+
+    FileIoService::FileIoService(FileIoBackend backend, unsigned queueDepth)
+    {
+        if (backend == FileIoBackend::Auto)
+        {
+            try
+            {
+                _backend_ = std::make_unique<_IoUringBackend>(queueDepth);
+            }
+            catch (std::system_error const&)
+            {
+                // Not supported or not permitted, fall back to the pool below
+            }
+        }
+
+        if (!_backend_)
+            _backend_ = std::make_unique<_ThreadPoolBackend>();
+    }
+
+    FileIoService::~FileIoService() = default;
+
+    bool FileIoService::UsesIoUring() const
+    {
+        return _backend_->UsesIoUring();
+    }
+
+    Future<size_t> FileIoService::Read(int fd, std::span<std::byte> buffer, uint64_t offset)
+    {
+        auto* op = new _TransferOperation();
+        auto fut = op->_promise_.GetFuture();
+        _backend_->Read(fd, buffer, offset, op);
+        return fut;
+    }
+
+    Future<size_t> FileIoService::Write(int fd, std::span<std::byte const> buffer, uint64_t offset)
+    {
+        auto* op = new _TransferOperation();
+        auto fut = op->_promise_.GetFuture();
+        _backend_->Write(fd, buffer, offset, op);
+        return fut;
+    }
+
+    Future<void> FileIoService::Fsync(int fd)
+    {
+        auto* op = new _FsyncOperation();
+        auto fut = op->_promise_.GetFuture();
+        _backend_->Fsync(fd, op);
+        return fut;
+    }
+
+    AsyncFile& AsyncFile::operator=(AsyncFile&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Close();
+
+            _service_ = other._service_;
+            _fd_ = other._fd_;
+
+            other._service_ = nullptr;
+            other._fd_ = -1;
+        }
+
+        return *this;
+    }
+
+    AsyncFile::~AsyncFile()
+    {
+        Close();
+    }
+
+    AsyncFile AsyncFile::Open(FileIoService& service, std::string const& path, int flags, int mode)
+    {
+        int fd = open(path.c_str(), flags | O_CLOEXEC, mode);
+
+        if (fd < 0)
+            throw std::system_error(errno, std::system_category(), path);
+
+        return AsyncFile(service, fd);
+    }
+
+    void AsyncFile::Close()
+    {
+        if (_fd_ >= 0)
+            close(_fd_);
+
+        _fd_ = -1;
+    }
+
+    Future<size_t> AsyncFile::Read(std::span<std::byte> buffer, uint64_t offset)
+    {
+        if (!_service_ || _fd_ < 0)
+        {
+            throw FutureError(FutureErrorCode::NoState, "File is not open!");
+        }
+
+        return _service_->Read(_fd_, buffer, offset);
+    }
+
+    Future<size_t> AsyncFile::Write(std::span<std::byte const> buffer, uint64_t offset)
+    {
+        if (!_service_ || _fd_ < 0)
+        {
+            throw FutureError(FutureErrorCode::NoState, "File is not open!");
+        }
+
+        return _service_->Write(_fd_, buffer, offset);
+    }
+
+    Future<void> AsyncFile::Fsync()
+    {
+        if (!_service_ || _fd_ < 0)
+        {
+            throw FutureError(FutureErrorCode::NoState, "File is not open!");
+        }
+
+        return _service_->Fsync(_fd_);
+    }
+}
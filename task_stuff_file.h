@@ -0,0 +1,109 @@
+#pragma once
+
+#include "task_stuff.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+
+namespace TaskStuff
+{
+    class _InternalFileBackend;
+
+    enum class FileIoBackend
+    {
+        Auto,       // io_uring if the kernel allows it, otherwise ThreadPool
+        ThreadPool  // Blocking calls on a private thread pool
+    };
+
+    // Runs the I/O of AsyncFile objects. Requests go to an io_uring whose completion thread fulfils
+    // the promises straight from the completion entries, submissions made while another thread is
+    // submitting are batched into its io_uring_enter call. Where io_uring isn't available (old kernel,
+    // seccomp filter) the same requests run as blocking calls on a thread pool instead.
+    // Continuations of the returned futures run on the completion thread, or on the pool.
+    class FileIoService
+    {
+    private:
+
+        std::unique_ptr<_InternalFileBackend> _backend_;
+
+        FileIoService(FileIoService const&) = delete;
+        FileIoService& operator=(FileIoService const&) = delete;
+
+    public:
+
+        explicit FileIoService(FileIoBackend backend = FileIoBackend::Auto, unsigned queueDepth = 256);
+
+        // Waits for all requests in flight to complete
+        ~FileIoService();
+
+        bool UsesIoUring() const;
+
+        // Failures are reported as error codes (see Promise::SetError) holding the errno value
+        Future<size_t> Read(int fd, std::span<std::byte> buffer, uint64_t offset);
+        Future<size_t> Write(int fd, std::span<std::byte const> buffer, uint64_t offset);
+        Future<void> Fsync(int fd);
+    };
+
+    // File doing positional reads and writes through a FileIoService. Buffers are provided by the
+    // caller and have to stay valid until the returned future completes. Short reads and writes
+    // are not retried, the future holds the number of bytes actually transferred. Both backends
+    // transfer a little less than 2 GiB at most per request, the limit Linux puts on a single
+    // read or write, larger buffers complete with a short count.
+    class AsyncFile
+    {
+    private:
+
+        FileIoService* _service_;
+        int            _fd_;
+
+        AsyncFile(AsyncFile const&) = delete;
+        AsyncFile& operator=(AsyncFile const&) = delete;
+
+    public:
+
+        AsyncFile() noexcept
+            : _service_(nullptr)
+            , _fd_(-1)
+        { }
+
+        // Takes ownership of fd
+        AsyncFile(FileIoService& service, int fd) noexcept
+            : _service_(&service)
+            , _fd_(fd)
+        { }
+
+        AsyncFile(AsyncFile&& other) noexcept
+            : _service_(other._service_)
+            , _fd_(other._fd_)
+        {
+            other._service_ = nullptr;
+            other._fd_ = -1;
+        }
+
+        AsyncFile& operator=(AsyncFile&& other) noexcept;
+
+        ~AsyncFile();
+
+        // Opens path with open(2) flags, throws std::system_error on failure
+        static AsyncFile Open(FileIoService& service, std::string const& path, int flags, int mode = 0644);
+
+        bool IsOpen() const
+        {
+            return _fd_ >= 0;
+        }
+
+        int FileDescriptor() const
+        {
+            return _fd_;
+        }
+
+        void Close();
+
+        Future<size_t> Read(std::span<std::byte> buffer, uint64_t offset);
+        Future<size_t> Write(std::span<std::byte const> buffer, uint64_t offset);
+        Future<void> Fsync();
+    };
+}
@@ -0,0 +1,358 @@
+#include "task_stuff_process.h"
+
+#include <cerrno>
+#include <memory>
+#include <system_error>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+extern char** environ;
+
+namespace TaskStuff
+{
+    namespace
+    {
+        ExitStatus _exitStatus(int status)
+        {
+            ExitStatus exitStatus;
+
+            if (WIFSIGNALED(status))
+                exitStatus.Signal = WTERMSIG(status);
+            else
+                exitStatus.Code = WEXITSTATUS(status);
+
+            return exitStatus;
+        }
+
+        void _fulfil(Promise<ExitStatus>& promise, int error, int status)
+        {
+            if (error)
+                promise.SetError(std::error_code(error, std::system_category()));
+            else
+                promise.SetValue(_exitStatus(status));
+        }
+
+        // Reaps the child once its pidfd becomes readable
+        class _ProcessExitSource final : public _InternalReactorSource
+        {
+        private:
+
+            pid_t               _pid_;
+            int                 _pidfd_;
+            Promise<ExitStatus> _promise_;
+
+        public:
+
+            _ProcessExitSource(Reactor& reactor, pid_t pid, int pidfd)
+                : _InternalReactorSource(reactor)
+                , _pid_(pid)
+                , _pidfd_(pidfd)
+            { }
+
+            ~_ProcessExitSource()
+            {
+                if (_pidfd_ >= 0)
+                    close(_pidfd_);
+            }
+
+            Future<ExitStatus> _getFuture()
+            {
+                return _promise_.GetFuture();
+            }
+
+            void _watch()
+            {
+                _register(_pidfd_, EPOLLIN);
+            }
+
+            // Fallback without a pidfd, parks an executor thread in waitpid
+            void _waitBlocking()
+            {
+                _post([this]()
+                    {
+                        int status = 0;
+                        int error = 0;
+
+                        while (waitpid(_pid_, &status, 0) < 0)
+                        {
+                            if (errno != EINTR)
+                            {
+                                error = errno;
+                                break;
+                            }
+                        }
+
+                        _fulfil(_promise_, error, status);
+                        _retire();
+                    });
+            }
+
+            void _onReady(uint32_t) override
+            {
+                if (_pidfd_ < 0)
+                    return;
+
+                int status = 0;
+                pid_t reaped;
+
+                while ((reaped = waitpid(_pid_, &status, WNOHANG)) < 0 && errno == EINTR)
+                { }
+
+                if (reaped == 0)
+                    return;
+
+                int error = reaped < 0 ? errno : 0;
+
+                _unregister(_pidfd_);
+                close(_pidfd_);
+                _pidfd_ = -1;
+
+                // The source is gone by the time the task runs, so the promise travels with it
+                _post([promise = std::move(_promise_), error, status]() mutable
+                    {
+                        _fulfil(promise, error, status);
+                    });
+
+                _retire();
+            }
+        };
+
+        // Collects everything written to a pipe until the write end is closed
+        class _PipeReaderSource final : public _InternalReactorSource
+        {
+        private:
+
+            int                  _fd_;
+            std::string          _data_;
+            Promise<std::string> _promise_;
+
+            void _finish(int error)
+            {
+                _unregister(_fd_);
+                close(_fd_);
+                _fd_ = -1;
+
+                _post([promise = std::move(_promise_), data = std::move(_data_), error]() mutable
+                    {
+                        if (error)
+                            promise.SetError(std::error_code(error, std::system_category()));
+                        else
+                            promise.SetValue(std::move(data));
+                    });
+
+                _retire();
+            }
+
+        public:
+
+            _PipeReaderSource(Reactor& reactor, int fd)
+                : _InternalReactorSource(reactor)
+                , _fd_(fd)
+            { }
+
+            ~_PipeReaderSource()
+            {
+                if (_fd_ >= 0)
+                    close(_fd_);
+            }
+
+            Future<std::string> _getFuture()
+            {
+                return _promise_.GetFuture();
+            }
+
+            // Edge triggered, _onReady reads until the pipe is empty
+            void _watch()
+            {
+                _register(_fd_, EPOLLIN | EPOLLRDHUP | EPOLLET);
+            }
+
+            void _onReady(uint32_t) override
+            {
+                char chunk[16384];
+
+                while (_fd_ >= 0)
+                {
+                    ssize_t count = read(_fd_, chunk, sizeof(chunk));
+
+                    if (count > 0)
+                        _data_.append(chunk, static_cast<size_t>(count));
+                    else if (count == 0)
+                        _finish(0);
+                    else if (errno == EAGAIN || errno == EWOULDBLOCK)
+                        return;
+                    else if (errno != EINTR)
+                        _finish(errno);
+                }
+            }
+        };
+
+        // Both ends of a pipe, closed unless released
+        struct _Pipe
+        {
+            int _fds_[2] = { -1, -1 };
+
+            _Pipe()
+            {
+                if (pipe2(_fds_, O_CLOEXEC) < 0)
+                    throw std::system_error(errno, std::system_category(), "pipe2");
+
+                if (fcntl(_fds_[0], F_SETFL, O_NONBLOCK) < 0)
+                {
+                    int error = errno;
+                    _close();
+                    throw std::system_error(error, std::system_category(), "fcntl");
+                }
+            }
+
+            ~_Pipe()
+            {
+                _close();
+            }
+
+            void _close()
+            {
+                for (int& fd : _fds_)
+                {
+                    if (fd >= 0)
+                        close(fd);
+
+                    fd = -1;
+                }
+            }
+        };
+
+        class _SpawnFileActions
+        {
+        public:
+
+            posix_spawn_file_actions_t _actions_;
+
+            _SpawnFileActions()
+            {
+                posix_spawn_file_actions_init(&_actions_);
+            }
+
+            ~_SpawnFileActions()
+            {
+                posix_spawn_file_actions_destroy(&_actions_);
+            }
+        };
+
+        // For a child nothing watches, otherwise it would stay a zombie
+        void _killAndReap(pid_t pid)
+        {
+            kill(pid, SIGKILL);
+
+            while (waitpid(pid, nullptr, 0) < 0 && errno == EINTR)
+            { }
+        }
+
+        Future<std::string> _readPipe(Reactor& reactor, _Pipe& pipe)
+        {
+            auto source = std::make_unique<_PipeReaderSource>(reactor, pipe._fds_[0]);
+            pipe._fds_[0] = -1;
+
+            auto fut = source->_getFuture();
+            source->_watch();
+
+            // Owned by the reactor from here on
+            source.release();
+            return fut;
+        }
+    }
+
+    ChildProcess SpawnProcess(Reactor& reactor, std::vector<std::string> const& argv, ProcessOptions const& options)
+    {
+        if (argv.empty())
+            throw std::system_error(EINVAL, std::system_category(), "SpawnProcess");
+
+        std::vector<char*> arguments;
+        for (std::string const& argument : argv)
+            arguments.push_back(const_cast<char*>(argument.c_str()));
+
+        arguments.push_back(nullptr);
+
+        std::unique_ptr<_Pipe> out;
+        std::unique_ptr<_Pipe> err;
+        _SpawnFileActions actions;
+
+        // The child gets the write ends as stdout/stderr, dup2 clears their O_CLOEXEC
+        if (options.CaptureStdout)
+        {
+            out = std::make_unique<_Pipe>();
+            posix_spawn_file_actions_adddup2(&actions._actions_, out->_fds_[1], STDOUT_FILENO);
+        }
+
+        if (options.CaptureStderr)
+        {
+            err = std::make_unique<_Pipe>();
+            posix_spawn_file_actions_adddup2(&actions._actions_, err->_fds_[1], STDERR_FILENO);
+        }
+
+        ChildProcess child;
+
+        int result = options.SearchPath
+            ? posix_spawnp(&child.Pid, arguments[0], &actions._actions_, nullptr, arguments.data(), environ)
+            : posix_spawn(&child.Pid, arguments[0], &actions._actions_, nullptr, arguments.data(), environ);
+
+        if (result != 0)
+            throw std::system_error(result, std::system_category(), argv[0]);
+
+        int pidfd = -1;
+        std::unique_ptr<_ProcessExitSource> source;
+
+        try
+        {
+            // Only the child writes to the pipes, otherwise the readers never see the end of them
+            if (out)
+            {
+                close(out->_fds_[1]);
+                out->_fds_[1] = -1;
+                child.Stdout = _readPipe(reactor, *out);
+            }
+
+            if (err)
+            {
+                close(err->_fds_[1]);
+                err->_fds_[1] = -1;
+                child.Stderr = _readPipe(reactor, *err);
+            }
+
+            // Kernels before 5.3 have no pidfds, -1 makes the source wait in a blocking waitpid instead
+            pidfd = static_cast<int>(syscall(SYS_pidfd_open, child.Pid, 0));
+
+            source = std::make_unique<_ProcessExitSource>(reactor, child.Pid, pidfd);
+            child.Exit = source->_getFuture();
+
+            if (pidfd >= 0)
+                source->_watch();
+            else
+                source->_waitBlocking();
+        }
+        catch (...)
+        {
+            // The source closes the pidfd once it exists, pipe readers already registered see the
+            // end of their pipe when the child dies
+            if (!source && pidfd >= 0)
+                close(pidfd);
+
+            _killAndReap(child.Pid);
+            throw;
+        }
+
+        // Owned by the reactor from here on
+        source.release();
+        return child;
+    }
+}
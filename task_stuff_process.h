@@ -0,0 +1,43 @@
+#pragma once
+
+#include "task_stuff_reactor.h"
+
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace TaskStuff
+{
+    struct ExitStatus
+    {
+        int Code   = 0; // Exit code, when the process wasn't killed by a signal
+        int Signal = 0; // Signal that terminated the process, 0 if it exited
+
+        bool Success() const
+        {
+            return Signal == 0 && Code == 0;
+        }
+    };
+
+    struct ProcessOptions
+    {
+        bool SearchPath    = true;  // Look argv[0] up in PATH
+        bool CaptureStdout = false;
+        bool CaptureStderr = false;
+    };
+
+    struct ChildProcess
+    {
+        pid_t               Pid = -1;
+        Future<ExitStatus>  Exit;
+        Future<std::string> Stdout; // Everything written until the pipe closed, only valid if captured
+        Future<std::string> Stderr; // Only valid if captured
+    };
+
+    // Starts argv with posix_spawn and watches it through a pidfd registered with the reactor, so no
+    // thread blocks in waitpid. Captured output is read from non-blocking pipes by the reactor as well.
+    // All futures are fulfilled on the reactor's executor. Throws std::system_error if the process
+    // can't be started, or can't be watched once started, in which case it is killed and reaped.
+    ChildProcess SpawnProcess(Reactor& reactor, std::vector<std::string> const& argv, ProcessOptions const& options = {});
+}
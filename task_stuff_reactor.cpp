@@ -0,0 +1,129 @@
+#include "task_stuff_reactor.h"
+
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace TaskStuff
+{
+    void _InternalReactorSource::_register(int fd, uint32_t events)
+    {
+        epoll_event event;
+        std::memset(&event, 0, sizeof(event));
+        event.events = events;
+        event.data.ptr = this;
+
+        if (epoll_ctl(_reactor_._epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0)
+            throw std::system_error(errno, std::system_category(), "epoll_ctl");
+    }
+
+    void _InternalReactorSource::_unregister(int fd)
+    {
+        epoll_ctl(_reactor_._epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    }
+
+    void _InternalReactorSource::_post(Task task)
+    {
+        _reactor_._executor_.Execute(std::move(task));
+    }
+
+    void _InternalReactorSource::_retire()
+    {
+        std::unique_lock lck(_reactor_._mtx_retired_);
+        _reactor_._retired_.push_back(this);
+    }
+
+    Reactor::Reactor(Executor& executor)
+        : _executor_(executor)
+        , _epoll_fd_(epoll_create1(EPOLL_CLOEXEC))
+        , _wake_fd_(-1)
+        , _stopping_(false)
+    {
+        if (_epoll_fd_ < 0)
+            throw std::system_error(errno, std::system_category(), "epoll_create1");
+
+        _wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        epoll_event event;
+        std::memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr;
+
+        if (_wake_fd_ < 0 || epoll_ctl(_epoll_fd_, EPOLL_CTL_ADD, _wake_fd_, &event) < 0)
+        {
+            int error = errno;
+
+            if (_wake_fd_ >= 0)
+                close(_wake_fd_);
+
+            close(_epoll_fd_);
+            throw std::system_error(error, std::system_category(), "eventfd");
+        }
+
+        _thread_ = std::thread([this]()
+            {
+                _loop();
+            });
+    }
+
+    Reactor::~Reactor()
+    {
+        _stopping_ = true;
+
+        uint64_t one = 1;
+        while (write(_wake_fd_, &one, sizeof(one)) < 0 && errno == EINTR)
+        { }
+
+        _thread_.join();
+        _freeRetired();
+
+        close(_wake_fd_);
+        close(_epoll_fd_);
+    }
+
+    void Reactor::_freeRetired()
+    {
+        std::vector<_InternalReactorSource*> retired;
+
+        // Scope for lock
+        {
+            std::unique_lock lck(_mtx_retired_);
+            retired.swap(_retired_);
+        }
+
+        for (_InternalReactorSource* source : retired)
+            delete source;
+    }
+
+    void Reactor::_loop()
+    {
+        epoll_event events[64];
+
+        while (!_stopping_)
+        {
+            int count = epoll_wait(_epoll_fd_, events, 64, -1);
+
+            for (int i = 0; i < count; ++i)
+            {
+                if (events[i].data.ptr == nullptr)
+                {
+                    uint64_t value = 0;
+                    while (read(_wake_fd_, &value, sizeof(value)) < 0 && errno == EINTR)
+                    { }
+
+                    continue;
+                }
+
+                static_cast<_InternalReactorSource*>(events[i].data.ptr)->_onReady(events[i].events);
+            }
+
+            // Sources retired so far can't show up in the next epoll_wait, the batch we just handled
+            // was the last one that could still refer to them
+            _freeRetired();
+        }
+    }
+}
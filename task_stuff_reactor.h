@@ -0,0 +1,73 @@
+#pragma once
+
+#include "task_stuff.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace TaskStuff
+{
+    class Reactor;
+
+    // Something waiting on a file descriptor registered with a Reactor. _onReady is called on the
+    // reactor thread with the epoll events of that descriptor.
+    class _InternalReactorSource
+    {
+    protected:
+
+        Reactor& _reactor_;
+
+        explicit _InternalReactorSource(Reactor& reactor)
+            : _reactor_(reactor)
+        { }
+
+        // Throws std::system_error if epoll refuses fd
+        void _register(int fd, uint32_t events);
+        void _unregister(int fd);
+
+        // Runs task on the reactor's executor
+        void _post(Task task);
+
+        // Hands the source over to the reactor, which deletes it once no epoll batch can refer to it anymore
+        void _retire();
+
+    public:
+
+        virtual void _onReady(uint32_t events) = 0;
+
+        virtual ~_InternalReactorSource() {}
+    };
+
+    // Thread waiting in epoll for the sources registered with it (sockets, processes, ...).
+    // Work that can't complete right away is parked on its source and resumed when epoll reports it
+    // ready. Promises are fulfilled on the executor, so continuations never run on the reactor thread.
+    // Everything registered has to be closed or completed before the reactor is destroyed.
+    class Reactor
+    {
+    private:
+
+        Executor&                            _executor_;
+        int                                  _epoll_fd_;
+        int                                  _wake_fd_;
+        std::atomic<bool>                    _stopping_;
+        std::mutex                           _mtx_retired_;
+        std::vector<_InternalReactorSource*> _retired_;
+        std::thread                          _thread_;
+
+        Reactor(Reactor const&) = delete;
+        Reactor& operator=(Reactor const&) = delete;
+
+        void _loop();
+        void _freeRetired();
+
+        friend class _InternalReactorSource;
+
+    public:
+
+        explicit Reactor(Executor& executor);
+        ~Reactor();
+    };
+}
@@ -0,0 +1,525 @@
+#include "task_stuff_socket.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace TaskStuff
+{
+    namespace
+    {
+        std::error_code _errnoCode(int error)
+        {
+            return std::error_code(error, std::system_category());
+        }
+
+        bool _wouldBlock(int error)
+        {
+            return error == EAGAIN || error == EWOULDBLOCK;
+        }
+
+        sockaddr_un _unixAddress(std::string const& path)
+        {
+            sockaddr_un address;
+            std::memset(&address, 0, sizeof(address));
+            address.sun_family = AF_UNIX;
+
+            if (path.size() >= sizeof(address.sun_path))
+                throw std::system_error(ENAMETOOLONG, std::system_category(), path);
+
+            std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+            return address;
+        }
+
+        class _SocketOperation
+        {
+        public:
+
+            int _error_ = 0;
+
+            // Tries to make progress, true once the operation has finished (successfully or not)
+            virtual bool Attempt(int fd) = 0;
+
+            // Fulfils the promise, runs on the executor
+            virtual void Complete() = 0;
+
+            virtual ~_SocketOperation() {}
+        };
+
+        class _ReadOperation final : public _SocketOperation
+        {
+        public:
+
+            std::span<std::byte> _buffer_;
+            size_t               _transferred_ = 0;
+            Promise<size_t>      _promise_;
+
+            explicit _ReadOperation(std::span<std::byte> buffer)
+                : _buffer_(buffer)
+            { }
+
+            bool Attempt(int fd) override
+            {
+                while (true)
+                {
+                    ssize_t count = recv(fd, _buffer_.data(), _buffer_.size(), 0);
+
+                    if (count >= 0)
+                    {
+                        _transferred_ = static_cast<size_t>(count);
+                        return true;
+                    }
+
+                    if (errno == EINTR)
+                        continue;
+
+                    if (_wouldBlock(errno))
+                        return false;
+
+                    _error_ = errno;
+                    return true;
+                }
+            }
+
+            void Complete() override
+            {
+                if (_error_)
+                    _promise_.SetError(_errnoCode(_error_));
+                else
+                    _promise_.SetValue(std::move(_transferred_));
+            }
+        };
+
+        class _WriteOperation final : public _SocketOperation
+        {
+        public:
+
+            std::span<std::byte const> _buffer_;
+            size_t                     _transferred_ = 0;
+            Promise<size_t>            _promise_;
+
+            explicit _WriteOperation(std::span<std::byte const> buffer)
+                : _buffer_(buffer)
+            { }
+
+            bool Attempt(int fd) override
+            {
+                while (_transferred_ < _buffer_.size())
+                {
+                    ssize_t count = send(fd, _buffer_.data() + _transferred_, _buffer_.size() - _transferred_, MSG_NOSIGNAL);
+
+                    if (count >= 0)
+                    {
+                        _transferred_ += static_cast<size_t>(count);
+                        continue;
+                    }
+
+                    if (errno == EINTR)
+                        continue;
+
+                    if (_wouldBlock(errno))
+                        return false;
+
+                    _error_ = errno;
+                    return true;
+                }
+
+                return true;
+            }
+
+            void Complete() override
+            {
+                if (_error_)
+                    _promise_.SetError(_errnoCode(_error_));
+                else
+                    _promise_.SetValue(std::move(_transferred_));
+            }
+        };
+
+        class _AcceptOperation final : public _SocketOperation
+        {
+        public:
+
+            Reactor&             _reactor_;
+            int                  _accepted_fd_ = -1;
+            Promise<AsyncSocket> _promise_;
+
+            explicit _AcceptOperation(Reactor& reactor)
+                : _reactor_(reactor)
+            { }
+
+            ~_AcceptOperation()
+            {
+                if (_accepted_fd_ >= 0)
+                    close(_accepted_fd_);
+            }
+
+            bool Attempt(int fd) override
+            {
+                while (true)
+                {
+                    _accepted_fd_ = accept4(fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+                    if (_accepted_fd_ >= 0)
+                        return true;
+
+                    // The peer gave up before we got to it, wait for the next one
+                    if (errno == EINTR || errno == ECONNABORTED)
+                        continue;
+
+                    if (_wouldBlock(errno))
+                        return false;
+
+                    _error_ = errno;
+                    return true;
+                }
+            }
+
+            void Complete() override
+            {
+                if (_error_)
+                {
+                    _promise_.SetError(_errnoCode(_error_));
+                    return;
+                }
+
+                try
+                {
+                    AsyncSocket accepted(_reactor_, _accepted_fd_);
+                    _accepted_fd_ = -1;
+                    _promise_.SetValue(std::move(accepted));
+                }
+                catch (std::system_error const& e)
+                {
+                    _promise_.SetError(e.code());
+                }
+            }
+        };
+
+        class _ConnectOperation final : public _SocketOperation
+        {
+        public:
+
+            sockaddr_un   _address_;
+            Promise<void> _promise_;
+
+            explicit _ConnectOperation(sockaddr_un const& address)
+                : _address_(address)
+            { }
+
+            bool Attempt(int fd) override
+            {
+                while (true)
+                {
+                    if (connect(fd, reinterpret_cast<sockaddr const*>(&_address_), sizeof(_address_)) == 0 || errno == EISCONN)
+                        return true;
+
+                    if (errno == EINTR)
+                        continue;
+
+                    if (_wouldBlock(errno) || errno == EINPROGRESS || errno == EALREADY)
+                        return false;
+
+                    _error_ = errno;
+                    return true;
+                }
+            }
+
+            void Complete() override
+            {
+                if (_error_)
+                    _promise_.SetError(_errnoCode(_error_));
+                else
+                    _promise_.SetDone();
+            }
+        };
+
+        using _OperationQueue = std::deque<std::unique_ptr<_SocketOperation>>;
+    }
+
+    class _InternalSocketState final : public _InternalReactorSource
+    {
+    private:
+
+        int             _fd_;
+        std::mutex      _mtx_;
+        bool            _closed_ = false;
+        _OperationQueue _readers_;
+        _OperationQueue _writers_;
+
+        // Runs the operations that can make progress now, in order, and moves the finished ones to done
+        void _drain(_OperationQueue& queue, _OperationQueue& done)
+        {
+            while (!queue.empty() && queue.front()->Attempt(_fd_))
+            {
+                done.push_back(std::move(queue.front()));
+                queue.pop_front();
+            }
+        }
+
+        void _complete(_OperationQueue& done)
+        {
+            for (auto& op : done)
+            {
+                _post([op = std::move(op)]()
+                    {
+                        op->Complete();
+                    });
+            }
+        }
+
+    public:
+
+        _InternalSocketState(Reactor& reactor, int fd)
+            : _InternalReactorSource(reactor)
+            , _fd_(fd)
+        { }
+
+        ~_InternalSocketState()
+        {
+            if (_fd_ >= 0)
+                close(_fd_);
+        }
+
+        Reactor& _reactor()
+        {
+            return _reactor_;
+        }
+
+        int _fd() const
+        {
+            return _fd_;
+        }
+
+        // Edge triggered, the parked operations are retried until they would block again
+        void _watch()
+        {
+            _register(_fd_, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET);
+        }
+
+        // Completes op right away when it doesn't have to wait, otherwise parks it in the queue
+        void _start(std::unique_ptr<_SocketOperation> op, bool isWrite)
+        {
+            // Scope for lock
+            {
+                std::unique_lock lck(_mtx_);
+
+                _OperationQueue& queue = isWrite ? _writers_ : _readers_;
+
+                if (_closed_)
+                {
+                    op->_error_ = ECANCELED;
+                }
+                else if (!queue.empty() || !op->Attempt(_fd_))
+                {
+                    queue.push_back(std::move(op));
+                    return;
+                }
+            }
+
+            // Nothing can be attached to the future yet, so completing here runs no continuations
+            op->Complete();
+        }
+
+        void _onReady(uint32_t events) override
+        {
+            _OperationQueue done;
+
+            // Scope for lock
+            {
+                std::unique_lock lck(_mtx_);
+
+                if (_closed_)
+                    return;
+
+                if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+                    _drain(_readers_, done);
+
+                if (events & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+                    _drain(_writers_, done);
+            }
+
+            _complete(done);
+        }
+
+        void _close()
+        {
+            _OperationQueue cancelled;
+
+            // Scope for lock
+            {
+                std::unique_lock lck(_mtx_);
+
+                _closed_ = true;
+
+                _unregister(_fd_);
+                close(_fd_);
+                _fd_ = -1;
+
+                for (_OperationQueue* queue : { &_readers_, &_writers_ })
+                {
+                    for (auto& op : *queue)
+                    {
+                        op->_error_ = ECANCELED;
+                        cancelled.push_back(std::move(op));
+                    }
+
+                    queue->clear();
+                }
+            }
+
+            _complete(cancelled);
+
+            // The reactor may still be handling an event for the socket
+            _retire();
+        }
+    };
+
+    AsyncSocket::AsyncSocket(Reactor& reactor, int fd)
+        : _state_(nullptr)
+    {
+        int flags = fcntl(fd, F_GETFL, 0);
+
+        if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+        {
+            int error = errno;
+            close(fd);
+            throw std::system_error(error, std::system_category(), "fcntl");
+        }
+
+        auto state = std::make_unique<_InternalSocketState>(reactor, fd);
+        state->_watch();
+        _state_ = state.release();
+    }
+
+    AsyncSocket& AsyncSocket::operator=(AsyncSocket&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Close();
+
+            _state_ = other._state_;
+            other._state_ = nullptr;
+        }
+
+        return *this;
+    }
+
+    AsyncSocket::~AsyncSocket()
+    {
+        Close();
+    }
+
+    std::pair<AsyncSocket, AsyncSocket> AsyncSocket::Pair(Reactor& reactor)
+    {
+        int fds[2];
+
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds) < 0)
+            throw std::system_error(errno, std::system_category(), "socketpair");
+
+        AsyncSocket first(reactor, fds[0]);
+        return { std::move(first), AsyncSocket(reactor, fds[1]) };
+    }
+
+    AsyncSocket AsyncSocket::Listen(Reactor& reactor, std::string const& path, int backlog)
+    {
+        sockaddr_un address = _unixAddress(path);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+        if (fd < 0)
+            throw std::system_error(errno, std::system_category(), "socket");
+
+        if (bind(fd, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) < 0 || listen(fd, backlog) < 0)
+        {
+            int error = errno;
+            close(fd);
+            throw std::system_error(error, std::system_category(), path);
+        }
+
+        return AsyncSocket(reactor, fd);
+    }
+
+    Future<AsyncSocket> AsyncSocket::Connect(Reactor& reactor, std::string const& path)
+    {
+        sockaddr_un address = _unixAddress(path);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+        if (fd < 0)
+            throw std::system_error(errno, std::system_category(), "socket");
+
+        AsyncSocket connecting(reactor, fd);
+
+        auto op = std::make_unique<_ConnectOperation>(address);
+        auto connected = op->_promise_.GetFuture();
+        connecting._state_->_start(std::move(op), true);
+
+        return connected.Then([socket = std::move(connecting)]() mutable
+            {
+                return std::move(socket);
+            });
+    }
+
+    int AsyncSocket::FileDescriptor() const
+    {
+        return _state_ ? _state_->_fd() : -1;
+    }
+
+    Future<size_t> AsyncSocket::Read(std::span<std::byte> buffer)
+    {
+        if (!_state_)
+        {
+            throw FutureError(FutureErrorCode::NoState, "Socket is not open!");
+        }
+
+        auto op = std::make_unique<_ReadOperation>(buffer);
+        auto fut = op->_promise_.GetFuture();
+        _state_->_start(std::move(op), false);
+        return fut;
+    }
+
+    Future<size_t> AsyncSocket::Write(std::span<std::byte const> buffer)
+    {
+        if (!_state_)
+        {
+            throw FutureError(FutureErrorCode::NoState, "Socket is not open!");
+        }
+
+        auto op = std::make_unique<_WriteOperation>(buffer);
+        auto fut = op->_promise_.GetFuture();
+        _state_->_start(std::move(op), true);
+        return fut;
+    }
+
+    Future<AsyncSocket> AsyncSocket::Accept()
+    {
+        if (!_state_)
+        {
+            throw FutureError(FutureErrorCode::NoState, "Socket is not open!");
+        }
+
+        auto op = std::make_unique<_AcceptOperation>(_state_->_reactor());
+        auto fut = op->_promise_.GetFuture();
+        _state_->_start(std::move(op), false);
+        return fut;
+    }
+
+    void AsyncSocket::Close()
+    {
+        if (!_state_)
+            return;
+
+        _state_->_close();
+        _state_ = nullptr;
+    }
+}
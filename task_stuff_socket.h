@@ -0,0 +1,71 @@
+#pragma once
+
+#include "task_stuff_reactor.h"
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <utility>
+
+namespace TaskStuff
+{
+    class _InternalSocketState;
+
+    // Non-blocking stream socket driven by a Reactor. Buffers are provided by the caller and have to
+    // stay valid until the returned future completes. Operations of the same kind complete in the
+    // order they were started. Failures are reported as error codes holding the errno value,
+    // operations still pending when the socket is closed fail with ECANCELED.
+    class AsyncSocket
+    {
+    private:
+
+        _InternalSocketState* _state_;
+
+        AsyncSocket(AsyncSocket const&) = delete;
+        AsyncSocket& operator=(AsyncSocket const&) = delete;
+
+    public:
+
+        AsyncSocket() noexcept
+            : _state_(nullptr)
+        { }
+
+        // Takes ownership of fd, makes it non-blocking and registers it with the reactor
+        AsyncSocket(Reactor& reactor, int fd);
+
+        AsyncSocket(AsyncSocket&& other) noexcept
+            : _state_(other._state_)
+        {
+            other._state_ = nullptr;
+        }
+
+        AsyncSocket& operator=(AsyncSocket&& other) noexcept;
+
+        ~AsyncSocket();
+
+        // Connected pair of Unix domain sockets
+        static std::pair<AsyncSocket, AsyncSocket> Pair(Reactor& reactor);
+
+        // Unix domain socket listening on path, throws std::system_error on failure
+        static AsyncSocket Listen(Reactor& reactor, std::string const& path, int backlog = 128);
+
+        static Future<AsyncSocket> Connect(Reactor& reactor, std::string const& path);
+
+        bool IsOpen() const
+        {
+            return _state_ != nullptr;
+        }
+
+        int FileDescriptor() const;
+
+        // Reads whatever is available, up to the size of buffer. 0 means the peer closed the connection.
+        Future<size_t> Read(std::span<std::byte> buffer);
+
+        // Completes once the whole buffer has been written
+        Future<size_t> Write(std::span<std::byte const> buffer);
+
+        Future<AsyncSocket> Accept();
+
+        void Close();
+    };
+}
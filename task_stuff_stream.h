@@ -0,0 +1,986 @@
+#pragma once
+
+#include "task_stuff_channel.h"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace TaskStuff
+{
+    // Stage of a stream pipeline. Elements are pushed into sinks that the operators compose, so
+    // fused stages run inside the continuation of the stage that produced the element.
+    template <typename ValueT>
+    class _InternalStreamSource : public std::enable_shared_from_this<_InternalStreamSource<ValueT>>
+    {
+    public:
+
+        // Returns true if it took the element, false to be fed the next one
+        using _sink = std::function<bool(ValueT&&)>;
+
+        // Feeds elements to sink until it takes one (true) or the stream ends (false)
+        virtual Future<bool> _pull(_sink sink) = 0;
+
+        virtual ~_InternalStreamSource() {}
+    };
+
+    template <typename FromT, typename ToT>
+    void _internal_forward_failure(Result<FromT> const& result, Promise<ToT>& promise)
+    {
+        if (result.HasException())
+            promise.SetException(result.GetException());
+        else
+            promise.SetError(result.GetError());
+    }
+
+    // Start of a pipeline. fetch() returns a future of the next element, decode turns its outcome
+    // into the element or nullopt at the end of the stream. Elements that are ready are fed to
+    // the sink in a loop, only waiting for one costs a continuation.
+    template <typename ValueT, typename FetchT, typename DecodeT>
+    class _InternalRootStream final : public _InternalStreamSource<ValueT>
+    {
+    private:
+
+        using _sink = typename _InternalStreamSource<ValueT>::_sink;
+        using _fetched = typename std::invoke_result_t<FetchT&>::value_type;
+
+        FetchT  _fetch_;
+        DecodeT _decode_;
+
+        // True once promise is completed
+        bool _deliver(Result<_fetched>&& result, _sink& sink, Promise<bool>& promise)
+        {
+            try
+            {
+                std::optional<ValueT> value = _decode_(std::move(result));
+
+                if (!value)
+                {
+                    promise.SetValue(false);
+                    return true;
+                }
+
+                if (sink(std::move(*value)))
+                {
+                    promise.SetValue(true);
+                    return true;
+                }
+
+                return false;
+            }
+            catch (...)
+            {
+                promise.SetException(std::current_exception());
+                return true;
+            }
+        }
+
+        static void _pullInto(std::shared_ptr<_InternalRootStream> self, _sink sink, Promise<bool> promise)
+        {
+            while (true)
+            {
+                Future<_fetched> fetched;
+
+                try
+                {
+                    fetched = self->_fetch_();
+                }
+                catch (...)
+                {
+                    promise.SetException(std::current_exception());
+                    return;
+                }
+
+                if (!fetched.IsReady())
+                {
+                    fetched.OnComplete([self, sink = std::move(sink), promise = std::move(promise)](Result<_fetched> result) mutable
+                        {
+                            if (!self->_deliver(std::move(result), sink, promise))
+                                _pullInto(std::move(self), std::move(sink), std::move(promise));
+                        });
+
+                    return;
+                }
+
+                if (self->_deliver(std::move(*fetched.TryTake()), sink, promise))
+                    return;
+            }
+        }
+
+    public:
+
+        _InternalRootStream(FetchT fetch, DecodeT decode)
+            : _fetch_(std::move(fetch))
+            , _decode_(std::move(decode))
+        { }
+
+        Future<bool> _pull(_sink sink) override
+        {
+            Promise<bool> promise;
+            Future<bool> fut = promise.GetFuture();
+            _pullInto(std::static_pointer_cast<_InternalRootStream>(this->shared_from_this()), std::move(sink), std::move(promise));
+            return fut;
+        }
+    };
+
+    // Stage fused into its upstream: adapter(element, sink) runs in the sink the upstream is fed,
+    // so it costs a function call per element instead of a continuation
+    template <typename InT, typename OutT, typename AdapterT>
+    class _InternalFusedStream final : public _InternalStreamSource<OutT>
+    {
+    private:
+
+        std::shared_ptr<_InternalStreamSource<InT>> _upstream_;
+        AdapterT                                    _adapter_;
+
+    public:
+
+        _InternalFusedStream(std::shared_ptr<_InternalStreamSource<InT>> upstream, AdapterT adapter)
+            : _upstream_(std::move(upstream))
+            , _adapter_(std::move(adapter))
+        { }
+
+        Future<bool> _pull(typename _InternalStreamSource<OutT>::_sink sink) override
+        {
+            auto self = std::static_pointer_cast<_InternalFusedStream>(this->shared_from_this());
+
+            return _upstream_->_pull([self, sink = std::move(sink)](InT&& value) mutable
+                {
+                    return self->_adapter_(std::move(value), sink);
+                });
+        }
+    };
+
+    // Decouples consumers from one or more upstreams: keeps pulling while fewer than capacity
+    // elements are buffered or on their way, and hands them out in arrival order
+    template <typename ValueT>
+    class _InternalQueueStream final : public _InternalStreamSource<ValueT>
+    {
+    private:
+
+        using _sink = typename _InternalStreamSource<ValueT>::_sink;
+        using _source = std::shared_ptr<_InternalStreamSource<ValueT>>;
+
+        struct _side
+        {
+            _source _upstream_;
+            bool    _pulling_ = false;
+            bool    _ended_ = false;
+        };
+
+        struct _consumer
+        {
+            _sink         _sink_;
+            Promise<bool> _promise_;
+        };
+
+        std::mutex               _mtx_;
+        std::vector<_side>       _sides_;
+        size_t                   _capacity_;
+        std::deque<ValueT>       _buffer_;
+        std::optional<_consumer> _waiting_;
+        std::exception_ptr       _exception_;
+        std::error_code          _error_;
+
+        std::shared_ptr<_InternalQueueStream> _self()
+        {
+            return std::static_pointer_cast<_InternalQueueStream>(this->shared_from_this());
+        }
+
+        // Called with the lock held
+        bool _finished() const
+        {
+            for (_side const& side : _sides_)
+            {
+                if (!side._ended_)
+                    return false;
+            }
+
+            return true;
+        }
+
+        // Hands buffered elements to the consumer until it takes one, parks it if there are none
+        void _serve(_consumer consumer)
+        {
+            while (true)
+            {
+                std::optional<ValueT> value;
+                std::exception_ptr exception;
+                std::error_code error;
+                bool ended = false;
+
+                // Scope for lock
+                {
+                    std::unique_lock lck(_mtx_);
+
+                    if (!_buffer_.empty())
+                    {
+                        value.emplace(std::move(_buffer_.front()));
+                        _buffer_.pop_front();
+                    }
+                    else if (_exception_ || _error_)
+                    {
+                        exception = _exception_;
+                        error = _error_;
+                    }
+                    else if (_finished())
+                    {
+                        ended = true;
+                    }
+                    else
+                    {
+                        _waiting_.emplace(std::move(consumer));
+                    }
+                }
+
+                if (exception)
+                {
+                    consumer._promise_.SetException(exception);
+                    return;
+                }
+
+                if (error)
+                {
+                    consumer._promise_.SetError(error);
+                    return;
+                }
+
+                if (ended)
+                {
+                    consumer._promise_.SetValue(false);
+                    return;
+                }
+
+                // Parked, or took an element out of the buffer which makes room for another pull
+                _pump();
+
+                if (!value)
+                    return;
+
+                try
+                {
+                    if (consumer._sink_(std::move(*value)))
+                    {
+                        consumer._promise_.SetValue(true);
+                        return;
+                    }
+                }
+                catch (...)
+                {
+                    consumer._promise_.SetException(std::current_exception());
+                    return;
+                }
+            }
+        }
+
+        void _arrive(ValueT&& value)
+        {
+            std::optional<_consumer> consumer;
+
+            // Scope for lock
+            {
+                std::unique_lock lck(_mtx_);
+
+                _buffer_.push_back(std::move(value));
+
+                if (_waiting_)
+                {
+                    consumer.emplace(std::move(*_waiting_));
+                    _waiting_.reset();
+                }
+            }
+
+            if (consumer)
+                _serve(std::move(*consumer));
+        }
+
+        // Records how a pull of side index ended, returns the waiting consumer if it was waiting for that
+        std::optional<_consumer> _record(size_t index, Result<bool>& result)
+        {
+            std::optional<_consumer> consumer;
+
+            // Scope for lock
+            {
+                std::unique_lock lck(_mtx_);
+
+                _sides_[index]._pulling_ = false;
+
+                if (!result.HasValue())
+                {
+                    // The first failure ends the stream once the buffer is drained
+                    if (!_exception_ && !_error_)
+                    {
+                        _exception_ = result.GetException();
+                        _error_ = result.GetError();
+                    }
+
+                    for (_side& side : _sides_)
+                        side._ended_ = true;
+                }
+                else if (!result.Get())
+                {
+                    _sides_[index]._ended_ = true;
+                }
+
+                // A waiting consumer may have been waiting for the end
+                if (_waiting_ && _buffer_.empty() && (_finished() || _exception_ || _error_))
+                {
+                    consumer.emplace(std::move(*_waiting_));
+                    _waiting_.reset();
+                }
+            }
+
+            return consumer;
+        }
+
+        void _pulled(size_t index, Result<bool>& result)
+        {
+            std::optional<_consumer> consumer = _record(index, result);
+
+            if (consumer)
+                _serve(std::move(*consumer));
+            else
+                _pump();
+        }
+
+        // Pulls that complete right away are handled in the loop rather than through their
+        // continuation, a ready upstream would otherwise recurse once per element
+        void _pump()
+        {
+            auto self = _self();
+
+            while (true)
+            {
+                std::vector<size_t> start;
+
+                // Scope for lock
+                {
+                    std::unique_lock lck(_mtx_);
+
+                    size_t pulling = 0;
+                    for (_side const& side : _sides_)
+                        pulling += side._pulling_ ? 1 : 0;
+
+                    for (size_t i = 0; i < _sides_.size() && _buffer_.size() + pulling < _capacity_; ++i)
+                    {
+                        if (_sides_[i]._pulling_ || _sides_[i]._ended_)
+                            continue;
+
+                        _sides_[i]._pulling_ = true;
+                        ++pulling;
+                        start.push_back(i);
+                    }
+                }
+
+                if (start.empty())
+                    return;
+
+                for (size_t index : start)
+                {
+                    std::optional<Result<bool>> result;
+
+                    try
+                    {
+                        Future<bool> pulled = _sides_[index]._upstream_->_pull([self](ValueT&& value)
+                            {
+                                self->_arrive(std::move(value));
+                                return true;
+                            });
+
+                        if (!pulled.IsReady())
+                        {
+                            pulled.OnComplete([self, index](Result<bool> result)
+                                {
+                                    self->_pulled(index, result);
+                                });
+
+                            continue;
+                        }
+
+                        result = pulled.TryTake();
+                    }
+                    catch (...)
+                    {
+                        result.emplace(std::current_exception());
+                    }
+
+                    // Only returned when the stream is over, serving it doesn't pump again
+                    if (std::optional<_consumer> consumer = _record(index, *result))
+                        _serve(std::move(*consumer));
+                }
+            }
+        }
+
+    public:
+
+        _InternalQueueStream(std::vector<_source> upstreams, size_t capacity)
+            : _capacity_(capacity > 0 ? capacity : 1)
+        {
+            for (_source& upstream : upstreams)
+                _sides_.push_back(_side{ std::move(upstream) });
+        }
+
+        Future<bool> _pull(_sink sink) override
+        {
+            Promise<bool> promise;
+            Future<bool> fut = promise.GetFuture();
+            _serve(_consumer{ std::move(sink), std::move(promise) });
+            return fut;
+        }
+    };
+
+    // Groups elements into batches of up to size, a batch is handed out early once timeout has
+    // passed since its first element arrived or when the stream ends. Timeouts are handled on
+    // executor, the timer thread is shared by the whole process.
+    template <typename ValueT>
+    class _InternalBatchStream final : public _InternalStreamSource<std::vector<ValueT>>
+    {
+    private:
+
+        using _sink = typename _InternalStreamSource<std::vector<ValueT>>::_sink;
+
+        struct _consumer
+        {
+            _sink         _sink_;
+            Promise<bool> _promise_;
+        };
+
+        std::shared_ptr<_InternalStreamSource<ValueT>> _upstream_;
+        size_t                                         _size_;
+        std::chrono::steady_clock::duration            _timeout_;
+        Executor*                                      _executor_;
+
+        std::mutex               _mtx_;
+        std::vector<ValueT>      _batch_;
+        std::optional<_consumer> _waiting_;
+        bool                     _pulling_ = false;
+        bool                     _ended_ = false;
+        bool                     _expired_ = false;
+        uint64_t                 _generation_ = 0; // Batches handed out so far, tells timers if theirs is still open
+        std::exception_ptr       _exception_;
+        std::error_code          _error_;
+
+        std::shared_ptr<_InternalBatchStream> _self()
+        {
+            return std::static_pointer_cast<_InternalBatchStream>(this->shared_from_this());
+        }
+
+        // Moves the waiting consumer on as far as the batch allows, pulls upstream only while one is waiting
+        void _step()
+        {
+            while (true)
+            {
+                enum class _action { Emit, End, Fail, Pull };
+
+                std::optional<_consumer> consumer;
+                std::vector<ValueT> batch;
+                _action action;
+
+                // Scope for lock
+                {
+                    std::unique_lock lck(_mtx_);
+
+                    if (!_waiting_)
+                        return;
+
+                    bool failed = _exception_ || _error_;
+
+                    if (_batch_.size() >= _size_ || (!_batch_.empty() && (_ended_ || _expired_ || failed)))
+                    {
+                        batch.swap(_batch_);
+                        ++_generation_;
+                        _expired_ = false;
+                        action = _action::Emit;
+                    }
+                    else if (failed)
+                    {
+                        action = _action::Fail;
+                    }
+                    else if (_ended_)
+                    {
+                        action = _action::End;
+                    }
+                    else if (!_pulling_)
+                    {
+                        _pulling_ = true;
+                        action = _action::Pull;
+                    }
+                    else
+                    {
+                        return;
+                    }
+
+                    if (action != _action::Pull)
+                    {
+                        consumer.emplace(std::move(*_waiting_));
+                        _waiting_.reset();
+                    }
+                }
+
+                switch (action)
+                {
+                case _action::Pull:
+                    if (!_startPull())
+                        return;
+                    break;
+
+                case _action::End:
+                    consumer->_promise_.SetValue(false);
+                    return;
+
+                case _action::Fail:
+                    if (_exception_)
+                        consumer->_promise_.SetException(_exception_);
+                    else
+                        consumer->_promise_.SetError(_error_);
+                    return;
+
+                case _action::Emit:
+                    try
+                    {
+                        if (consumer->_sink_(std::move(batch)))
+                        {
+                            consumer->_promise_.SetValue(true);
+                            return;
+                        }
+                    }
+                    catch (...)
+                    {
+                        consumer->_promise_.SetException(std::current_exception());
+                        return;
+                    }
+
+                    // Rejected further down, the consumer waits for the next batch
+                    {
+                        std::unique_lock lck(_mtx_);
+                        _waiting_.emplace(std::move(*consumer));
+                    }
+                    break;
+                }
+            }
+        }
+
+        // True if the pull completed right away, _step then goes on in its loop instead of
+        // recursing through the continuation
+        bool _startPull()
+        {
+            auto self = _self();
+            std::optional<Result<bool>> result;
+
+            try
+            {
+                Future<bool> pulled = _upstream_->_pull([self](ValueT&& value)
+                    {
+                        self->_add(std::move(value));
+                        return true;
+                    });
+
+                if (!pulled.IsReady())
+                {
+                    pulled.OnComplete([self](Result<bool> result)
+                        {
+                            self->_pulled(result);
+                        });
+
+                    return false;
+                }
+
+                result = pulled.TryTake();
+            }
+            catch (...)
+            {
+                result.emplace(std::current_exception());
+            }
+
+            _record(*result);
+            return true;
+        }
+
+        void _add(ValueT&& value)
+        {
+            bool first = false;
+            uint64_t generation = 0;
+
+            // Scope for lock
+            {
+                std::unique_lock lck(_mtx_);
+
+                _batch_.push_back(std::move(value));
+                first = _batch_.size() == 1;
+                generation = _generation_;
+            }
+
+            if (first && _timeout_ > std::chrono::steady_clock::duration::zero())
+            {
+                // Weak, and skipped once the batch was handed out, so a timer firing after the stream
+                // is done doesn't touch the executor anymore
+                _internal_delay(_timeout_).OnComplete([weak = std::weak_ptr<_InternalBatchStream>(_self()), generation](Result<void>)
+                    {
+                        std::shared_ptr<_InternalBatchStream> self = weak.lock();
+
+                        if (!self || !self->_isOpen(generation))
+                            return;
+
+                        Executor* executor = self->_executor_;
+
+                        executor->Execute([self = std::move(self), generation]()
+                            {
+                                self->_expire(generation);
+                            });
+                    });
+            }
+        }
+
+        void _record(Result<bool>& result)
+        {
+            // Scope for lock
+            {
+                std::unique_lock lck(_mtx_);
+
+                _pulling_ = false;
+
+                if (!result.HasValue())
+                {
+                    _exception_ = result.GetException();
+                    _error_ = result.GetError();
+                }
+                else if (!result.Get())
+                {
+                    _ended_ = true;
+                }
+            }
+        }
+
+        void _pulled(Result<bool>& result)
+        {
+            _record(result);
+            _step();
+        }
+
+        // True while the batch of generation hasn't been handed out
+        bool _isOpen(uint64_t generation)
+        {
+            std::unique_lock lck(_mtx_);
+            return generation == _generation_ && !_batch_.empty();
+        }
+
+        void _expire(uint64_t generation)
+        {
+            // Scope for lock
+            {
+                std::unique_lock lck(_mtx_);
+
+                // That batch was handed out already
+                if (generation != _generation_ || _batch_.empty())
+                    return;
+
+                _expired_ = true;
+            }
+
+            _step();
+        }
+
+    public:
+
+        // Without an executor there is no timeout
+        _InternalBatchStream(std::shared_ptr<_InternalStreamSource<ValueT>> upstream, size_t size, std::chrono::steady_clock::duration timeout, Executor* executor)
+            : _upstream_(std::move(upstream))
+            , _size_(size > 0 ? size : 1)
+            , _timeout_(executor ? timeout : std::chrono::steady_clock::duration::zero())
+            , _executor_(executor)
+        { }
+
+        Future<bool> _pull(_sink sink) override
+        {
+            Promise<bool> promise;
+            Future<bool> fut = promise.GetFuture();
+
+            // Scope for lock
+            {
+                std::unique_lock lck(_mtx_);
+                _waiting_.emplace(_consumer{ std::move(sink), std::move(promise) });
+            }
+
+            _step();
+            return fut;
+        }
+    };
+
+    // Pull based stream: every Next() completes with the next element, or nullopt once the stream ended.
+    // Map, Filter and Window are fused into the stage that produces the element, so a chain of them
+    // costs one continuation per element rather than one per operator. Buffer, Merge and Batch
+    // decouple the consumer from the producer and add one continuation each.
+    // A stream has a single consumer: call Next again only once the previous future completed.
+    // Streams read from a Channel or any fn() -> Future<std::optional<T>>, and Next() can be
+    // co_awaited from a coroutine returning a Future.
+    template <typename ValueT>
+    class AsyncStream
+    {
+    private:
+
+        using _source = std::shared_ptr<_InternalStreamSource<ValueT>>;
+
+        _source _source_;
+
+        template <typename OtherT>
+        friend class AsyncStream;
+
+        explicit AsyncStream(_source source)
+            : _source_(std::move(source))
+        { }
+
+        void _checkState() const
+        {
+            if (!_source_)
+            {
+                throw FutureError(FutureErrorCode::NoState, "Stream has no state!");
+            }
+        }
+
+        template <typename OutT, typename AdapterT>
+        AsyncStream<OutT> _fuse(AdapterT adapter) const
+        {
+            _checkState();
+            return AsyncStream<OutT>(std::make_shared<_InternalFusedStream<ValueT, OutT, AdapterT>>(_source_, std::move(adapter)));
+        }
+
+        template <typename FetchT, typename DecodeT>
+        static AsyncStream _root(FetchT fetch, DecodeT decode)
+        {
+            return AsyncStream(std::make_shared<_InternalRootStream<ValueT, FetchT, DecodeT>>(std::move(fetch), std::move(decode)));
+        }
+
+        // True once the send of value has been started, sent holds its future
+        static bool _sendOne(Result<std::optional<ValueT>>& next, Channel<ValueT>& channel, Promise<void>& done, Future<void>& sent)
+        {
+            if (!next.HasValue())
+            {
+                _internal_forward_failure(next, done);
+                return false;
+            }
+
+            std::optional<ValueT> value = next.Get();
+
+            if (!value)
+            {
+                channel.Close();
+                done.SetDone();
+                return false;
+            }
+
+            sent = channel.Send(std::move(*value));
+            return true;
+        }
+
+        static void _afterSend(_source source, Channel<ValueT> channel, Future<void> sent, Promise<void> done)
+        {
+            sent.OnComplete([source = std::move(source), channel = std::move(channel), done = std::move(done)](Result<void> result) mutable
+                {
+                    if (result.HasValue())
+                        _sendAll(std::move(source), std::move(channel), std::move(done));
+                    else
+                        _internal_forward_failure(result, done);
+                });
+        }
+
+        // Loops while elements and channel space are available, so a ready stream doesn't recurse
+        static void _sendAll(_source source, Channel<ValueT> channel, Promise<void> done)
+        {
+            while (true)
+            {
+                Future<std::optional<ValueT>> next = AsyncStream(source).Next();
+                Future<void> sent;
+
+                if (!next.IsReady())
+                {
+                    next.OnComplete([source, channel, done = std::move(done)](Result<std::optional<ValueT>> result) mutable
+                        {
+                            Future<void> sent;
+
+                            if (_sendOne(result, channel, done, sent))
+                                _afterSend(std::move(source), std::move(channel), std::move(sent), std::move(done));
+                        });
+
+                    return;
+                }
+
+                Result<std::optional<ValueT>> result = std::move(*next.TryTake());
+
+                if (!_sendOne(result, channel, done, sent))
+                    return;
+
+                if (!sent.IsReady())
+                {
+                    _afterSend(std::move(source), std::move(channel), std::move(sent), std::move(done));
+                    return;
+                }
+
+                Result<void> sendResult = std::move(*sent.TryTake());
+
+                if (!sendResult.HasValue())
+                {
+                    _internal_forward_failure(sendResult, done);
+                    return;
+                }
+            }
+        }
+
+    public:
+
+        using value_type = ValueT;
+
+        AsyncStream() noexcept
+        { }
+
+        // Receives from channel until it is closed and drained
+        explicit AsyncStream(Channel<ValueT> channel)
+            : AsyncStream(_root([channel]() mutable
+                {
+                    return channel.Receive();
+                },
+                [](Result<ValueT>&& result) -> std::optional<ValueT>
+                {
+                    if (result.HasException())
+                    {
+                        try
+                        {
+                            std::rethrow_exception(result.GetException());
+                        }
+                        catch (FutureError const& e)
+                        {
+                            if (e.ErrorCode() == FutureErrorCode::ChannelClosed)
+                                return std::nullopt;
+
+                            throw;
+                        }
+                    }
+
+                    return result.Get();
+                }))
+        { }
+
+        // fn() -> Future<std::optional<ValueT>> is called for every element, nullopt ends the stream
+        template <typename FnT>
+        static AsyncStream Generate(FnT fn)
+        {
+            return _root(std::move(fn), [](Result<std::optional<ValueT>>&& result)
+                {
+                    return result.Get();
+                });
+        }
+
+        bool Valid() const
+        {
+            return _source_ != nullptr;
+        }
+
+        Future<std::optional<ValueT>> Next()
+        {
+            _checkState();
+
+            auto slot = std::make_shared<std::optional<ValueT>>();
+
+            return _source_->_pull([slot](ValueT&& value)
+                {
+                    slot->emplace(std::move(value));
+                    return true;
+                })
+                .Then([slot](bool more)
+                {
+                    return more ? std::move(*slot) : std::optional<ValueT>();
+                });
+        }
+
+        template <typename FnT>
+        AsyncStream<std::invoke_result_t<FnT, ValueT&&>> Map(FnT fn) const
+        {
+            using resultType = std::invoke_result_t<FnT, ValueT&&>;
+
+            return _fuse<resultType>([fn = std::move(fn)](ValueT&& value, typename _InternalStreamSource<resultType>::_sink& sink) mutable
+                {
+                    return sink(fn(std::move(value)));
+                });
+        }
+
+        // Keeps the elements pred(element) returns true for
+        template <typename PredT>
+        AsyncStream Filter(PredT pred) const
+        {
+            return _fuse<ValueT>([pred = std::move(pred)](ValueT&& value, typename _InternalStreamSource<ValueT>::_sink& sink) mutable
+                {
+                    return pred(static_cast<ValueT const&>(value)) && sink(std::move(value));
+                });
+        }
+
+        // Sliding window: once size elements arrived, every element yields the last size of them
+        AsyncStream<std::vector<ValueT>> Window(size_t size) const
+        {
+            if (size == 0)
+                size = 1;
+
+            return _fuse<std::vector<ValueT>>([size, window = std::deque<ValueT>()](ValueT&& value, typename _InternalStreamSource<std::vector<ValueT>>::_sink& sink) mutable
+                {
+                    window.push_back(std::move(value));
+
+                    if (window.size() > size)
+                        window.pop_front();
+
+                    if (window.size() < size)
+                        return false;
+
+                    return sink(std::vector<ValueT>(window.begin(), window.end()));
+                });
+        }
+
+        // Batches of up to size elements, handed out once full and at the end of the stream
+        AsyncStream<std::vector<ValueT>> Batch(size_t size) const
+        {
+            _checkState();
+            return AsyncStream<std::vector<ValueT>>(std::make_shared<_InternalBatchStream<ValueT>>(_source_, size, std::chrono::steady_clock::duration::zero(), nullptr));
+        }
+
+        // Same as above, but a batch is also handed out once timeout passed since its first element
+        // (zero waits for a full batch). Batches handed out that way are passed on from executor,
+        // which has to outlive the stream.
+        AsyncStream<std::vector<ValueT>> Batch(size_t size, std::chrono::steady_clock::duration timeout, Executor& executor) const
+        {
+            _checkState();
+            return AsyncStream<std::vector<ValueT>>(std::make_shared<_InternalBatchStream<ValueT>>(_source_, size, timeout, &executor));
+        }
+
+        // Keeps pulling ahead until count elements are buffered
+        AsyncStream Buffer(size_t count) const
+        {
+            _checkState();
+            return AsyncStream(std::make_shared<_InternalQueueStream<ValueT>>(std::vector<_source>{ _source_ }, count));
+        }
+
+        // Elements of both streams in the order they arrive, ends once both ended
+        AsyncStream Merge(AsyncStream const& other) const
+        {
+            _checkState();
+            other._checkState();
+            return AsyncStream(std::make_shared<_InternalQueueStream<ValueT>>(std::vector<_source>{ _source_, other._source_ }, 2));
+        }
+
+        // Sends every element to channel, waiting for room as needed, and closes the channel at the
+        // end of the stream. The future fails if the stream or a send does.
+        Future<void> SendTo(Channel<ValueT> channel) const
+        {
+            _checkState();
+
+            Promise<void> done;
+            Future<void> fut = done.GetFuture();
+            _sendAll(_source_, std::move(channel), std::move(done));
+            return fut;
+        }
+    };
+}
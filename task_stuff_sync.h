@@ -0,0 +1,933 @@
+#pragma once
+
+#include "task_stuff.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace TaskStuff
+{
+    // Base of the waiter nodes
+    struct _InternalSyncWaiter
+    {
+        _InternalSyncWaiter* _next_ = nullptr;
+
+        // Completes the waiter's promise and deletes the node
+        virtual void _wake() = 0;
+
+        virtual ~_InternalSyncWaiter() {}
+    };
+
+    // Intrusive FIFO of waiter nodes. Not synchronized.
+    class _InternalWaiterList
+    {
+    private:
+
+        _InternalSyncWaiter* _head_ = nullptr;
+        _InternalSyncWaiter* _tail_ = nullptr;
+
+    public:
+
+        bool _empty() const
+        {
+            return _head_ == nullptr;
+        }
+
+        void _push(_InternalSyncWaiter* node)
+        {
+            node->_next_ = nullptr;
+
+            if (_tail_)
+                _tail_->_next_ = node;
+            else
+                _head_ = node;
+
+            _tail_ = node;
+        }
+
+        _InternalSyncWaiter* _head() const
+        {
+            return _head_;
+        }
+
+        _InternalSyncWaiter* _pop()
+        {
+            _InternalSyncWaiter* node = _head_;
+
+            if (node)
+            {
+                _head_ = node->_next_;
+
+                if (!_head_)
+                    _tail_ = nullptr;
+
+                node->_next_ = nullptr;
+            }
+
+            return node;
+        }
+
+        // Detaches all nodes, walk them through _next_
+        _InternalSyncWaiter* _takeAll()
+        {
+            _InternalSyncWaiter* head = _head_;
+            _head_ = nullptr;
+            _tail_ = nullptr;
+            return head;
+        }
+    };
+
+    // Wakes waiter, called without any lock held. A continuation woken this way often releases
+    // again and wakes the next waiter, so wakeups started while one runs on the same thread are
+    // queued and run once it returned instead of nesting deeper on the stack.
+    inline void _internal_wake(_InternalSyncWaiter* waiter)
+    {
+        thread_local _InternalWaiterList pending;
+        thread_local bool waking = false;
+
+        pending._push(waiter);
+
+        if (waking)
+            return;
+
+        waking = true;
+
+        while (_InternalSyncWaiter* next = pending._pop())
+            next->_wake();
+
+        waking = false;
+    }
+
+    // Counting semaphore whose Acquire completes a future instead of blocking. Waiters get their
+    // permits in the order they started waiting, a newcomer never takes a permit a waiter is owed.
+    // Acquiring an available permit is a single atomic operation, the lock is only taken to park
+    // or to wake a waiter. Continuations of a parked Acquire run on the thread releasing the permit,
+    // after the continuation that released it if that runs on a wakeup itself.
+    // The semaphore has to outlive its permits, futures of waiters still parked when it is destroyed
+    // fail with FutureErrorCode::BrokenPromise.
+    class AsyncSemaphore
+    {
+    public:
+
+        // Holds one permit of the semaphore and gives it back when destroyed
+        class Permit
+        {
+        private:
+
+            AsyncSemaphore* _semaphore_;
+
+            friend class AsyncSemaphore;
+
+            explicit Permit(AsyncSemaphore* semaphore) noexcept
+                : _semaphore_(semaphore)
+            { }
+
+            Permit(Permit const&) = delete;
+            Permit& operator=(Permit const&) = delete;
+
+        public:
+
+            Permit() noexcept
+                : _semaphore_(nullptr)
+            { }
+
+            Permit(Permit&& other) noexcept
+                : _semaphore_(other._semaphore_)
+            {
+                other._semaphore_ = nullptr;
+            }
+
+            Permit& operator=(Permit&& other) noexcept
+            {
+                if (this != &other)
+                {
+                    Release();
+                    _semaphore_ = other._semaphore_;
+                    other._semaphore_ = nullptr;
+                }
+
+                return *this;
+            }
+
+            ~Permit()
+            {
+                Release();
+            }
+
+            bool Valid() const
+            {
+                return _semaphore_ != nullptr;
+            }
+
+            // Gives the permit back early
+            void Release()
+            {
+                if (_semaphore_)
+                {
+                    AsyncSemaphore* semaphore = _semaphore_;
+                    _semaphore_ = nullptr;
+                    semaphore->Release();
+                }
+            }
+        };
+
+    private:
+
+        struct _waiter : _InternalSyncWaiter
+        {
+            AsyncSemaphore* _semaphore_;
+            Promise<Permit> _promise_;
+
+            explicit _waiter(AsyncSemaphore* semaphore)
+                : _semaphore_(semaphore)
+            { }
+
+            void _wake() override
+            {
+                _promise_.SetValue(Permit(_semaphore_));
+                delete this;
+            }
+        };
+
+        // Available permits minus the acquirers that found none, negative while anyone waits
+        std::atomic<int64_t> _count_;
+
+        std::mutex                   _mtx_;
+        _InternalWaiterList          _waiters_;
+        size_t                       _handoffs_ = 0; // Permits released to acquirers that hadn't parked yet
+
+        AsyncSemaphore(AsyncSemaphore const&) = delete;
+        AsyncSemaphore& operator=(AsyncSemaphore const&) = delete;
+
+    public:
+
+        explicit AsyncSemaphore(size_t permits)
+            : _count_(static_cast<int64_t>(permits))
+        { }
+
+        ~AsyncSemaphore()
+        {
+            _InternalSyncWaiter* waiter = _waiters_._takeAll();
+
+            while (waiter)
+            {
+                _InternalSyncWaiter* next = waiter->_next_;
+                delete waiter;
+                waiter = next;
+            }
+        }
+
+        Future<Permit> Acquire()
+        {
+            if (_count_.fetch_sub(1, std::memory_order_acq_rel) > 0)
+                return Future<Permit>(Permit(this));
+
+            // Every permit is taken or owed to an earlier waiter. The release that pays for this
+            // one may have happened already, in that case it left a handoff behind.
+            Future<Permit> fut;
+
+            // Scope for lock
+            {
+                std::unique_lock lck(_mtx_);
+
+                if (_handoffs_ == 0)
+                {
+                    _waiter* waiter = new _waiter(this);
+                    fut = waiter->_promise_.GetFuture();
+                    _waiters_._push(waiter);
+                    return fut;
+                }
+
+                --_handoffs_;
+            }
+
+            return Future<Permit>(Permit(this));
+        }
+
+        // Takes a permit only if one is available right away and nobody is waiting
+        std::optional<Permit> TryAcquire()
+        {
+            int64_t count = _count_.load(std::memory_order_relaxed);
+
+            while (count > 0)
+            {
+                if (_count_.compare_exchange_weak(count, count - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+                    return Permit(this);
+            }
+
+            return std::nullopt;
+        }
+
+        // Adds count permits, waking as many waiters. Permits call this when they are destroyed.
+        void Release(size_t count = 1)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (_count_.fetch_add(1, std::memory_order_acq_rel) >= 0)
+                    continue;
+
+                _InternalSyncWaiter* waiter;
+
+                // Scope for lock
+                {
+                    std::unique_lock lck(_mtx_);
+
+                    waiter = _waiters_._pop();
+
+                    if (!waiter)
+                    {
+                        ++_handoffs_;
+                        continue;
+                    }
+                }
+
+                _internal_wake(waiter);
+            }
+        }
+
+        // Permits available right now, a snapshot
+        size_t Available() const
+        {
+            int64_t count = _count_.load(std::memory_order_relaxed);
+            return count > 0 ? static_cast<size_t>(count) : 0;
+        }
+    };
+
+    template <bool SharedV>
+    class _InternalLockGuard;
+
+    // Lock word of AsyncMutex and AsyncSharedMutex: the number of readers holding it, a writer bit
+    // and a bit telling that waiters are queued. Taking or releasing an uncontended lock is a
+    // single compare and swap. The waiter bit keeps newcomers off the fast path while anyone is
+    // queued, so the lock is handed out in FIFO order. Only the waiter list and handoffs take the
+    // mutex, and while that bit is set nobody but its holder changes the word.
+    class _InternalLockState
+    {
+    public:
+
+        struct _waiter : _InternalSyncWaiter
+        {
+            bool _shared_ = false;
+        };
+
+    private:
+
+        static constexpr uint64_t _writer = uint64_t(1) << 62;
+        static constexpr uint64_t _waiting = uint64_t(1) << 63;
+
+        std::atomic<uint64_t> _state_;
+        std::mutex            _mtx_;
+        _InternalWaiterList   _waiters_;
+
+        static bool _free(uint64_t state, bool shared)
+        {
+            return shared ? (state & (_writer | _waiting)) == 0 : state == 0;
+        }
+
+        static uint64_t _taken(uint64_t state, bool shared)
+        {
+            return shared ? state + 1 : state | _writer;
+        }
+
+        // Called with the lock held once nobody holds the lock word and waiters are queued. Admits
+        // the writer at the head, or all readers up to the next writer, and returns them as a chain.
+        _InternalSyncWaiter* _handOff()
+        {
+            _InternalWaiterList admitted;
+            uint64_t state = 0;
+
+            if (!static_cast<_waiter*>(_waiters_._head())->_shared_)
+            {
+                admitted._push(_waiters_._pop());
+                state = _writer;
+            }
+            else
+            {
+                while (!_waiters_._empty() && static_cast<_waiter*>(_waiters_._head())->_shared_)
+                {
+                    admitted._push(_waiters_._pop());
+                    ++state;
+                }
+            }
+
+            if (!_waiters_._empty())
+                state |= _waiting;
+
+            _state_.store(state, std::memory_order_release);
+            return admitted._takeAll();
+        }
+
+        static void _wakeAll(_InternalSyncWaiter* waiter)
+        {
+            while (waiter)
+            {
+                _InternalSyncWaiter* next = waiter->_next_;
+                _internal_wake(waiter);
+                waiter = next;
+            }
+        }
+
+        void _unlockSlow()
+        {
+            _InternalSyncWaiter* admitted;
+
+            // Scope for lock
+            {
+                std::unique_lock lck(_mtx_);
+                admitted = _handOff();
+            }
+
+            _wakeAll(admitted);
+        }
+
+    public:
+
+        _InternalLockState()
+            : _state_(0)
+        { }
+
+        ~_InternalLockState()
+        {
+            _InternalSyncWaiter* waiter = _waiters_._takeAll();
+
+            while (waiter)
+            {
+                _InternalSyncWaiter* next = waiter->_next_;
+                delete waiter;
+                waiter = next;
+            }
+        }
+
+        bool _tryLock(bool shared)
+        {
+            uint64_t state = _state_.load(std::memory_order_relaxed);
+
+            while (_free(state, shared))
+            {
+                if (_state_.compare_exchange_weak(state, _taken(state, shared), std::memory_order_acquire, std::memory_order_relaxed))
+                    return true;
+            }
+
+            return false;
+        }
+
+        // True if the lock was taken after all, the caller still owns waiter then. Otherwise waiter
+        // is queued and woken once it holds the lock.
+        bool _lockOrPark(_waiter* waiter)
+        {
+            std::unique_lock lck(_mtx_);
+
+            uint64_t state = _state_.load(std::memory_order_relaxed);
+
+            while (true)
+            {
+                if (_free(state, waiter->_shared_))
+                {
+                    if (_state_.compare_exchange_weak(state, _taken(state, waiter->_shared_), std::memory_order_acquire, std::memory_order_relaxed))
+                        return true;
+                }
+                else if ((state & _waiting) || _state_.compare_exchange_weak(state, state | _waiting, std::memory_order_relaxed))
+                {
+                    // From here on the holder's unlock takes the slow path, which waits for the lock
+                    _waiters_._push(waiter);
+                    return false;
+                }
+            }
+        }
+
+        // Completes with a guard once the lock is held, shared or exclusive
+        template <bool SharedV>
+        Future<_InternalLockGuard<SharedV>> _lock();
+
+        void _unlock()
+        {
+            uint64_t state = _writer;
+
+            if (!_state_.compare_exchange_strong(state, 0, std::memory_order_release, std::memory_order_relaxed))
+                _unlockSlow();
+        }
+
+        void _unlockShared()
+        {
+            // The last reader out hands the lock to the waiters
+            if (_state_.fetch_sub(1, std::memory_order_release) - 1 == _waiting)
+                _unlockSlow();
+        }
+    };
+
+    // Holds a lock of an AsyncMutex or AsyncSharedMutex, shared or exclusive, and releases it when destroyed
+    template <bool SharedV>
+    class _InternalLockGuard
+    {
+    private:
+
+        _InternalLockState* _state_;
+
+        friend class _InternalLockState;
+        friend class AsyncMutex;
+        friend class AsyncSharedMutex;
+
+        template <bool>
+        friend struct _InternalLockWaiter;
+
+        explicit _InternalLockGuard(_InternalLockState* state) noexcept
+            : _state_(state)
+        { }
+
+        _InternalLockGuard(_InternalLockGuard const&) = delete;
+        _InternalLockGuard& operator=(_InternalLockGuard const&) = delete;
+
+    public:
+
+        _InternalLockGuard() noexcept
+            : _state_(nullptr)
+        { }
+
+        _InternalLockGuard(_InternalLockGuard&& other) noexcept
+            : _state_(other._state_)
+        {
+            other._state_ = nullptr;
+        }
+
+        _InternalLockGuard& operator=(_InternalLockGuard&& other) noexcept
+        {
+            if (this != &other)
+            {
+                Unlock();
+                _state_ = other._state_;
+                other._state_ = nullptr;
+            }
+
+            return *this;
+        }
+
+        ~_InternalLockGuard()
+        {
+            Unlock();
+        }
+
+        bool OwnsLock() const
+        {
+            return _state_ != nullptr;
+        }
+
+        // Releases the lock early
+        void Unlock()
+        {
+            if (_state_)
+            {
+                _InternalLockState* state = _state_;
+                _state_ = nullptr;
+
+                if constexpr (SharedV)
+                    state->_unlockShared();
+                else
+                    state->_unlock();
+            }
+        }
+    };
+
+    template <bool SharedV>
+    struct _InternalLockWaiter final : _InternalLockState::_waiter
+    {
+        _InternalLockState*                  _state_;
+        Promise<_InternalLockGuard<SharedV>> _promise_;
+
+        explicit _InternalLockWaiter(_InternalLockState* state)
+            : _state_(state)
+        {
+            _shared_ = SharedV;
+        }
+
+        void _wake() override
+        {
+            _promise_.SetValue(_InternalLockGuard<SharedV>(_state_));
+            delete this;
+        }
+    };
+
+    template <bool SharedV>
+    Future<_InternalLockGuard<SharedV>> _InternalLockState::_lock()
+    {
+        using guardType = _InternalLockGuard<SharedV>;
+
+        if (_tryLock(SharedV))
+            return Future<guardType>(guardType(this));
+
+        auto* waiter = new _InternalLockWaiter<SharedV>(this);
+        Future<guardType> fut = waiter->_promise_.GetFuture();
+
+        if (_lockOrPark(waiter))
+        {
+            delete waiter;
+            return Future<guardType>(guardType(this));
+        }
+
+        return fut;
+    }
+
+    // Mutex whose Lock completes a future with a Guard instead of blocking the thread. Waiters get
+    // the lock in the order they asked for it, the next one is resumed through its continuation on
+    // the thread that unlocked. An uncontended Lock takes neither the internal lock nor allocates a
+    // waiter, TryLock doesn't allocate at all. The mutex has to outlive its guards.
+    class AsyncMutex
+    {
+    private:
+
+        _InternalLockState _state_;
+
+        AsyncMutex(AsyncMutex const&) = delete;
+        AsyncMutex& operator=(AsyncMutex const&) = delete;
+
+    public:
+
+        using Guard = _InternalLockGuard<false>;
+
+        AsyncMutex()
+        { }
+
+        Future<Guard> Lock()
+        {
+            return _state_._lock<false>();
+        }
+
+        std::optional<Guard> TryLock()
+        {
+            if (_state_._tryLock(false))
+                return Guard(&_state_);
+
+            return std::nullopt;
+        }
+    };
+
+    // Reader-writer variant of AsyncMutex. Readers share the lock, writers hold it alone. Waiters
+    // are served in FIFO order, readers queued next to each other are admitted together, and a
+    // queued writer keeps later readers from overtaking it.
+    class AsyncSharedMutex
+    {
+    private:
+
+        _InternalLockState _state_;
+
+        AsyncSharedMutex(AsyncSharedMutex const&) = delete;
+        AsyncSharedMutex& operator=(AsyncSharedMutex const&) = delete;
+
+    public:
+
+        using Guard = _InternalLockGuard<false>;
+        using SharedGuard = _InternalLockGuard<true>;
+
+        AsyncSharedMutex()
+        { }
+
+        Future<Guard> Lock()
+        {
+            return _state_._lock<false>();
+        }
+
+        Future<SharedGuard> LockShared()
+        {
+            return _state_._lock<true>();
+        }
+
+        std::optional<Guard> TryLock()
+        {
+            if (_state_._tryLock(false))
+                return Guard(&_state_);
+
+            return std::nullopt;
+        }
+
+        std::optional<SharedGuard> TryLockShared()
+        {
+            if (_state_._tryLock(true))
+                return SharedGuard(&_state_);
+
+            return std::nullopt;
+        }
+    };
+
+    // Lock-free intrusive list of Future<void> waiters that all get released at once. The head is
+    // either null, the newest waiter, or _signalled() once the list was released and stays open.
+    class _InternalWaitList
+    {
+    private:
+
+        struct _waiter final : _InternalSyncWaiter
+        {
+            Promise<void>      _promise_;
+            std::exception_ptr _exception_;
+
+            void _wake() override
+            {
+                if (_exception_)
+                    _promise_.SetException(_exception_);
+                else
+                    _promise_.SetDone();
+
+                delete this;
+            }
+        };
+
+        std::atomic<_InternalSyncWaiter*> _head_;
+
+        _InternalSyncWaiter* _signalled() const
+        {
+            return reinterpret_cast<_InternalSyncWaiter*>(const_cast<_InternalWaitList*>(this));
+        }
+
+        static Future<void> _ready()
+        {
+            Promise<void> promise;
+            Future<void> fut = promise.GetFuture();
+            promise.SetDone();
+            return fut;
+        }
+
+        // Pushing made the chain newest first, wake in the order the waiters arrived
+        static void _wakeChain(_InternalSyncWaiter* waiter)
+        {
+            _InternalSyncWaiter* ordered = nullptr;
+
+            while (waiter)
+            {
+                _InternalSyncWaiter* next = waiter->_next_;
+                waiter->_next_ = ordered;
+                ordered = waiter;
+                waiter = next;
+            }
+
+            while (ordered)
+            {
+                _InternalSyncWaiter* next = ordered->_next_;
+                _internal_wake(ordered);
+                ordered = next;
+            }
+        }
+
+    public:
+
+        explicit _InternalWaitList(bool signalled = false)
+            : _head_(nullptr)
+        {
+            if (signalled)
+                _head_.store(_signalled(), std::memory_order_relaxed);
+        }
+
+        ~_InternalWaitList()
+        {
+            _InternalSyncWaiter* waiter = _head_.load(std::memory_order_acquire);
+
+            if (waiter == _signalled())
+                return;
+
+            while (waiter)
+            {
+                _InternalSyncWaiter* next = waiter->_next_;
+                delete waiter;
+                waiter = next;
+            }
+        }
+
+        bool _isSignalled() const
+        {
+            return _head_.load(std::memory_order_acquire) == _signalled();
+        }
+
+        Future<void> _wait()
+        {
+            _InternalSyncWaiter* head = _head_.load(std::memory_order_acquire);
+
+            if (head == _signalled())
+                return _ready();
+
+            _waiter* waiter = new _waiter;
+            Future<void> fut = waiter->_promise_.GetFuture();
+
+            do
+            {
+                if (head == _signalled())
+                {
+                    delete waiter;
+                    return _ready();
+                }
+
+                waiter->_next_ = head;
+            }
+            while (!_head_.compare_exchange_weak(head, waiter, std::memory_order_release, std::memory_order_acquire));
+
+            return fut;
+        }
+
+        // Releases the waiters, later ones complete right away until _reset
+        void _signal()
+        {
+            _InternalSyncWaiter* head = _head_.exchange(_signalled(), std::memory_order_acq_rel);
+
+            if (head != _signalled())
+                _wakeChain(head);
+        }
+
+        // Releases the waiters queued so far, the list stays closed. With an exception their futures fail with it.
+        void _release(std::exception_ptr exception = nullptr)
+        {
+            _InternalSyncWaiter* head = _head_.exchange(nullptr, std::memory_order_acq_rel);
+
+            if (exception)
+            {
+                for (_InternalSyncWaiter* waiter = head; waiter; waiter = waiter->_next_)
+                    static_cast<_waiter*>(waiter)->_exception_ = exception;
+            }
+
+            _wakeChain(head);
+        }
+
+        void _reset()
+        {
+            _InternalSyncWaiter* head = _signalled();
+            _head_.compare_exchange_strong(head, nullptr, std::memory_order_relaxed);
+        }
+    };
+
+    // Event whose Wait completes once it is set. It stays set, completing waits right away, until Reset.
+    // Waiters are completed on the thread calling Set, in the order they started waiting.
+    class AsyncManualResetEvent
+    {
+    private:
+
+        _InternalWaitList _waiters_;
+
+        AsyncManualResetEvent(AsyncManualResetEvent const&) = delete;
+        AsyncManualResetEvent& operator=(AsyncManualResetEvent const&) = delete;
+
+    public:
+
+        explicit AsyncManualResetEvent(bool set = false)
+            : _waiters_(set)
+        { }
+
+        bool IsSet() const
+        {
+            return _waiters_._isSignalled();
+        }
+
+        Future<void> Wait()
+        {
+            return _waiters_._wait();
+        }
+
+        void Set()
+        {
+            _waiters_._signal();
+        }
+
+        void Reset()
+        {
+            _waiters_._reset();
+        }
+    };
+
+    // Single use countdown: waits complete once CountDown was called count times in total.
+    // The thread bringing the count to zero completes the waiters.
+    class AsyncLatch
+    {
+    private:
+
+        std::atomic<int64_t> _count_;
+        _InternalWaitList    _waiters_;
+
+        AsyncLatch(AsyncLatch const&) = delete;
+        AsyncLatch& operator=(AsyncLatch const&) = delete;
+
+    public:
+
+        explicit AsyncLatch(size_t count)
+            : _count_(static_cast<int64_t>(count))
+            , _waiters_(count == 0)
+        { }
+
+        void CountDown(size_t count = 1)
+        {
+            int64_t previous = _count_.fetch_sub(static_cast<int64_t>(count), std::memory_order_acq_rel);
+
+            if (previous > 0 && previous <= static_cast<int64_t>(count))
+                _waiters_._signal();
+        }
+
+        bool TryWait() const
+        {
+            return _waiters_._isSignalled();
+        }
+
+        Future<void> Wait()
+        {
+            return _waiters_._wait();
+        }
+
+        Future<void> ArriveAndWait(size_t count = 1)
+        {
+            CountDown(count);
+            return Wait();
+        }
+    };
+
+    // Reusable barrier for a fixed number of participants. ArriveAndWait completes once all of them
+    // arrived in the current phase, then the next phase starts. onCompletion runs once per phase,
+    // on the thread of the last arrival and before anyone is released. If it throws, the phase
+    // still ends and the futures of all its participants fail with the exception.
+    class AsyncBarrier
+    {
+    private:
+
+        int64_t               _participants_;
+        std::function<void()> _on_completion_;
+        std::atomic<int64_t>  _remaining_;
+        _InternalWaitList     _waiters_;
+
+        AsyncBarrier(AsyncBarrier const&) = delete;
+        AsyncBarrier& operator=(AsyncBarrier const&) = delete;
+
+    public:
+
+        explicit AsyncBarrier(size_t participants, std::function<void()> onCompletion = {})
+            : _participants_(participants > 0 ? static_cast<int64_t>(participants) : 1)
+            , _on_completion_(std::move(onCompletion))
+            , _remaining_(_participants_)
+        { }
+
+        Future<void> ArriveAndWait()
+        {
+            // Queue first: once the count reaches zero every participant of the phase is in the list
+            Future<void> fut = _waiters_._wait();
+
+            if (_remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                std::exception_ptr exception;
+
+                if (_on_completion_)
+                {
+                    try
+                    {
+                        _on_completion_();
+                    }
+                    catch (...)
+                    {
+                        exception = std::current_exception();
+                    }
+                }
+
+                // Released participants may arrive for the next phase right away
+                _remaining_.store(_participants_, std::memory_order_release);
+                _waiters_._release(exception);
+            }
+
+            return fut;
+        }
+    };
+}
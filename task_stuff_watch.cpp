@@ -0,0 +1,400 @@
+#include "task_stuff_watch.h"
+
+#include <cerrno>
+#include <mutex>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <unistd.h>
+
+namespace TaskStuff
+{
+    namespace
+    {
+        Task _fulfil(Promise<FileEvent> promise, FileEvent event)
+        {
+            return Task([promise = std::move(promise), event = std::move(event)]() mutable
+                {
+                    promise.SetValue(std::move(event));
+                });
+        }
+
+        Task _cancel(Promise<FileEvent> promise)
+        {
+            return Task([promise = std::move(promise)]() mutable
+                {
+                    promise.SetError(std::error_code(ECANCELED, std::system_category()));
+                });
+        }
+    }
+
+    struct _InternalFileSubscriptionState
+    {
+        std::mutex                  _mtx_;
+        int                         _wd_;
+        uint32_t                    _mask_;
+        Promise<FileEvent>          _promise_;
+        PersistentFuture<FileEvent> _next_;
+
+        _InternalFileSubscriptionState(int wd, uint32_t mask)
+            : _wd_(wd)
+            , _mask_(mask)
+            , _next_(_promise_.GetFuture())
+        { }
+
+        // Takes the promise of the current round and, unless it is the last one, starts the next round
+        Promise<FileEvent> _advance(bool last)
+        {
+            std::unique_lock lck(_mtx_);
+
+            Promise<FileEvent> current = std::move(_promise_);
+
+            if (!last)
+            {
+                _promise_ = Promise<FileEvent>();
+                _next_ = PersistentFuture<FileEvent>(_promise_.GetFuture());
+            }
+
+            return current;
+        }
+    };
+
+    class _InternalFileWatchState
+    {
+    private:
+
+        using _subscription = std::shared_ptr<_InternalFileSubscriptionState>;
+
+        struct _watch
+        {
+            std::string                                          _path_;
+            std::vector<std::pair<uint32_t, Promise<FileEvent>>> _once_;
+            std::vector<_subscription>                           _subscriptions_;
+        };
+
+        std::mutex                      _mtx_;
+        int                             _fd_;
+        bool                            _closed_ = false;
+        std::unordered_map<int, _watch> _watches_;
+
+        // Called with the lock held. Watching the same file again returns the existing watch
+        // descriptor, IN_MASK_ADD keeps the events the other listeners asked for.
+        int _addWatch(std::string const& path, uint32_t mask)
+        {
+            int wd = inotify_add_watch(_fd_, path.c_str(), mask | IN_MASK_ADD);
+
+            if (wd < 0)
+                throw std::system_error(errno, std::system_category(), path);
+
+            _watch& watch = _watches_[wd];
+            if (watch._path_.empty())
+                watch._path_ = path;
+
+            return wd;
+        }
+
+        // Called with the lock held, drops the kernel watch once nobody is listening anymore
+        void _release(int wd)
+        {
+            auto it = _watches_.find(wd);
+
+            if (it != _watches_.end() && it->second._once_.empty() && it->second._subscriptions_.empty())
+            {
+                inotify_rm_watch(_fd_, wd);
+                _watches_.erase(it);
+            }
+        }
+
+        // Called with the lock held
+        void _deliver(int wd, _watch& watch, uint32_t mask, std::string const& name, std::vector<Task>& completions)
+        {
+            FileEvent event{ watch._path_, name, mask };
+
+            // Everyone hears about the end of the watch and lost events, whatever they asked for
+            bool ended = mask & IN_IGNORED;
+            bool always = mask & (IN_IGNORED | IN_Q_OVERFLOW);
+
+            for (auto it = watch._once_.begin(); it != watch._once_.end(); )
+            {
+                if (always || (it->first & mask))
+                {
+                    completions.push_back(_fulfil(std::move(it->second), event));
+                    it = watch._once_.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+
+            for (_subscription const& sub : watch._subscriptions_)
+            {
+                if (always || (sub->_mask_ & mask))
+                    completions.push_back(_fulfil(sub->_advance(ended), event));
+            }
+
+            // The kernel already removed the watch
+            if (ended)
+                _watches_.erase(wd);
+            else
+                _release(wd);
+        }
+
+    public:
+
+        _InternalFileWatchState()
+            : _fd_(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+        {
+            if (_fd_ < 0)
+                throw std::system_error(errno, std::system_category(), "inotify_init1");
+        }
+
+        ~_InternalFileWatchState()
+        {
+            if (_fd_ >= 0)
+                close(_fd_);
+        }
+
+        int _fd() const
+        {
+            return _fd_;
+        }
+
+        Future<FileEvent> _watchOnce(std::string const& path, uint32_t mask)
+        {
+            std::unique_lock lck(_mtx_);
+
+            int wd = _addWatch(path, mask);
+
+            Promise<FileEvent> promise;
+            Future<FileEvent> fut = promise.GetFuture();
+            _watches_[wd]._once_.emplace_back(mask, std::move(promise));
+            return fut;
+        }
+
+        _subscription _subscribe(std::string const& path, uint32_t mask)
+        {
+            std::unique_lock lck(_mtx_);
+
+            int wd = _addWatch(path, mask);
+
+            auto sub = std::make_shared<_InternalFileSubscriptionState>(wd, mask);
+            _watches_[wd]._subscriptions_.push_back(sub);
+            return sub;
+        }
+
+        // False if the subscription had already been ended by the watcher
+        bool _unsubscribe(_InternalFileSubscriptionState* sub)
+        {
+            std::unique_lock lck(_mtx_);
+
+            auto it = _watches_.find(sub->_wd_);
+
+            if (it == _watches_.end())
+                return false;
+
+            auto& subscriptions = it->second._subscriptions_;
+
+            for (auto subIt = subscriptions.begin(); subIt != subscriptions.end(); ++subIt)
+            {
+                if (subIt->get() == sub)
+                {
+                    subscriptions.erase(subIt);
+                    _release(sub->_wd_);
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        // Called on the reactor thread, reads everything queued on the descriptor
+        void _read(std::vector<Task>& completions)
+        {
+            alignas(inotify_event) char buffer[4096];
+
+            std::unique_lock lck(_mtx_);
+
+            while (!_closed_)
+            {
+                ssize_t count = read(_fd_, buffer, sizeof(buffer));
+
+                if (count < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+
+                    return;
+                }
+
+                for (char* pos = buffer; pos < buffer + count; )
+                {
+                    inotify_event const* ev = reinterpret_cast<inotify_event const*>(pos);
+                    pos += sizeof(inotify_event) + ev->len;
+
+                    std::string name = ev->len > 0 ? std::string(ev->name) : std::string();
+
+                    if (ev->mask & IN_Q_OVERFLOW)
+                    {
+                        std::vector<int> wds;
+                        for (auto& [wd, watch] : _watches_)
+                            wds.push_back(wd);
+
+                        for (int wd : wds)
+                            _deliver(wd, _watches_[wd], ev->mask, name, completions);
+                    }
+                    else
+                    {
+                        auto it = _watches_.find(ev->wd);
+
+                        // Released while the event was queued
+                        if (it != _watches_.end())
+                            _deliver(ev->wd, it->second, ev->mask, name, completions);
+                    }
+                }
+            }
+        }
+
+        // Fails everything still waiting and closes the descriptor
+        void _close(std::vector<Task>& completions)
+        {
+            std::unique_lock lck(_mtx_);
+
+            _closed_ = true;
+
+            for (auto& [wd, watch] : _watches_)
+            {
+                for (auto& [mask, promise] : watch._once_)
+                    completions.push_back(_cancel(std::move(promise)));
+
+                for (_subscription const& sub : watch._subscriptions_)
+                    completions.push_back(_cancel(sub->_advance(true)));
+            }
+
+            _watches_.clear();
+
+            close(_fd_);
+            _fd_ = -1;
+        }
+    };
+
+    class _InternalInotifySource final : public _InternalReactorSource
+    {
+    private:
+
+        std::shared_ptr<_InternalFileWatchState> _state_;
+
+        void _postAll(std::vector<Task>& completions)
+        {
+            for (Task& task : completions)
+                _post(std::move(task));
+        }
+
+    public:
+
+        _InternalInotifySource(Reactor& reactor, std::shared_ptr<_InternalFileWatchState> state)
+            : _InternalReactorSource(reactor)
+            , _state_(std::move(state))
+        { }
+
+        // Edge triggered, _onReady reads until the descriptor is empty
+        void _watch()
+        {
+            _register(_state_->_fd(), EPOLLIN | EPOLLET);
+        }
+
+        void _onReady(uint32_t) override
+        {
+            std::vector<Task> completions;
+            _state_->_read(completions);
+            _postAll(completions);
+        }
+
+        void _close()
+        {
+            _unregister(_state_->_fd());
+
+            std::vector<Task> completions;
+            _state_->_close(completions);
+            _postAll(completions);
+
+            // The reactor may still be handling an event for the descriptor
+            _retire();
+        }
+    };
+
+    FileSubscription& FileSubscription::operator=(FileSubscription&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Cancel();
+
+            _state_ = std::move(other._state_);
+            _watcher_ = std::move(other._watcher_);
+        }
+
+        return *this;
+    }
+
+    FileSubscription::~FileSubscription()
+    {
+        Cancel();
+    }
+
+    PersistentFuture<FileEvent> FileSubscription::Next() const
+    {
+        if (!_state_)
+        {
+            throw FutureError(FutureErrorCode::NoState, "Subscription has no state!");
+        }
+
+        std::unique_lock lck(_state_->_mtx_);
+        return _state_->_next_;
+    }
+
+    void FileSubscription::Cancel()
+    {
+        if (!_state_)
+            return;
+
+        // Ended subscriptions were completed by the watcher already
+        if (auto watcher = _watcher_.lock())
+        {
+            if (watcher->_unsubscribe(_state_.get()))
+                _state_->_advance(true).SetError(std::error_code(ECANCELED, std::system_category()));
+        }
+
+        _state_.reset();
+        _watcher_.reset();
+    }
+
+    FileWatcher::FileWatcher(Reactor& reactor)
+        : _state_(std::make_shared<_InternalFileWatchState>())
+        , _source_(nullptr)
+    {
+        auto source = std::make_unique<_InternalInotifySource>(reactor, _state_);
+        source->_watch();
+        _source_ = source.release();
+    }
+
+    FileWatcher::~FileWatcher()
+    {
+        _source_->_close();
+    }
+
+    Future<FileEvent> FileWatcher::WatchFile(std::string const& path, uint32_t mask)
+    {
+        return _state_->_watchOnce(path, mask);
+    }
+
+    FileSubscription FileWatcher::Subscribe(std::string const& path, uint32_t mask)
+    {
+        FileSubscription subscription;
+        subscription._state_ = _state_->_subscribe(path, mask);
+        subscription._watcher_ = _state_;
+        return subscription;
+    }
+}
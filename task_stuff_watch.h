@@ -0,0 +1,114 @@
+#pragma once
+
+#include "task_stuff_reactor.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <sys/inotify.h>
+
+namespace TaskStuff
+{
+    class _InternalFileWatchState;
+    class _InternalInotifySource;
+    struct _InternalFileSubscriptionState;
+
+    struct FileEvent
+    {
+        std::string Path;     // Watched path the event was reported for
+        std::string Name;     // Entry inside a watched directory, empty if it is about Path itself
+        uint32_t    Mask = 0; // IN_* bits as reported by inotify
+
+        bool Modified() const
+        {
+            return Mask & (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB);
+        }
+
+        bool Created() const
+        {
+            return Mask & (IN_CREATE | IN_MOVED_TO);
+        }
+
+        bool Removed() const
+        {
+            return Mask & (IN_DELETE | IN_MOVED_FROM | IN_DELETE_SELF | IN_MOVE_SELF);
+        }
+
+        // Events were dropped because the kernel queue was full, rescan whatever is being watched
+        bool Overflowed() const
+        {
+            return Mask & IN_Q_OVERFLOW;
+        }
+
+        // The watch is gone, e.g. because the file was deleted or replaced by a rename
+        bool Ended() const
+        {
+            return Mask & IN_IGNORED;
+        }
+    };
+
+    // Persistent watch on a path. Every event completes the PersistentFuture handed out by Next,
+    // so any number of consumers can follow the same subscription. Next completes with the first
+    // event after the call, after the watch ended it keeps returning the IN_IGNORED event.
+    class FileSubscription
+    {
+    private:
+
+        std::shared_ptr<_InternalFileSubscriptionState> _state_;
+        std::weak_ptr<_InternalFileWatchState>          _watcher_;
+
+        FileSubscription(FileSubscription const&) = delete;
+        FileSubscription& operator=(FileSubscription const&) = delete;
+
+        friend class FileWatcher;
+
+    public:
+
+        FileSubscription() = default;
+        FileSubscription(FileSubscription&& other) noexcept = default;
+        FileSubscription& operator=(FileSubscription&& other) noexcept;
+
+        ~FileSubscription();
+
+        bool Valid() const
+        {
+            return _state_ != nullptr;
+        }
+
+        PersistentFuture<FileEvent> Next() const;
+
+        // Stops the subscription, a pending Next fails with ECANCELED
+        void Cancel();
+    };
+
+    // Multiplexes any number of watches over a single inotify descriptor read by the reactor.
+    // Futures are fulfilled on the reactor's executor. Editors usually save by renaming a new file
+    // over the old one, which ends a watch on the file itself; watch the directory to follow that.
+    class FileWatcher
+    {
+    private:
+
+        std::shared_ptr<_InternalFileWatchState> _state_;
+        _InternalInotifySource*                  _source_;
+
+        FileWatcher(FileWatcher const&) = delete;
+        FileWatcher& operator=(FileWatcher const&) = delete;
+
+    public:
+
+        static constexpr uint32_t DefaultMask = IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE
+            | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+
+        explicit FileWatcher(Reactor& reactor);
+
+        // Pending watches and subscriptions fail with ECANCELED
+        ~FileWatcher();
+
+        // Completes with the next event on path. Throws std::system_error if path can't be watched.
+        Future<FileEvent> WatchFile(std::string const& path, uint32_t mask = DefaultMask);
+
+        // Throws std::system_error if path can't be watched
+        FileSubscription Subscribe(std::string const& path, uint32_t mask = DefaultMask);
+    };
+}
@@ -0,0 +1,362 @@
+#include "test_util.h"
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+using namespace TaskStuff;
+
+namespace
+{
+    template <typename FutureT>
+    bool ThrowsRuntimeError(FutureT& fut)
+    {
+        try
+        {
+            fut.Get();
+        }
+        catch (std::runtime_error const&)
+        {
+            return true;
+        }
+
+        return false;
+    }
+
+    // The value lives in the shared state, every Get and continuation sees the same object
+    void PersistentValue()
+    {
+        Promise<std::vector<int>> promise;
+        PersistentFuture<std::vector<int>> persistent(promise.GetFuture());
+
+        Future<std::vector<int> const*> before = persistent.Then([](PersistentFuture<std::vector<int>>::shared_value_type value)
+            {
+                return value.get();
+            });
+
+        promise.SetValue(std::vector<int>{ 1, 2, 3 });
+
+        Future<std::vector<int> const*> after = persistent.Then([](PersistentFuture<std::vector<int>>::shared_value_type value)
+            {
+                return value.get();
+            });
+
+        std::vector<int> const& value = persistent.Get();
+
+        TS_CHECK((value == std::vector<int>{ 1, 2, 3 }));
+        TS_CHECK(&persistent.Get() == &value);
+        TS_CHECK(before.Get() == &value);
+        TS_CHECK(after.Get() == &value);
+    }
+
+    // Continuations waiting at completion run in the order they were added
+    void PersistentOrder()
+    {
+        Promise<int> promise;
+        PersistentFuture<int> persistent(promise.GetFuture());
+        std::vector<int> order;
+
+        for (int i = 0; i < 10; ++i)
+        {
+            persistent.Then([&order, i](PersistentFuture<int>::shared_value_type)
+                {
+                    order.push_back(i);
+                });
+        }
+
+        promise.SetValue(0);
+
+        TS_CHECK(order.size() == 10);
+
+        for (int i = 0; i < 10; ++i)
+            TS_CHECK(order[i] == i);
+    }
+
+    void PersistentChained()
+    {
+        Promise<int> promise;
+        PersistentFuture<int> persistent(promise.GetFuture());
+
+        Future<int> chained = persistent.Then([](PersistentFuture<int>::shared_value_type value)
+            {
+                return Future<int>(*value * 2);
+            });
+
+        promise.SetValue(21);
+        TS_CHECK(chained.Get() == 42);
+    }
+
+    void PersistentFailure()
+    {
+        Promise<int> failed;
+        PersistentFuture<int> persistentFailed(failed.GetFuture());
+        Future<int> continuation = persistentFailed.Then([](PersistentFuture<int>::shared_value_type value) { return *value; });
+
+        failed.SetException(std::make_exception_ptr(std::runtime_error("failed")));
+
+        TS_CHECK(ThrowsRuntimeError(persistentFailed));
+        TS_CHECK(ThrowsRuntimeError(persistentFailed));
+        TS_CHECK(ThrowsRuntimeError(continuation));
+
+        Promise<int> errored;
+        PersistentFuture<int> persistentErrored(errored.GetFuture());
+        errored.SetError(std::make_error_code(std::errc::timed_out));
+
+        Future<int> late = persistentErrored.Then([](PersistentFuture<int>::shared_value_type value) { return *value; });
+        TS_CHECK(late.HasError());
+
+        bool thrown = false;
+
+        try
+        {
+            persistentErrored.Get();
+        }
+        catch (std::system_error const& e)
+        {
+            thrown = e.code() == std::errc::timed_out;
+        }
+
+        TS_CHECK(thrown);
+    }
+
+    // Threads subscribe while the value arrives, every continuation has to run exactly once
+    void PersistentStress()
+    {
+        constexpr int threadCount = 4;
+        constexpr int perThread = 2000;
+
+        for (int round = 0; round < 20; ++round)
+        {
+            Promise<int> promise;
+            PersistentFuture<int> persistent(promise.GetFuture());
+
+            std::atomic<int> calls(0);
+            std::atomic<int> started(0);
+            std::vector<std::thread> threads;
+
+            for (int t = 0; t < threadCount; ++t)
+            {
+                threads.emplace_back([&]()
+                    {
+                        ++started;
+
+                        for (int i = 0; i < perThread; ++i)
+                        {
+                            persistent.Then([&calls](PersistentFuture<int>::shared_value_type value)
+                                {
+                                    calls.fetch_add(*value);
+                                });
+                        }
+                    });
+            }
+
+            while (started.load() < threadCount)
+                std::this_thread::yield();
+
+            promise.SetValue(1);
+
+            for (std::thread& thread : threads)
+                thread.join();
+
+            TS_CHECK(calls.load() == threadCount * perThread);
+        }
+    }
+
+    // Subscribers waiting at completion are batched onto the pool, the completing thread only runs the last batch
+    void PersistentBroadcast()
+    {
+        constexpr int subscribers = 1000;
+        constexpr size_t batchSize = 16;
+
+        ThreadPool pool(4);
+
+        Promise<int> promise;
+        PersistentFuture<int> persistent(promise.GetFuture(), pool, batchSize);
+
+        std::atomic<int> onCompleting(0);
+        std::vector<Future<int>> results;
+
+        for (int i = 0; i < subscribers; ++i)
+        {
+            results.push_back(persistent.Then([&onCompleting, completing = std::this_thread::get_id(), i](PersistentFuture<int>::shared_value_type value)
+                {
+                    if (std::this_thread::get_id() == completing)
+                        ++onCompleting;
+
+                    return *value + i;
+                }));
+        }
+
+        promise.SetValue(1);
+
+        for (int i = 0; i < subscribers; ++i)
+            TS_CHECK(results[i].Get() == i + 1);
+
+        TS_CHECK(onCompleting.load() <= static_cast<int>(batchSize));
+
+        // Subscribers added after completion run right away on their own thread
+        bool ranInline = false;
+        persistent.Then([&ranInline](PersistentFuture<int>::shared_value_type) { ranInline = true; });
+        TS_CHECK(ranInline);
+    }
+
+    // A batch size of 0 is treated as 1, failures are broadcast through the pool as well
+    void PersistentBroadcastFailure()
+    {
+        ThreadPool pool(2);
+
+        Promise<int> promise;
+        PersistentFuture<int> persistent(promise.GetFuture(), pool, 0);
+        std::vector<Future<int>> results;
+
+        for (int i = 0; i < 100; ++i)
+            results.push_back(persistent.Then([](PersistentFuture<int>::shared_value_type value) { return *value; }));
+
+        promise.SetException(std::make_exception_ptr(std::runtime_error("failed")));
+
+        for (Future<int>& result : results)
+            TS_CHECK(ThrowsRuntimeError(result));
+    }
+
+    template <typename FutureT>
+    concept Shareable = requires(FutureT fut) { fut.Share(); };
+
+    static_assert(Shareable<Future<int>>);
+    static_assert(!Shareable<Future<void>>, "There is no SharedFuture<void>");
+
+    // Move-only values are shared, continuations get a const reference to the one stored value
+    void SharedMoveOnly()
+    {
+        Promise<std::unique_ptr<int>> promise;
+        SharedFuture<std::unique_ptr<int>> shared = promise.GetFuture().Share();
+        SharedFuture<std::unique_ptr<int>> copy = shared;
+
+        Future<int*> before = shared.Then([](std::unique_ptr<int> const& value)
+            {
+                return value.get();
+            });
+
+        Future<int> chained = copy.Then([](std::unique_ptr<int> const& value)
+            {
+                return Future<int>(*value + 1);
+            });
+
+        promise.SetValue(std::make_unique<int>(41));
+
+        int* address = shared.Get().get();
+
+        TS_CHECK(*shared.Get() == 41);
+        TS_CHECK(copy.Get().get() == address);
+        TS_CHECK(before.Get() == address);
+        TS_CHECK(chained.Get() == 42);
+
+        Future<int*> after = copy.Then([](std::unique_ptr<int> const& value)
+            {
+                return value.get();
+            });
+
+        TS_CHECK(after.Get() == address);
+    }
+
+    // The state outlives the SharedFuture it was created from as long as a copy or continuation is left
+    void SharedCopiesOutliveOriginal()
+    {
+        Promise<std::string> promise;
+        std::optional<SharedFuture<std::string>> original(promise.GetFuture().Share());
+
+        SharedFuture<std::string> copy = *original;
+        Future<size_t> length = original->Then([](std::string const& value) { return value.size(); });
+
+        original.reset();
+        promise.SetValue("shared");
+
+        TS_CHECK(copy.Get() == "shared");
+        TS_CHECK(length.Get() == 6);
+
+        SharedFuture<std::string> moved = std::move(copy);
+        TS_CHECK(!copy.Valid());
+        TS_CHECK(moved.Get() == "shared");
+    }
+
+    void SharedFailure()
+    {
+        Promise<std::unique_ptr<int>> promise;
+        SharedFuture<std::unique_ptr<int>> shared = promise.GetFuture().Share();
+        Future<int> continuation = shared.Then([](std::unique_ptr<int> const& value) { return *value; });
+
+        promise.SetException(std::make_exception_ptr(std::runtime_error("failed")));
+
+        TS_CHECK(ThrowsRuntimeError(shared));
+        TS_CHECK(ThrowsRuntimeError(continuation));
+        TS_CHECK(TaskStuffTests::FailsWith(SharedFuture<int>(), FutureErrorCode::NoState));
+    }
+
+    // Copies are made and dropped on other threads while the value arrives
+    void SharedStress()
+    {
+        constexpr int threadCount = 4;
+        constexpr int perThread = 2000;
+
+        for (int round = 0; round < 20; ++round)
+        {
+            Promise<int> promise;
+            SharedFuture<int> shared = promise.GetFuture().Share();
+
+            std::atomic<int> calls(0);
+            std::atomic<int> started(0);
+            std::vector<std::thread> threads;
+
+            for (int t = 0; t < threadCount; ++t)
+            {
+                threads.emplace_back([&calls, &started, shared]()
+                    {
+                        ++started;
+
+                        for (int i = 0; i < perThread; ++i)
+                        {
+                            SharedFuture<int> copy = shared;
+
+                            copy.Then([&calls](int const& value)
+                                {
+                                    calls.fetch_add(value);
+                                });
+                        }
+                    });
+            }
+
+            while (started.load() < threadCount)
+                std::this_thread::yield();
+
+            promise.SetValue(1);
+            shared = SharedFuture<int>();
+
+            for (std::thread& thread : threads)
+                thread.join();
+
+            TS_CHECK(calls.load() == threadCount * perThread);
+        }
+    }
+}
+
+int main()
+{
+    PersistentValue();
+    PersistentOrder();
+    PersistentChained();
+    PersistentFailure();
+    PersistentStress();
+    PersistentBroadcast();
+    PersistentBroadcastFailure();
+
+    SharedMoveOnly();
+    SharedCopiesOutliveOriginal();
+    SharedFailure();
+    SharedStress();
+
+    return 0;
+}
@@ -0,0 +1,408 @@
+#include "../task_stuff_channel.h"
+#include "test_util.h"
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using namespace TaskStuff;
+using TaskStuffTests::FailsWith;
+
+namespace
+{
+    void Backpressure()
+    {
+        Channel<int> channel(2);
+        TS_CHECK(channel.Capacity() == 2);
+
+        Future<void> first = channel.Send(1);
+        Future<void> second = channel.Send(2);
+        TS_CHECK(first.IsReady() && second.IsReady());
+
+        // The channel is full, the sends park until receivers make room, in order
+        Future<void> third = channel.Send(3);
+        Future<void> fourth = channel.Send(4);
+        TS_CHECK(!third.IsReady() && !fourth.IsReady());
+
+        TS_CHECK(channel.Receive().Get() == 1);
+        TS_CHECK(third.IsReady() && !fourth.IsReady());
+
+        TS_CHECK(channel.Receive().Get() == 2);
+        TS_CHECK(fourth.IsReady());
+
+        TS_CHECK(channel.Receive().Get() == 3);
+        TS_CHECK(channel.Receive().Get() == 4);
+
+        // An empty channel parks the receiver until a value arrives
+        Future<int> receive = channel.Receive();
+        TS_CHECK(!receive.IsReady());
+        channel.Send(5).Get();
+        TS_CHECK(receive.Get() == 5);
+    }
+
+    void CloseDrains()
+    {
+        Channel<int> channel(4);
+
+        for (int i = 0; i < 6; ++i)
+            channel.Send(i);
+
+        // Buffered values are still delivered after Close, parked senders fail
+        channel.Close();
+        TS_CHECK(channel.IsClosed());
+        TS_CHECK(FailsWith(channel.Send(6), FutureErrorCode::ChannelClosed));
+
+        for (int i = 0; i < 4; ++i)
+            TS_CHECK(channel.Receive().Get() == i);
+
+        TS_CHECK(FailsWith(channel.Receive(), FutureErrorCode::ChannelClosed));
+
+        // Receivers parked on an empty channel fail once it is closed
+        Channel<int> empty(2);
+        Future<int> parked = empty.Receive();
+        TS_CHECK(!parked.IsReady());
+        empty.Close();
+        TS_CHECK(FailsWith(std::move(parked), FutureErrorCode::ChannelClosed));
+    }
+
+    void ClosedParkedSenders()
+    {
+        Channel<int> channel(2);
+        channel.Send(0);
+        channel.Send(1);
+
+        Future<void> parked = channel.Send(2);
+        TS_CHECK(!parked.IsReady());
+        channel.Close();
+        TS_CHECK(FailsWith(std::move(parked), FutureErrorCode::ChannelClosed));
+
+        TS_CHECK(channel.Receive().Get() == 0);
+        TS_CHECK(channel.Receive().Get() == 1);
+        TS_CHECK(FailsWith(channel.Receive(), FutureErrorCode::ChannelClosed));
+    }
+
+    void ReceiveMany()
+    {
+        Channel<int> channel(8);
+
+        for (int i = 0; i < 5; ++i)
+            channel.Send(i);
+
+        std::vector<int> values = channel.ReceiveMany(3).Get();
+        TS_CHECK((values == std::vector<int>{ 0, 1, 2 }));
+
+        values = channel.ReceiveMany(10).Get();
+        TS_CHECK((values == std::vector<int>{ 3, 4 }));
+
+        // Takes nothing, not even from a channel holding values
+        channel.Send(5);
+        Future<std::vector<int>> none = channel.ReceiveMany(0);
+        TS_CHECK(none.IsReady() && none.Get().empty());
+        TS_CHECK(channel.Receive().Get() == 5);
+    }
+
+    // Several producers push through a small channel to one consumer, values of one producer
+    // have to arrive in the order it sent them
+    void ProducerOrder()
+    {
+        constexpr int producerCount = 4;
+        constexpr int perProducer = 20000;
+
+        Channel<int64_t> channel(8);
+        std::vector<std::thread> producers;
+
+        for (int p = 0; p < producerCount; ++p)
+        {
+            producers.emplace_back([channel, p]() mutable
+                {
+                    for (int i = 0; i < perProducer; ++i)
+                        channel.Send(static_cast<int64_t>(p) << 32 | i).Get();
+                });
+        }
+
+        std::vector<int64_t> next(producerCount, 0);
+
+        for (int received = 0; received < producerCount * perProducer; ++received)
+        {
+            int64_t value = channel.Receive().Get();
+            int64_t producer = value >> 32;
+
+            TS_CHECK(producer >= 0 && producer < producerCount);
+            TS_CHECK((value & 0xffffffff) == next[producer]);
+            ++next[producer];
+        }
+
+        for (std::thread& producer : producers)
+            producer.join();
+
+        channel.Close();
+        TS_CHECK(FailsWith(channel.Receive(), FutureErrorCode::ChannelClosed));
+    }
+
+    // Many producers and consumers, every value is received exactly once and consumers see the
+    // close once everything was drained
+    void ManyToMany()
+    {
+        constexpr int producerCount = 4;
+        constexpr int consumerCount = 4;
+        constexpr int perProducer = 20000;
+        constexpr int total = producerCount * perProducer;
+
+        Channel<int> channel(16);
+        std::vector<std::atomic<int>> seen(total);
+        std::atomic<int> receivedCount(0);
+        std::vector<std::thread> threads;
+
+        for (int c = 0; c < consumerCount; ++c)
+        {
+            threads.emplace_back([&, channel]() mutable
+                {
+                    while (true)
+                    {
+                        Result<int> result = channel.Receive().GetResult();
+
+                        if (!result.HasValue())
+                            break;
+
+                        seen[result.Get()].fetch_add(1);
+                        receivedCount.fetch_add(1);
+                    }
+                });
+        }
+
+        std::vector<std::thread> producers;
+
+        for (int p = 0; p < producerCount; ++p)
+        {
+            producers.emplace_back([channel, p]() mutable
+                {
+                    std::vector<Future<void>> sends;
+
+                    // Without waiting for each send, the parked ones keep their order
+                    for (int i = 0; i < perProducer; ++i)
+                        sends.push_back(channel.Send(p * perProducer + i));
+
+                    for (Future<void>& send : sends)
+                        send.Get();
+                });
+        }
+
+        for (std::thread& producer : producers)
+            producer.join();
+
+        channel.Close();
+
+        for (std::thread& thread : threads)
+            thread.join();
+
+        TS_CHECK(receivedCount.load() == total);
+
+        for (std::atomic<int>& count : seen)
+            TS_CHECK(count.load() == 1);
+    }
+
+    void SelectReceive()
+    {
+        Channel<int> a(2);
+        Channel<int> b(2);
+        b.Send(7);
+
+        int received = 0;
+
+        Future<size_t> selected = Select()
+            .Receive(a, [&](int value) { received = value; })
+            .Receive(b, [&](int value) { received = -value; })
+            .Run();
+
+        TS_CHECK(selected.Get() == 1);
+        TS_CHECK(received == -7);
+
+        // The losing branch was withdrawn, so it doesn't take the next value of a
+        a.Send(1);
+        TS_CHECK(a.Receive().Get() == 1);
+    }
+
+    void SelectParked()
+    {
+        Channel<int> a(2);
+        Channel<int> b(2);
+
+        // Both channels are empty, the select waits for whichever gets a value first
+        int received = 0;
+
+        Future<size_t> selected = Select()
+            .Receive(a, [&](int value) { received = value; })
+            .Receive(b, [&](int value) { received = -value; })
+            .Run();
+
+        TS_CHECK(!selected.IsReady());
+        a.Send(3);
+        TS_CHECK(selected.Get() == 0);
+        TS_CHECK(received == 3);
+
+        b.Send(4);
+        TS_CHECK(b.Receive().Get() == 4);
+    }
+
+    void SelectSendAndFuture()
+    {
+        Channel<int> full(2);
+        full.Send(0);
+        full.Send(1);
+
+        Promise<int> promise;
+        int outcome = 0;
+
+        Future<size_t> selected = Select()
+            .Send(full, 2, [&]() { outcome = 1; })
+            .OnReady(promise.GetFuture(), [&](Result<int> result) { outcome = result.Get(); })
+            .Run();
+
+        TS_CHECK(!selected.IsReady());
+        promise.SetValue(42);
+        TS_CHECK(selected.Get() == 1);
+        TS_CHECK(outcome == 42);
+
+        // The value of the send that lost never made it into the channel
+        TS_CHECK(full.Receive().Get() == 0);
+        TS_CHECK(full.Receive().Get() == 1);
+        TS_CHECK(!full.Receive().IsReady());
+    }
+
+    void SelectClosed()
+    {
+        Channel<int> closed(2);
+        closed.Close();
+
+        Future<size_t> received = Select()
+            .Receive(closed, [](int) { TS_CHECK(false); })
+            .Run();
+
+        TS_CHECK(FailsWith(std::move(received), FutureErrorCode::ChannelClosed));
+
+        Future<size_t> sent = Select()
+            .Send(closed, 1, []() { TS_CHECK(false); })
+            .Run();
+
+        TS_CHECK(FailsWith(std::move(sent), FutureErrorCode::ChannelClosed));
+
+        // A send parked on a full channel fails once the channel is closed
+        Channel<int> full(2);
+        full.Send(0);
+        full.Send(1);
+
+        Future<size_t> parked = Select()
+            .Send(full, 2, []() { TS_CHECK(false); })
+            .Run();
+
+        TS_CHECK(!parked.IsReady());
+        full.Close();
+        TS_CHECK(FailsWith(std::move(parked), FutureErrorCode::ChannelClosed));
+        TS_CHECK(full.Receive().Get() == 0);
+        TS_CHECK(full.Receive().Get() == 1);
+        TS_CHECK(FailsWith(full.Receive(), FutureErrorCode::ChannelClosed));
+
+        // A closed channel ends the select even if a later branch could go ahead
+        Channel<int> open(2);
+        open.Send(3);
+
+        Future<size_t> first = Select()
+            .Receive(closed, [](int) { TS_CHECK(false); })
+            .Receive(open, [](int) { TS_CHECK(false); })
+            .Run();
+
+        TS_CHECK(FailsWith(std::move(first), FutureErrorCode::ChannelClosed));
+        TS_CHECK(open.Receive().Get() == 3);
+    }
+
+    // Consumers select between two channels fed by their own producers, every value has to be
+    // taken by exactly one select
+    void SelectStress()
+    {
+        constexpr int consumerCount = 4;
+        constexpr int perChannel = 20000;
+        constexpr int total = 2 * perChannel;
+
+        Channel<int> a(4);
+        Channel<int> b(4);
+        std::vector<std::atomic<int>> seen(total);
+        std::atomic<int> receivedCount(0);
+        std::vector<std::thread> threads;
+
+        for (int c = 0; c < consumerCount; ++c)
+        {
+            threads.emplace_back([&]()
+                {
+                    while (true)
+                    {
+                        auto take = [&](int value)
+                            {
+                                seen[value].fetch_add(1);
+                                receivedCount.fetch_add(1);
+                            };
+
+                        Result<size_t> result = Select()
+                            .Receive(a, take)
+                            .Receive(b, take)
+                            .Run()
+                            .GetResult();
+
+                        if (!result.HasValue())
+                            break;
+                    }
+                });
+        }
+
+        std::thread producerA([&]()
+            {
+                for (int i = 0; i < perChannel; ++i)
+                    a.Send(i).Get();
+            });
+
+        std::thread producerB([&]()
+            {
+                for (int i = 0; i < perChannel; ++i)
+                    b.Send(perChannel + i).Get();
+            });
+
+        producerA.join();
+        producerB.join();
+
+        // A select only fails once the channel it got the close from was drained
+        while (receivedCount.load() < total)
+            std::this_thread::yield();
+
+        a.Close();
+        b.Close();
+
+        for (std::thread& thread : threads)
+            thread.join();
+
+        TS_CHECK(receivedCount.load() == total);
+
+        for (std::atomic<int>& count : seen)
+            TS_CHECK(count.load() == 1);
+    }
+}
+
+int main()
+{
+    Backpressure();
+    CloseDrains();
+    ClosedParkedSenders();
+    ReceiveMany();
+    SelectReceive();
+    SelectParked();
+    SelectSendAndFuture();
+    SelectClosed();
+
+    for (int round = 0; round < 5; ++round)
+    {
+        ProducerOrder();
+        ManyToMany();
+        SelectStress();
+    }
+
+    return 0;
+}
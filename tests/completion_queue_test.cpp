@@ -0,0 +1,153 @@
+#include "../task_stuff_completion_queue.h"
+#include "test_util.h"
+
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+
+using namespace TaskStuff;
+
+namespace
+{
+    bool Readable(CompletionQueue& queue, int timeoutMs = 0)
+    {
+        pollfd pfd{ queue.FileDescriptor(), POLLIN, 0 };
+        return poll(&pfd, 1, timeoutMs) == 1 && (pfd.revents & POLLIN);
+    }
+
+    void DispatchOnReadable()
+    {
+        CompletionQueue queue;
+        TS_CHECK(!Readable(queue));
+
+        Promise<int> promise;
+        std::optional<int> received;
+
+        queue.Add(promise.GetFuture(), [&received](Result<int> result)
+            {
+                received = result.Get();
+            });
+
+        TS_CHECK(!Readable(queue));
+        promise.SetValue(5);
+
+        // The handler waits for Dispatch instead of running on the completing thread
+        TS_CHECK(!received);
+        TS_CHECK(Readable(queue));
+        TS_CHECK(queue.Dispatch() == 1);
+        TS_CHECK(received == 5);
+        TS_CHECK(!Readable(queue));
+
+        // Failures and already completed futures are queued the same way
+        bool failed = false;
+        queue.Add(Future<int>(1), [](Result<int>) {});
+        queue.Add(Promise<int>().GetFuture(), [&failed](Result<int> result) { failed = result.HasException(); });
+
+        TS_CHECK(Readable(queue));
+        TS_CHECK(queue.Dispatch() == 2);
+        TS_CHECK(failed);
+    }
+
+    // One descriptor serves futures completed by many threads, the handlers all run on the polling thread
+    void ManyProducers()
+    {
+        constexpr int count = 1000;
+
+        CompletionQueue queue;
+        std::vector<Promise<int>> promises(count);
+        int sum = 0;
+        int handled = 0;
+        std::thread::id loop = std::this_thread::get_id();
+
+        for (auto& promise : promises)
+        {
+            queue.Add(promise.GetFuture(), [&sum, &handled, loop](Result<int> result)
+                {
+                    TS_CHECK(std::this_thread::get_id() == loop);
+                    sum += result.Get();
+                    ++handled;
+                });
+        }
+
+        std::vector<std::thread> producers;
+
+        for (int t = 0; t < 4; ++t)
+        {
+            producers.emplace_back([&promises, t]()
+                {
+                    for (int i = t; i < count; i += 4)
+                        promises[i].SetValue(i);
+                });
+        }
+
+        while (handled < count)
+        {
+            TS_CHECK(Readable(queue, 10000));
+            queue.Dispatch();
+        }
+
+        for (std::thread& producer : producers)
+            producer.join();
+
+        TS_CHECK(sum == count * (count - 1) / 2);
+        TS_CHECK(!Readable(queue));
+    }
+
+    // The handlers after one that throws stay queued and the descriptor stays readable
+    void ThrowingHandler()
+    {
+        CompletionQueue queue;
+        std::vector<int> ran;
+
+        queue.Add(Future<int>(1), [&ran](Result<int> result) { ran.push_back(result.Get()); });
+        queue.Add(Future<int>(2), [](Result<int>) { throw std::runtime_error("handler failed"); });
+        queue.Add(Future<int>(3), [&ran](Result<int> result) { ran.push_back(result.Get()); });
+
+        bool thrown = false;
+
+        try
+        {
+            queue.Dispatch();
+        }
+        catch (std::runtime_error const&)
+        {
+            thrown = true;
+        }
+
+        TS_CHECK(thrown);
+        TS_CHECK((ran == std::vector<int>{ 1 }));
+        TS_CHECK(Readable(queue));
+
+        TS_CHECK(queue.Dispatch() == 1);
+        TS_CHECK((ran == std::vector<int>{ 1, 3 }));
+        TS_CHECK(!Readable(queue));
+    }
+
+    // Futures still pending when the queue goes away complete without a queue to run on
+    void QueueDestroyedFirst()
+    {
+        Promise<int> promise;
+        bool called = false;
+
+        {
+            CompletionQueue queue;
+            queue.Add(promise.GetFuture(), [&called](Result<int>) { called = true; });
+        }
+
+        promise.SetValue(1);
+        TS_CHECK(!called);
+    }
+}
+
+int main()
+{
+    DispatchOnReadable();
+    ManyProducers();
+    ThrowingHandler();
+    QueueDestroyedFirst();
+
+    return 0;
+}
@@ -0,0 +1,185 @@
+#include "../task_stuff_file.h"
+#include "test_util.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+
+using namespace TaskStuff;
+using TaskStuffTests::TempFile;
+
+namespace
+{
+    std::vector<std::byte> Pattern(size_t size, unsigned seed)
+    {
+        std::vector<std::byte> data(size);
+
+        for (size_t i = 0; i < size; ++i)
+            data[i] = static_cast<std::byte>((i * 31 + seed) & 0xff);
+
+        return data;
+    }
+
+    void RoundTrip(FileIoService& service)
+    {
+        TempFile temp;
+        AsyncFile file = AsyncFile::Open(service, temp.Path(), O_RDWR);
+
+        std::vector<std::byte> written = Pattern(64 * 1024, 7);
+        TS_CHECK(file.Write(written, 0).Get() == written.size());
+        file.Fsync().Get();
+
+        std::vector<std::byte> read(written.size());
+        TS_CHECK(file.Read(read, 0).Get() == read.size());
+        TS_CHECK(read == written);
+
+        // Reading at the end of the file is a short read of nothing
+        TS_CHECK(file.Read(read, written.size()).Get() == 0);
+    }
+
+    void ConcurrentWrites(FileIoService& service)
+    {
+        constexpr size_t blockSize = 4096;
+        constexpr size_t blockCount = 1024; // More than the queue depth, so submissions wait for capacity
+
+        TempFile temp;
+        AsyncFile file = AsyncFile::Open(service, temp.Path(), O_RDWR);
+
+        std::vector<std::vector<std::byte>> blocks;
+        std::vector<Future<size_t>> writes;
+
+        for (size_t i = 0; i < blockCount; ++i)
+            blocks.push_back(Pattern(blockSize, static_cast<unsigned>(i)));
+
+        for (size_t i = 0; i < blockCount; ++i)
+            writes.push_back(file.Write(blocks[i], i * blockSize));
+
+        for (Future<size_t>& write : writes)
+            TS_CHECK(write.Get() == blockSize);
+
+        std::vector<std::byte> block(blockSize);
+
+        for (size_t i = 0; i < blockCount; ++i)
+        {
+            TS_CHECK(file.Read(block, i * blockSize).Get() == blockSize);
+            TS_CHECK(block == blocks[i]);
+        }
+    }
+
+    void BadDescriptor(FileIoService& service)
+    {
+        std::vector<std::byte> buffer(16);
+        Future<size_t> read = service.Read(-1, buffer, 0);
+
+        try
+        {
+            read.Get();
+            TS_CHECK(false);
+        }
+        catch (std::system_error const& e)
+        {
+            TS_CHECK(e.code().value() == EBADF);
+        }
+
+        Future<void> fsync = service.Fsync(-1);
+
+        try
+        {
+            fsync.Get();
+            TS_CHECK(false);
+        }
+        catch (std::system_error const& e)
+        {
+            TS_CHECK(e.code().value() == EBADF);
+        }
+    }
+
+    // Continuations run on the completion thread with io_uring, requests they make while the
+    // ring is full must not wait for capacity only that thread can free
+    void SubmitFromContinuations(FileIoService& service)
+    {
+        TempFile temp;
+        AsyncFile file = AsyncFile::Open(service, temp.Path(), O_RDWR);
+
+        std::vector<std::byte> data = Pattern(4096, 3);
+        TS_CHECK(file.Write(data, 0).Get() == data.size());
+
+        std::atomic<int> leaves(0);
+        std::atomic<int> failures(0);
+        std::function<void(int)> read;
+
+        // Every read starts two more until depth reaches zero, so the requests keep outgrowing the ring
+        read = [&](int depth)
+            {
+                auto buffer = std::make_shared<std::vector<std::byte>>(512);
+
+                file.Read(*buffer, 0).OnComplete([&, buffer, depth](Result<size_t> result)
+                    {
+                        if (!result.HasValue() || result.Get() != buffer->size())
+                            failures.fetch_add(1);
+
+                        if (depth == 0)
+                        {
+                            leaves.fetch_add(1);
+                            return;
+                        }
+
+                        read(depth - 1);
+                        read(depth - 1);
+                    });
+            };
+
+        read(7);
+        read(7);
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+
+        while (leaves.load() < 2 << 7)
+        {
+            TS_CHECK(std::chrono::steady_clock::now() < deadline);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        TS_CHECK(failures.load() == 0);
+    }
+
+    void RunAll(FileIoService& service)
+    {
+        RoundTrip(service);
+        ConcurrentWrites(service);
+        BadDescriptor(service);
+    }
+}
+
+int main()
+{
+    // Falls back to the pool where io_uring isn't available, in which case both runs cover the pool
+    {
+        FileIoService service(FileIoBackend::Auto, 64);
+        std::printf("auto backend uses io_uring: %s\n", service.UsesIoUring() ? "yes" : "no");
+        RunAll(service);
+    }
+
+    {
+        FileIoService service(FileIoBackend::ThreadPool);
+        TS_CHECK(!service.UsesIoUring());
+        RunAll(service);
+    }
+
+    // The smallest ring, so nearly every request made by a continuation finds it full
+    {
+        FileIoService service(FileIoBackend::Auto, 1);
+        SubmitFromContinuations(service);
+    }
+
+    return 0;
+}
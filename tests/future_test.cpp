@@ -0,0 +1,856 @@
+#include "test_util.h"
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <utility>
+
+using namespace TaskStuff;
+
+namespace
+{
+    // Steps of the async loops below. They are completed one at a time by RunSteps, so every
+    // continuation runs from there rather than inline while the loop is being built.
+    std::deque<Promise<int>> pendingSteps;
+
+    Future<int> Step()
+    {
+        pendingSteps.emplace_back();
+        return pendingSteps.back().GetFuture();
+    }
+
+    // Every step continues with the future of the next one, the result is the sum of the step values
+    Future<int> Loop(int remaining, int sum)
+    {
+        if (remaining == 0)
+            return Future<int>(sum);
+
+        return Step().Then([remaining, sum](int value)
+            {
+                return Loop(remaining - 1, sum + value);
+            });
+    }
+
+    // Completes the pending steps with value, except for step failAt which fails with an exception
+    void RunSteps(int value, int failAt = -1)
+    {
+        for (int i = 0; !pendingSteps.empty(); ++i)
+        {
+            Promise<int> step = std::move(pendingSteps.front());
+            pendingSteps.pop_front();
+
+            if (i == failAt)
+                step.SetException(std::runtime_error("step failed"));
+            else
+                step.SetValue(value);
+        }
+    }
+
+    // Without collapsing, each step would add a forwarding promise and completing the last one
+    // would walk all of them recursively
+    void ChainCollapsing()
+    {
+        constexpr int steps = 200000;
+
+        Future<int> result = Loop(steps, 0);
+        TS_CHECK(!result.IsReady());
+
+        RunSteps(1);
+        TS_CHECK(result.Get() == steps);
+    }
+
+    void ChainFailure()
+    {
+        Future<int> result = Loop(1000, 0);
+
+        RunSteps(1, 999);
+        TS_CHECK(result.HasException());
+
+        bool thrown = false;
+
+        try
+        {
+            result.Get();
+        }
+        catch (std::runtime_error const&)
+        {
+            thrown = true;
+        }
+
+        TS_CHECK(thrown);
+    }
+
+    void ChainOnReady()
+    {
+        Future<int> result = Future<int>(1).Then([](int value)
+            {
+                return Future<int>(value + 1).Then([](int inner)
+                    {
+                        return Future<int>(inner * 10);
+                    });
+            });
+
+        TS_CHECK(result.Get() == 20);
+    }
+
+    void LocalChain()
+    {
+        LocalPromise<int> promise;
+        LocalFuture<int> fut = promise.GetFuture();
+
+        auto doubled = fut.Then([](int value) { return value * 2; });
+        static_assert(std::is_same_v<decltype(doubled), LocalFuture<int>>);
+
+        auto chained = doubled.Then([](int value)
+            {
+                return LocalFuture<int>(value + 1);
+            });
+
+        TS_CHECK(!chained.IsReady());
+        promise.SetValue(20);
+
+        TS_CHECK(chained.IsReady());
+        TS_CHECK(chained.Get() == 41);
+    }
+
+    void LocalWhenAll()
+    {
+        std::vector<LocalPromise<int>> promises(3);
+        std::vector<LocalFuture<int>> futures;
+
+        for (auto& promise : promises)
+            futures.push_back(promise.GetFuture());
+
+        LocalFuture<std::vector<int>> all = WhenAll(std::span<LocalFuture<int>>(futures));
+
+        for (int i = 0; i < 3; ++i)
+        {
+            TS_CHECK(!all.IsReady());
+            promises[i].SetValue(i);
+        }
+
+        TS_CHECK((all.Get() == std::vector<int>{ 0, 1, 2 }));
+    }
+
+    // Nothing else can complete a single threaded future, so waiting on one that isn't ready fails
+    void LocalGetWouldDeadlock()
+    {
+        LocalPromise<int> promise;
+        TS_CHECK(TaskStuffTests::FailsWith(promise.GetFuture(), FutureErrorCode::WouldDeadlock));
+
+        LocalFuture<void> broken = LocalPromise<void>().GetFuture();
+        TS_CHECK(TaskStuffTests::FailsWith(std::move(broken), FutureErrorCode::BrokenPromise));
+    }
+
+    // Constructed fine, but moving it into a future's state throws
+    struct ThrowsOnMove
+    {
+        ThrowsOnMove() = default;
+
+        ThrowsOnMove(ThrowsOnMove&&)
+        {
+            throw std::runtime_error("move failed");
+        }
+    };
+
+    template <typename FutureT>
+    bool ThrowsRuntimeError(FutureT fut)
+    {
+        try
+        {
+            fut.Get();
+        }
+        catch (std::runtime_error const&)
+        {
+            return true;
+        }
+
+        return false;
+    }
+
+    void NoexceptContinuations()
+    {
+        Promise<int> promise;
+        Future<int> pending = promise.GetFuture().Then([](int value) noexcept { return value + 1; });
+        Future<int> ready = Future<int>(1).Then([](int value) noexcept { return value + 1; });
+
+        int calls = 0;
+        Future<void> done = ready.Then([&calls](int value) noexcept { calls += value; });
+
+        promise.SetValue(1);
+
+        TS_CHECK(pending.Get() == 2);
+        TS_CHECK(calls == 2);
+        TS_CHECK(done.HasValue());
+    }
+
+    void ThrowingContinuations()
+    {
+        Promise<int> promise;
+        Future<int> pending = promise.GetFuture().Then([](int) -> int { throw std::runtime_error("continuation failed"); });
+        Future<int> ready = Future<int>(1).Then([](int) -> int { throw std::runtime_error("continuation failed"); });
+
+        promise.SetValue(1);
+
+        TS_CHECK(ThrowsRuntimeError(std::move(pending)));
+        TS_CHECK(ThrowsRuntimeError(std::move(ready)));
+    }
+
+    // The continuation itself can't throw, handing its result on can. That fails the future instead of terminating.
+    void NoexceptContinuationThrowingResult()
+    {
+        Promise<int> promise;
+        Future<ThrowsOnMove> pending = promise.GetFuture().Then([](int) noexcept { return ThrowsOnMove(); });
+        Future<ThrowsOnMove> ready = Future<int>(1).Then([](int) noexcept { return ThrowsOnMove(); });
+
+        promise.SetValue(1);
+
+        TS_CHECK(pending.HasException());
+        TS_CHECK(ready.HasException());
+    }
+
+    // Not default constructible, counts how often it gets copied and moved
+    struct Counted
+    {
+        static inline int copies = 0;
+        static inline int moves = 0;
+
+        int a;
+        int b;
+
+        Counted(int a, int b)
+            : a(a)
+            , b(b)
+        { }
+
+        Counted(Counted const& other)
+            : a(other.a)
+            , b(other.b)
+        {
+            ++copies;
+        }
+
+        Counted(Counted&& other) noexcept
+            : a(other.a)
+            , b(other.b)
+        {
+            ++moves;
+        }
+
+        static void Reset()
+        {
+            copies = 0;
+            moves = 0;
+        }
+    };
+
+    struct ThrowsOnConstruction
+    {
+        explicit ThrowsOnConstruction(int)
+        {
+            throw std::runtime_error("construction failed");
+        }
+    };
+
+    void EmplaceIntoState()
+    {
+        Counted::Reset();
+
+        Promise<Counted> promise;
+        Future<Counted> fut = promise.GetFuture();
+        promise.Emplace(1, 2);
+
+        Counted value = fut.Get();
+
+        TS_CHECK(value.a == 1 && value.b == 2);
+        TS_CHECK(Counted::copies == 0);
+        TS_CHECK(Counted::moves == 1);
+    }
+
+    // A waiting continuation gets the value constructed in its argument, it is only moved into the call
+    void EmplaceIntoContinuation()
+    {
+        Counted::Reset();
+
+        Promise<Counted> promise;
+        Future<int> sum = promise.GetFuture().Then([](Counted value) { return value.a + value.b; });
+        promise.Emplace(3, 4);
+
+        TS_CHECK(sum.Get() == 7);
+        TS_CHECK(Counted::copies == 0);
+        TS_CHECK(Counted::moves == 1);
+    }
+
+    void EmplaceTwice()
+    {
+        Promise<Counted> promise;
+        promise.Emplace(1, 2);
+
+        bool thrown = false;
+
+        try
+        {
+            promise.Emplace(3, 4);
+        }
+        catch (FutureError const& e)
+        {
+            thrown = e.ErrorCode() == FutureErrorCode::PromiseAlreadySatisfied;
+        }
+
+        TS_CHECK(thrown);
+    }
+
+    // The promise isn't satisfied if constructing the value throws, it can still be failed
+    void EmplaceThrows()
+    {
+        Promise<ThrowsOnConstruction> promise;
+        Future<ThrowsOnConstruction> fut = promise.GetFuture();
+
+        bool thrown = false;
+
+        try
+        {
+            promise.Emplace(1);
+        }
+        catch (std::runtime_error const&)
+        {
+            thrown = true;
+        }
+
+        TS_CHECK(thrown);
+        TS_CHECK(!fut.IsReady());
+
+        promise.SetException(std::make_exception_ptr(std::runtime_error("gave up")));
+        TS_CHECK(fut.HasException());
+    }
+
+    // References are handed through untouched, every hop sees the original object
+    void BorrowedValues()
+    {
+        int object = 1;
+
+        Promise<int&> promise;
+        Future<int*> address = promise.GetFuture().Then([](int& value)
+            {
+                ++value;
+                return &value;
+            });
+
+        promise.SetValue(object);
+
+        TS_CHECK(address.Get() == &object);
+        TS_CHECK(object == 2);
+
+        Future<int&> ready(object);
+        TS_CHECK(ready.TryGet() == &object);
+        TS_CHECK(&ready.Get() == &object);
+    }
+
+    void BorrowedWhenAll()
+    {
+        std::vector<int> objects{ 1, 2, 3 };
+        std::vector<Promise<int&>> promises(objects.size());
+        std::vector<Future<int&>> futures;
+
+        for (auto& promise : promises)
+            futures.push_back(promise.GetFuture());
+
+        auto all = WhenAll(std::span<Future<int&>>(futures));
+
+        for (size_t i = 0; i < objects.size(); ++i)
+            promises[i].SetValue(objects[i]);
+
+        std::vector<std::reference_wrapper<int>> references = all.Get();
+        TS_CHECK(references.size() == objects.size());
+
+        for (size_t i = 0; i < objects.size(); ++i)
+            TS_CHECK(&references[i].get() == &objects[i]);
+    }
+
+    void BorrowedPersistent()
+    {
+        int object = 5;
+
+        Promise<int&> promise;
+        PersistentFuture<int&> persistent(promise.GetFuture());
+
+        Future<int const*> address = persistent.Then([](PersistentFuture<int&>::shared_value_type value)
+            {
+                return value.get();
+            });
+
+        promise.SetValue(object);
+
+        TS_CHECK(&persistent.Get() == &object);
+        TS_CHECK(address.Get() == &object);
+    }
+
+    // A span is the zero-copy way to hand out a range, only the view travels through the futures
+    void BorrowedSpan()
+    {
+        std::vector<int> buffer{ 1, 2, 3, 4 };
+
+        Promise<std::span<int>> promise;
+        Future<int> sum = promise.GetFuture().Then([&buffer](std::span<int> view)
+            {
+                TS_CHECK(view.data() == buffer.data());
+
+                int total = 0;
+                for (int value : view)
+                    total += value;
+
+                return total;
+            });
+
+        promise.SetValue(std::span<int>(buffer));
+        TS_CHECK(sum.Get() == 10);
+    }
+
+    // All branches but the last get a copy, the last one gets the value moved
+    void SplitValue()
+    {
+        Counted::Reset();
+
+        Promise<Counted> promise;
+        std::array<Future<Counted>, 3> branches = promise.GetFuture().Split<3>();
+
+        for (auto& branch : branches)
+            TS_CHECK(!branch.IsReady());
+
+        promise.Emplace(1, 2);
+
+        TS_CHECK(Counted::copies == 2);
+
+        for (auto& branch : branches)
+            TS_CHECK(branch.Get().a == 1);
+
+        std::array<Future<int>, 2> ready = Future<int>(5).Split<2>();
+        TS_CHECK(ready[0].Get() == 5);
+        TS_CHECK(ready[1].Get() == 5);
+    }
+
+    void SplitVoidAndReferences()
+    {
+        Promise<void> done;
+        std::array<Future<void>, 2> doneBranches = done.GetFuture().Split<2>();
+
+        int calls = 0;
+        Future<void> first = doneBranches[0].Then([&calls]() { ++calls; });
+        Future<void> second = doneBranches[1].Then([&calls]() { ++calls; });
+
+        done.SetDone();
+        TS_CHECK(calls == 2);
+
+        int object = 0;
+
+        Promise<int&> borrowed;
+        std::array<Future<int&>, 8> borrowedBranches = borrowed.GetFuture().Split<8>();
+        borrowed.SetValue(object);
+
+        for (auto& branch : borrowedBranches)
+            TS_CHECK(&branch.Get() == &object);
+    }
+
+    void SplitFailure()
+    {
+        Promise<int> failed;
+        std::array<Future<int>, 4> failedBranches = failed.GetFuture().Split<4>();
+        failed.SetException(std::make_exception_ptr(std::runtime_error("failed")));
+
+        for (auto& branch : failedBranches)
+            TS_CHECK(ThrowsRuntimeError(std::move(branch)));
+
+        Promise<int> errored;
+        errored.SetError(std::make_error_code(std::errc::timed_out));
+
+        // Split after the failure has arrived
+        std::array<Future<int>, 2> erroredBranches = errored.GetFuture().Split<2>();
+
+        for (auto& branch : erroredBranches)
+            TS_CHECK(branch.HasError());
+
+
+        std::array<Future<int>, 2> brokenBranches = Promise<int>().GetFuture().Split<2>();
+
+        for (auto& branch : brokenBranches)
+            TS_CHECK(TaskStuffTests::FailsWith(std::move(branch), FutureErrorCode::BrokenPromise));
+    }
+
+    void OnCompleteBothOutcomes()
+    {
+        Promise<int> valuePromise;
+        Future<int> value = valuePromise.GetFuture().OnComplete([](Result<int> result)
+            {
+                return result.HasValue() ? result.Get() : -1;
+            });
+
+        Promise<int> failedPromise;
+        Future<int> failed = failedPromise.GetFuture().OnComplete([](Result<int> result)
+            {
+                return result.HasException() ? -1 : result.Get();
+            });
+
+        valuePromise.SetValue(7);
+        failedPromise.SetException(std::make_exception_ptr(std::runtime_error("failed")));
+
+        TS_CHECK(value.Get() == 7);
+        TS_CHECK(failed.Get() == -1);
+
+        // On a ready future the continuation runs right away
+        bool called = false;
+        Future<void> done = Future<int>(1).OnComplete([&called](Result<int> result) { called = result.HasValue(); });
+        TS_CHECK(called);
+        TS_CHECK(done.HasValue());
+    }
+
+    void RecoverAndOnError()
+    {
+        Promise<int> failedPromise;
+        Future<int> recovered = failedPromise.GetFuture().Recover([](std::exception_ptr) { return 5; });
+        failedPromise.SetException(std::make_exception_ptr(std::runtime_error("failed")));
+        TS_CHECK(recovered.Get() == 5);
+
+        Future<int> passedThrough = Future<int>(3).Recover([](std::exception_ptr) { return 5; });
+        TS_CHECK(passedThrough.Get() == 3);
+
+        // OnError only handles the exception type it is given
+        Promise<int> matchingPromise;
+        Future<int> matching = matchingPromise.GetFuture().OnError<std::runtime_error>([](std::runtime_error const&) { return 1; });
+        matchingPromise.SetException(std::make_exception_ptr(std::runtime_error("failed")));
+        TS_CHECK(matching.Get() == 1);
+
+        Promise<int> otherPromise;
+        Future<int> other = otherPromise.GetFuture().OnError<std::logic_error>([](std::logic_error const&) { return 1; });
+        otherPromise.SetException(std::make_exception_ptr(std::runtime_error("failed")));
+        TS_CHECK(ThrowsRuntimeError(std::move(other)));
+
+        // Error codes are handed over as a std::system_error
+        Promise<int> erroredPromise;
+        Future<int> errored = erroredPromise.GetFuture().OnError<std::system_error>([](std::system_error const& e)
+            {
+                return e.code() == std::errc::timed_out ? 2 : 0;
+            });
+
+        erroredPromise.SetError(std::make_error_code(std::errc::timed_out));
+        TS_CHECK(errored.Get() == 2);
+    }
+
+    void OnExceptionOnValues()
+    {
+        int calls = 0;
+
+        Promise<int> failedPromise;
+        failedPromise.GetFuture().OnException([&calls](std::exception_ptr) { ++calls; });
+        failedPromise.SetException(std::make_exception_ptr(std::runtime_error("failed")));
+
+        Promise<std::string> valuePromise;
+        valuePromise.GetFuture().OnException([&calls](std::exception_ptr) { ++calls; });
+        valuePromise.SetValue("value");
+
+        Promise<int> erroredPromise;
+        erroredPromise.SetError(std::make_error_code(std::errc::timed_out));
+        erroredPromise.GetFuture().OnException([&calls](std::exception_ptr e)
+            {
+                try
+                {
+                    std::rethrow_exception(e);
+                }
+                catch (std::system_error const&)
+                {
+                    calls += 10;
+                }
+            });
+
+        TS_CHECK(calls == 11);
+    }
+
+    // Error codes pass through continuations without calling them and without any exception
+    void ErrorCodes()
+    {
+        std::error_code timedOut = std::make_error_code(std::errc::timed_out);
+
+        Promise<int> promise;
+        bool called = false;
+
+        Future<int> chained = promise.GetFuture()
+            .Then([&called](int value) { called = true; return value; })
+            .Then([&called](int value) { called = true; return Future<int>(value); });
+
+        promise.SetError(timedOut);
+
+        TS_CHECK(!called);
+        TS_CHECK(chained.HasError());
+        TS_CHECK(!chained.HasException());
+
+        Result<int> result = chained.GetResult();
+        TS_CHECK(!result.HasValue());
+        TS_CHECK(result.HasError());
+        TS_CHECK(result.GetError() == timedOut);
+
+        Promise<void> voidPromise;
+        Future<void> voidFut = voidPromise.GetFuture();
+        voidPromise.SetError(timedOut);
+
+        bool thrown = false;
+
+        try
+        {
+            voidFut.Get();
+        }
+        catch (std::system_error const& e)
+        {
+            thrown = e.code() == timedOut;
+        }
+
+        TS_CHECK(thrown);
+    }
+
+    void InvalidErrorCode()
+    {
+        Promise<int> promise;
+        Future<int> fut = promise.GetFuture();
+
+        bool thrown = false;
+
+        try
+        {
+            promise.SetError(std::error_code());
+        }
+        catch (FutureError const& e)
+        {
+            thrown = e.ErrorCode() == FutureErrorCode::InvalidErrorCode;
+        }
+
+        TS_CHECK(thrown);
+        TS_CHECK(!fut.IsReady());
+
+        promise.SetValue(1);
+        TS_CHECK(fut.Get() == 1);
+    }
+
+    void ErrorCodesInWhenAll()
+    {
+        Promise<int> first;
+        Promise<int> second;
+
+        auto all = WhenAll(first.GetFuture(), second.GetFuture());
+
+        first.SetValue(1);
+        second.SetError(std::make_error_code(std::errc::timed_out));
+
+        bool thrown = false;
+
+        try
+        {
+            all.Get();
+        }
+        catch (ExceptionAggregate const&)
+        {
+            thrown = true;
+        }
+
+        TS_CHECK(thrown);
+    }
+
+    void Polling()
+    {
+        Future<int> empty;
+        TS_CHECK(!empty.IsReady());
+        TS_CHECK(!empty.TryTake());
+
+        Promise<int> promise;
+        Future<int> fut = promise.GetFuture();
+
+        TS_CHECK(!fut.IsReady());
+        TS_CHECK(fut.TryGet() == nullptr);
+        TS_CHECK(!fut.TryTake());
+        TS_CHECK(fut.Valid());
+
+        promise.SetValue(3);
+
+        TS_CHECK(fut.IsReady() && fut.HasValue());
+        TS_CHECK(!fut.HasException() && !fut.HasError());
+
+        // TryGet leaves the value in the future, TryTake consumes it
+        TS_CHECK(*fut.TryGet() == 3);
+        TS_CHECK(fut.TryGet() == fut.TryGet());
+
+        std::optional<Result<int>> taken = fut.TryTake();
+        TS_CHECK(taken && taken->Get() == 3);
+        TS_CHECK(!fut.Valid());
+
+        Promise<void> failed;
+        Future<void> failedFut = failed.GetFuture();
+        failed.SetException(std::make_exception_ptr(std::runtime_error("failed")));
+
+        TS_CHECK(failedFut.IsReady() && failedFut.HasException());
+
+        std::optional<Result<void>> failure = failedFut.TryTake();
+        TS_CHECK(failure && failure->HasException());
+    }
+
+    // A poller sees the value as soon as it is published, never a ready future without it
+    void PollingFromAnotherThread()
+    {
+        for (int round = 0; round < 1000; ++round)
+        {
+            Promise<std::string> promise;
+            Future<std::string> fut = promise.GetFuture();
+
+            std::thread producer([&promise]()
+                {
+                    promise.SetValue("ready");
+                });
+
+            std::string const* value = nullptr;
+
+            while (!(value = fut.TryGet()))
+                std::this_thread::yield();
+
+            TS_CHECK(*value == "ready");
+            TS_CHECK(fut.IsReady());
+
+            producer.join();
+        }
+    }
+
+    void WaitAnyIndex()
+    {
+        std::vector<Promise<int>> promises(4);
+        std::vector<Future<int>> futures;
+
+        for (auto& promise : promises)
+            futures.push_back(promise.GetFuture());
+
+        std::span<Future<int>> span(futures);
+
+        TS_CHECK(!WaitAny(span, std::chrono::milliseconds(10)));
+
+        std::thread producer([&promises]()
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                promises[2].SetValue(2);
+            });
+
+        TS_CHECK(WaitAny(span) == 2);
+        producer.join();
+
+        // Nothing was consumed, a ready future is found without waiting
+        TS_CHECK(futures[2].Valid());
+        TS_CHECK(*WaitAny(span, std::chrono::milliseconds(0)) == 2);
+        TS_CHECK(futures[2].Get() == 2);
+
+        std::span<Future<int>> none;
+        TS_CHECK(WaitAny(none) == 0);
+        TS_CHECK(!WaitAny(none, std::chrono::milliseconds(0)));
+    }
+
+    void WaitAllTimeout()
+    {
+        std::vector<Promise<int>> promises(8);
+        std::vector<Future<int>> futures;
+
+        for (auto& promise : promises)
+            futures.push_back(promise.GetFuture());
+
+        std::span<Future<int>> span(futures);
+
+        promises[0].SetValue(0);
+        TS_CHECK(!WaitAll(span, std::chrono::milliseconds(10)));
+
+        std::vector<std::thread> producers;
+
+        for (size_t i = 1; i < promises.size(); ++i)
+        {
+            producers.emplace_back([&promises, i]()
+                {
+                    promises[i].SetValue(static_cast<int>(i));
+                });
+        }
+
+        WaitAll(span);
+
+        for (std::thread& producer : producers)
+            producer.join();
+
+        TS_CHECK(WaitAll(span, std::chrono::milliseconds(0)));
+
+        for (size_t i = 0; i < futures.size(); ++i)
+            TS_CHECK(futures[i].Get() == static_cast<int>(i));
+    }
+
+    void WaitWithoutState()
+    {
+        std::vector<Future<int>> futures(2);
+        futures[0] = Future<int>(1);
+
+        bool thrown = false;
+
+        try
+        {
+            WaitAll(std::span<Future<int>>(futures));
+        }
+        catch (FutureError const& e)
+        {
+            thrown = e.ErrorCode() == FutureErrorCode::NoState;
+        }
+
+        TS_CHECK(thrown);
+    }
+}
+
+int main()
+{
+    ChainCollapsing();
+    ChainFailure();
+    ChainOnReady();
+
+    LocalChain();
+    LocalWhenAll();
+    LocalGetWouldDeadlock();
+
+    NoexceptContinuations();
+    ThrowingContinuations();
+    NoexceptContinuationThrowingResult();
+
+    EmplaceIntoState();
+    EmplaceIntoContinuation();
+    EmplaceTwice();
+    EmplaceThrows();
+
+    BorrowedValues();
+    BorrowedWhenAll();
+    BorrowedPersistent();
+    BorrowedSpan();
+
+    SplitValue();
+    SplitVoidAndReferences();
+    SplitFailure();
+
+    OnCompleteBothOutcomes();
+    RecoverAndOnError();
+    OnExceptionOnValues();
+
+    ErrorCodes();
+    InvalidErrorCode();
+    ErrorCodesInWhenAll();
+
+    Polling();
+    PollingFromAnotherThread();
+
+    WaitAnyIndex();
+    WaitAllTimeout();
+    WaitWithoutState();
+
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include "../task_stuff.h"
+#include "test_util.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace TaskStuff;
+
+namespace
+{
+    // Fails the test instead of hanging it if fut doesn't complete in time
+    template <typename ValueT>
+    void CheckCompletes(Future<ValueT>& fut)
+    {
+        TS_CHECK(WaitAll(std::span(&fut, 1), std::chrono::seconds(10)));
+    }
+
+    // A single worker blocked in Get runs the task it waits for itself
+    void HelpingGet()
+    {
+        ThreadPool pool(1);
+        Promise<int> result;
+        Future<int> fut = result.GetFuture();
+
+        pool.Execute([&]()
+            {
+                Promise<int> inner;
+                Future<int> innerFut = inner.GetFuture();
+
+                pool.Execute([&]()
+                    {
+                        inner.SetValue(21);
+                    });
+
+                result.SetValue(innerFut.Get() * 2);
+            });
+
+        CheckCompletes(fut);
+        TS_CHECK(fut.Get() == 42);
+    }
+
+    // Task a blocks in Get, the task b it runs meanwhile blocks in a nested Get whose future is
+    // completed by a task queued from outside the pool once both sleep
+    void NestedHelpingGet()
+    {
+        ThreadPool pool(1);
+        Promise<void> first;
+        Promise<void> second;
+        Promise<void> done;
+        Future<void> finished = done.GetFuture();
+        std::atomic<bool> inner(false);
+
+        pool.Execute([&]()
+            {
+                Future<void> firstFut = first.GetFuture();
+
+                pool.Execute([&]()
+                    {
+                        Future<void> secondFut = second.GetFuture();
+                        inner.store(true);
+                        secondFut.Get();
+                        first.SetDone();
+                    });
+
+                firstFut.Get();
+                done.SetDone();
+            });
+
+        while (!inner.load())
+            std::this_thread::yield();
+
+        // Give the inner Get time to fall asleep
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        pool.Execute([&]()
+            {
+                second.SetDone();
+            });
+
+        CheckCompletes(finished);
+    }
+
+    // Recursive tasks waiting on their children, far more of them than workers
+    int Fib(ThreadPool& pool, int n)
+    {
+        if (n < 2)
+            return n;
+
+        auto child = std::make_shared<Promise<int>>();
+        Future<int> childFut = child->GetFuture();
+
+        pool.Execute([&pool, child, n]()
+            {
+                child->SetValue(Fib(pool, n - 2));
+            });
+
+        int own = Fib(pool, n - 1);
+        return own + childFut.Get();
+    }
+
+    void RecursiveGets()
+    {
+        ThreadPool pool(2);
+        Promise<int> result;
+        Future<int> fut = result.GetFuture();
+
+        pool.Execute([&]()
+            {
+                result.SetValue(Fib(pool, 18));
+            });
+
+        CheckCompletes(fut);
+        TS_CHECK(fut.Get() == 2584);
+    }
+}
+
+int main()
+{
+    HelpingGet();
+
+    for (int round = 0; round < 20; ++round)
+        NestedHelpingGet();
+
+    RecursiveGets();
+
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include "../task_stuff_process.h"
+#include "test_util.h"
+
+#include <cerrno>
+#include <system_error>
+
+using namespace TaskStuff;
+
+namespace
+{
+    void CaptureOutput(Reactor& reactor)
+    {
+        ProcessOptions options;
+        options.CaptureStdout = true;
+        options.CaptureStderr = true;
+
+        ChildProcess child = SpawnProcess(reactor, { "sh", "-c", "echo out; echo err >&2; exit 3" }, options);
+
+        TS_CHECK(child.Stdout.Get() == "out\n");
+        TS_CHECK(child.Stderr.Get() == "err\n");
+
+        ExitStatus status = child.Exit.Get();
+        TS_CHECK(status.Code == 3 && status.Signal == 0);
+    }
+
+    void KilledBySignal(Reactor& reactor)
+    {
+        ChildProcess child = SpawnProcess(reactor, { "sh", "-c", "kill -9 $$" });
+
+        ExitStatus status = child.Exit.Get();
+        TS_CHECK(!status.Success());
+        TS_CHECK(status.Signal == 9);
+    }
+
+    void MissingProgram(Reactor& reactor)
+    {
+        try
+        {
+            SpawnProcess(reactor, { "/nonexistent/task_stuff_process_test" });
+            TS_CHECK(false);
+        }
+        catch (std::system_error const& e)
+        {
+            TS_CHECK(e.code().value() == ENOENT);
+        }
+    }
+}
+
+int main()
+{
+    ThreadPool pool(2);
+
+    {
+        Reactor reactor(pool);
+
+        CaptureOutput(reactor);
+        KilledBySignal(reactor);
+        MissingProgram(reactor);
+    }
+
+    return 0;
+}
@@ -0,0 +1,122 @@
+#include "../task_stuff_socket.h"
+#include "test_util.h"
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace TaskStuff;
+
+namespace
+{
+    std::span<std::byte const> Bytes(char const* text)
+    {
+        return std::as_bytes(std::span(text, std::strlen(text)));
+    }
+
+    void ReadWrite(Reactor& reactor)
+    {
+        auto [a, b] = AsyncSocket::Pair(reactor);
+        std::byte buffer[16];
+
+        // The read parks until the write arrives
+        Future<size_t> read = b.Read(buffer);
+        TS_CHECK(a.Write(Bytes("hello")).Get() == 5);
+        TS_CHECK(read.Get() == 5);
+        TS_CHECK(std::memcmp(buffer, "hello", 5) == 0);
+
+        // The peer closing shows as a read of 0
+        Future<size_t> eof = b.Read(buffer);
+        a.Close();
+        TS_CHECK(eof.Get() == 0);
+    }
+
+    void LargeWrite(Reactor& reactor)
+    {
+        auto [a, b] = AsyncSocket::Pair(reactor);
+
+        // Far more than the socket buffers hold, so the write hits EAGAIN and waits for the reader
+        std::vector<std::byte> sent(8 << 20);
+        for (size_t i = 0; i < sent.size(); ++i)
+            sent[i] = static_cast<std::byte>(i * 13);
+
+        Future<size_t> write = a.Write(sent);
+        TS_CHECK(!write.IsReady());
+
+        std::vector<std::byte> received(sent.size());
+        size_t total = 0;
+
+        while (total < received.size())
+        {
+            size_t count = b.Read(std::span(received).subspan(total)).Get();
+            TS_CHECK(count > 0);
+            total += count;
+        }
+
+        TS_CHECK(write.Get() == sent.size());
+        TS_CHECK(received == sent);
+    }
+
+    void CancelOnClose(Reactor& reactor)
+    {
+        auto [a, b] = AsyncSocket::Pair(reactor);
+        std::byte buffer[16];
+
+        Future<size_t> first = b.Read(buffer);
+        Future<size_t> second = b.Read(buffer);
+        b.Close();
+
+        Result<size_t> firstResult = first.GetResult();
+        Result<size_t> secondResult = second.GetResult();
+
+        TS_CHECK(firstResult.HasError() && firstResult.GetError().value() == ECANCELED);
+        TS_CHECK(secondResult.HasError() && secondResult.GetError().value() == ECANCELED);
+        TS_CHECK(!b.IsOpen());
+    }
+
+    void ListenAcceptConnect(Reactor& reactor)
+    {
+        std::string path = (std::filesystem::temp_directory_path() / ("task_stuff_socket_test_" + std::to_string(getpid()))).string();
+        unlink(path.c_str());
+
+        AsyncSocket listener = AsyncSocket::Listen(reactor, path);
+
+        // Accept is started before anyone connects, so it parks first
+        Future<AsyncSocket> accepted = listener.Accept();
+        AsyncSocket client = AsyncSocket::Connect(reactor, path).Get();
+        AsyncSocket server = accepted.Get();
+
+        std::byte buffer[16];
+        Future<size_t> read = server.Read(buffer);
+        TS_CHECK(client.Write(Bytes("abc")).Get() == 3);
+        TS_CHECK(read.Get() == 3);
+        TS_CHECK(std::memcmp(buffer, "abc", 3) == 0);
+
+        listener.Close();
+        unlink(path.c_str());
+
+        Result<AsyncSocket> missing = AsyncSocket::Connect(reactor, path).GetResult();
+        TS_CHECK(missing.HasError());
+        TS_CHECK(missing.GetError().value() == ENOENT || missing.GetError().value() == ECONNREFUSED);
+    }
+}
+
+int main()
+{
+    ThreadPool pool(2);
+
+    {
+        Reactor reactor(pool);
+
+        ReadWrite(reactor);
+        LargeWrite(reactor);
+        CancelOnClose(reactor);
+        ListenAcceptConnect(reactor);
+    }
+
+    return 0;
+}
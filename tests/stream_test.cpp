@@ -0,0 +1,194 @@
+#include "../task_stuff_stream.h"
+#include "test_util.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+using namespace TaskStuff;
+
+namespace
+{
+    // Stream of 0 .. count - 1 whose elements are all ready right away
+    AsyncStream<int> Counting(int count)
+    {
+        auto next = std::make_shared<int>(0);
+
+        return AsyncStream<int>::Generate([next, count]()
+            {
+                std::optional<int> value;
+
+                if (*next < count)
+                    value = (*next)++;
+
+                return Future<std::optional<int>>(value);
+            });
+    }
+
+    std::vector<int> Drain(AsyncStream<int> stream)
+    {
+        std::vector<int> values;
+
+        while (std::optional<int> value = stream.Next().Get())
+            values.push_back(*value);
+
+        return values;
+    }
+
+    void CheckCounting(std::vector<int> const& values, int count)
+    {
+        TS_CHECK(values.size() == static_cast<size_t>(count));
+
+        for (int i = 0; i < count; ++i)
+            TS_CHECK(values[i] == i);
+    }
+
+    // A ready upstream fills the whole buffer in one go, that must not recurse per element
+    void LargeBuffer()
+    {
+        CheckCounting(Drain(Counting(250000).Buffer(100000)), 250000);
+    }
+
+    void LargeBatch()
+    {
+        AsyncStream<std::vector<int>> batches = Counting(250000).Batch(100000);
+        std::vector<size_t> sizes;
+        int expected = 0;
+
+        while (std::optional<std::vector<int>> batch = batches.Next().Get())
+        {
+            sizes.push_back(batch->size());
+
+            for (int value : *batch)
+                TS_CHECK(value == expected++);
+        }
+
+        TS_CHECK((sizes == std::vector<size_t>{ 100000, 100000, 50000 }));
+    }
+
+    void BufferedChannel()
+    {
+        constexpr int count = 100000;
+
+        Channel<int> channel(count);
+
+        for (int i = 0; i < count; ++i)
+            channel.Send(i);
+
+        channel.Close();
+
+        CheckCounting(Drain(AsyncStream<int>(channel).Buffer(count)), count);
+    }
+
+    void FusedAndMerged()
+    {
+        std::vector<int> values = Drain(Counting(1000)
+            .Filter([](int value) { return value % 2 == 0; })
+            .Map([](int value) { return value / 2; })
+            .Merge(Counting(0)));
+
+        CheckCounting(values, 500);
+    }
+
+    // Elements trickle in slower than the batch timeout, so batches are handed out before they are
+    // full, from the executor rather than the process wide timer thread
+    void BatchTimeout()
+    {
+        Channel<int> channel(16);
+
+        std::thread producer([channel]() mutable
+            {
+                for (int i = 0; i < 4; ++i)
+                {
+                    channel.Send(i).Get();
+                    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                }
+
+                channel.Close();
+            });
+
+        ThreadPool pool(1);
+
+        Promise<std::thread::id> workerPromise;
+        Future<std::thread::id> workerFut = workerPromise.GetFuture();
+        pool.Execute([&]() { workerPromise.SetValue(std::this_thread::get_id()); });
+        std::thread::id worker = workerFut.Get();
+
+        std::atomic<int> fromPool(0);
+
+        AsyncStream<std::vector<int>> batches = AsyncStream<int>(channel)
+            .Batch(100, std::chrono::milliseconds(10), pool)
+            .Map([&](std::vector<int> batch)
+                {
+                    if (std::this_thread::get_id() == worker)
+                        fromPool.fetch_add(1);
+
+                    return batch;
+                });
+
+        int received = 0;
+        int batchCount = 0;
+
+        while (std::optional<std::vector<int>> batch = batches.Next().Get())
+        {
+            received += static_cast<int>(batch->size());
+            ++batchCount;
+        }
+
+        producer.join();
+
+        TS_CHECK(received == 4);
+        TS_CHECK(batchCount > 1);
+        TS_CHECK(fromPool.load() > 0);
+    }
+
+    // Leaves a timer pending far in the future, exit has to stop the timer thread without waiting for it
+    void PendingTimeoutAtExit()
+    {
+        Channel<int> channel(4);
+        channel.Send(1);
+
+        ThreadPool pool(1);
+        AsyncStream<std::vector<int>> batches = AsyncStream<int>(channel).Batch(10, std::chrono::hours(1), pool);
+
+        Future<std::optional<std::vector<int>>> next = batches.Next();
+        TS_CHECK(!next.IsReady());
+
+        channel.Close();
+        TS_CHECK(next.Get()->size() == 1);
+    }
+
+    Future<int> AwaitNamed(Future<int> first, Future<int> second)
+    {
+        // Named futures are awaited as well as temporaries
+        int a = co_await first;
+        int b = co_await std::move(second);
+        co_return a + b;
+    }
+
+    void CoAwait()
+    {
+        Promise<int> promise;
+        Future<int> sum = AwaitNamed(Future<int>(1), promise.GetFuture());
+
+        TS_CHECK(!sum.IsReady());
+        promise.SetValue(2);
+        TS_CHECK(sum.Get() == 3);
+    }
+}
+
+int main()
+{
+    LargeBuffer();
+    LargeBatch();
+    BufferedChannel();
+    FusedAndMerged();
+    BatchTimeout();
+    CoAwait();
+    PendingTimeoutAtExit();
+
+    return 0;
+}
@@ -0,0 +1,576 @@
+#include "../task_stuff_sync.h"
+#include "test_util.h"
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace TaskStuff;
+
+namespace
+{
+    // Raises max to value if it is larger
+    void TrackMax(std::atomic<int>& max, int value)
+    {
+        int current = max.load();
+
+        while (current < value && !max.compare_exchange_weak(current, value))
+        { }
+    }
+
+    void SemaphoreOrder()
+    {
+        AsyncSemaphore semaphore(1);
+
+        std::optional<AsyncSemaphore::Permit> held = semaphore.TryAcquire();
+        TS_CHECK(held && semaphore.Available() == 0);
+        TS_CHECK(!semaphore.TryAcquire());
+
+        // Waiters get the permit in the order they asked for it
+        std::vector<int> order;
+        std::vector<Future<void>> waits;
+
+        for (int i = 0; i < 3; ++i)
+        {
+            waits.push_back(semaphore.Acquire().Then([&order, i](AsyncSemaphore::Permit)
+                {
+                    order.push_back(i);
+                }));
+        }
+
+        TS_CHECK(!waits[0].IsReady());
+        held.reset();
+
+        for (Future<void>& wait : waits)
+            wait.Get();
+
+        TS_CHECK((order == std::vector<int>{ 0, 1, 2 }));
+        TS_CHECK(semaphore.Available() == 1);
+    }
+
+    // Threads blocking on Acquire, parked continuations released from the pool and TryAcquire
+    // all compete, the number of permits held at once never exceeds the semaphore's
+    void SemaphoreStress()
+    {
+        constexpr int permits = 3;
+        constexpr int threadCount = 8;
+        constexpr int perThread = 10000;
+
+        AsyncSemaphore semaphore(permits);
+        ThreadPool pool(4);
+        std::atomic<int> inside(0);
+        std::atomic<int> maxInside(0);
+        std::atomic<int> completed(0);
+        std::vector<std::thread> threads;
+
+        auto enter = [&]()
+            {
+                int now = inside.fetch_add(1) + 1;
+                TS_CHECK(now <= permits);
+                TrackMax(maxInside, now);
+            };
+
+        auto leave = [&]()
+            {
+                inside.fetch_sub(1);
+            };
+
+        for (int t = 0; t < threadCount; ++t)
+        {
+            threads.emplace_back([&, t]()
+                {
+                    std::vector<Future<void>> pending;
+
+                    for (int i = 0; i < perThread; ++i)
+                    {
+                        switch ((t + i) % 3)
+                        {
+                        case 0:
+                        {
+                            AsyncSemaphore::Permit permit = semaphore.Acquire().Get();
+                            enter();
+                            leave();
+                            permit.Release();
+                            completed.fetch_add(1);
+                            break;
+                        }
+
+                        case 1:
+                            // The permit moves to a pool thread which gives it back there
+                            pending.push_back(semaphore.Acquire().Then([&](AsyncSemaphore::Permit permit)
+                                {
+                                    enter();
+
+                                    pool.Execute([&, permit = std::move(permit)]() mutable
+                                        {
+                                            leave();
+                                            permit.Release();
+                                            completed.fetch_add(1);
+                                        });
+                                }));
+                            break;
+
+                        default:
+                            if (std::optional<AsyncSemaphore::Permit> permit = semaphore.TryAcquire())
+                            {
+                                enter();
+                                leave();
+                            }
+
+                            completed.fetch_add(1);
+                            break;
+                        }
+                    }
+
+                    for (Future<void>& fut : pending)
+                        fut.Get();
+                });
+        }
+
+        for (std::thread& thread : threads)
+            thread.join();
+
+        // The last permits may still be on their way back from the pool
+        while (completed.load() < threadCount * perThread)
+            std::this_thread::yield();
+
+        TS_CHECK(maxInside.load() <= permits);
+        TS_CHECK(inside.load() == 0);
+        TS_CHECK(semaphore.Available() == permits);
+    }
+
+    void MutexOrder()
+    {
+        AsyncMutex mutex;
+
+        std::optional<AsyncMutex::Guard> held = mutex.TryLock();
+        TS_CHECK(held && held->OwnsLock());
+        TS_CHECK(!mutex.TryLock());
+
+        std::vector<int> order;
+        std::vector<Future<void>> locks;
+
+        for (int i = 0; i < 3; ++i)
+        {
+            locks.push_back(mutex.Lock().Then([&order, i](AsyncMutex::Guard)
+                {
+                    order.push_back(i);
+                }));
+        }
+
+        TS_CHECK(!locks[0].IsReady());
+        held->Unlock();
+        TS_CHECK(!held->OwnsLock());
+
+        for (Future<void>& lock : locks)
+            lock.Get();
+
+        TS_CHECK((order == std::vector<int>{ 0, 1, 2 }));
+        TS_CHECK(mutex.TryLock());
+    }
+
+    // Readers share the lock, a queued writer keeps later readers out until it had its turn
+    void SharedMutexOrder()
+    {
+        AsyncSharedMutex mutex;
+
+        AsyncSharedMutex::SharedGuard first = mutex.LockShared().Get();
+        AsyncSharedMutex::SharedGuard second = mutex.LockShared().Get();
+        TS_CHECK(!mutex.TryLock());
+
+        Future<AsyncSharedMutex::Guard> writer = mutex.Lock();
+        Future<AsyncSharedMutex::SharedGuard> reader = mutex.LockShared();
+        TS_CHECK(!writer.IsReady() && !reader.IsReady());
+        TS_CHECK(!mutex.TryLockShared());
+
+        first.Unlock();
+        TS_CHECK(!writer.IsReady());
+        second.Unlock();
+        TS_CHECK(writer.IsReady() && !reader.IsReady());
+
+        writer.Get().Unlock();
+        TS_CHECK(reader.IsReady());
+        TS_CHECK(mutex.TryLockShared());
+    }
+
+    // Writers through Lock and TryLock, blocking and from continuations, never overlap
+    void MutexStress()
+    {
+        constexpr int threadCount = 8;
+        constexpr int perThread = 10000;
+
+        AsyncMutex mutex;
+        std::atomic<int> inside(0);
+        int64_t counter = 0; // Only touched with the lock held
+        std::atomic<int64_t> increments(0);
+        std::vector<std::thread> threads;
+
+        auto critical = [&]()
+            {
+                TS_CHECK(inside.fetch_add(1) == 0);
+                ++counter;
+                increments.fetch_add(1);
+                TS_CHECK(inside.fetch_sub(1) == 1);
+            };
+
+        for (int t = 0; t < threadCount; ++t)
+        {
+            threads.emplace_back([&, t]()
+                {
+                    std::vector<Future<void>> pending;
+
+                    for (int i = 0; i < perThread; ++i)
+                    {
+                        switch ((t + i) % 3)
+                        {
+                        case 0:
+                        {
+                            AsyncMutex::Guard guard = mutex.Lock().Get();
+                            critical();
+                            break;
+                        }
+
+                        case 1:
+                            pending.push_back(mutex.Lock().Then([&](AsyncMutex::Guard)
+                                {
+                                    critical();
+                                }));
+                            break;
+
+                        default:
+                            if (std::optional<AsyncMutex::Guard> guard = mutex.TryLock())
+                                critical();
+                            break;
+                        }
+                    }
+
+                    for (Future<void>& fut : pending)
+                        fut.Get();
+                });
+        }
+
+        for (std::thread& thread : threads)
+            thread.join();
+
+        // Scope for lock
+        {
+            AsyncMutex::Guard guard = mutex.Lock().Get();
+            TS_CHECK(counter == increments.load());
+        }
+    }
+
+    void SharedMutexStress()
+    {
+        constexpr int threadCount = 8;
+        constexpr int perThread = 10000;
+
+        AsyncSharedMutex mutex;
+        std::atomic<int> readers(0);
+        std::atomic<int> writers(0);
+        std::atomic<int> maxReaders(0);
+        std::vector<std::thread> threads;
+
+        auto write = [&]()
+            {
+                TS_CHECK(writers.fetch_add(1) == 0);
+                TS_CHECK(readers.load() == 0);
+                TS_CHECK(writers.fetch_sub(1) == 1);
+            };
+
+        auto read = [&]()
+            {
+                TrackMax(maxReaders, readers.fetch_add(1) + 1);
+                TS_CHECK(writers.load() == 0);
+                std::this_thread::yield();
+                readers.fetch_sub(1);
+            };
+
+        for (int t = 0; t < threadCount; ++t)
+        {
+            threads.emplace_back([&, t]()
+                {
+                    std::vector<Future<void>> pending;
+
+                    for (int i = 0; i < perThread; ++i)
+                    {
+                        // Mostly readers, with a writer every few operations
+                        switch ((t + i) % 5)
+                        {
+                        case 0:
+                        {
+                            AsyncSharedMutex::Guard guard = mutex.Lock().Get();
+                            write();
+                            break;
+                        }
+
+                        case 1:
+                            pending.push_back(mutex.Lock().Then([&](AsyncSharedMutex::Guard)
+                                {
+                                    write();
+                                }));
+                            break;
+
+                        case 2:
+                            pending.push_back(mutex.LockShared().Then([&](AsyncSharedMutex::SharedGuard)
+                                {
+                                    read();
+                                }));
+                            break;
+
+                        case 3:
+                            if (std::optional<AsyncSharedMutex::SharedGuard> guard = mutex.TryLockShared())
+                                read();
+                            break;
+
+                        default:
+                        {
+                            AsyncSharedMutex::SharedGuard guard = mutex.LockShared().Get();
+                            read();
+                            break;
+                        }
+                        }
+                    }
+
+                    for (Future<void>& fut : pending)
+                        fut.Get();
+                });
+        }
+
+        for (std::thread& thread : threads)
+            thread.join();
+
+        TS_CHECK(readers.load() == 0 && writers.load() == 0);
+        TS_CHECK(mutex.TryLock());
+    }
+
+    void ManualResetEvent()
+    {
+        AsyncManualResetEvent event;
+        TS_CHECK(!event.IsSet());
+
+        Future<void> first = event.Wait();
+        Future<void> second = event.Wait();
+        TS_CHECK(!first.IsReady() && !second.IsReady());
+
+        event.Set();
+        TS_CHECK(event.IsSet() && first.IsReady() && second.IsReady());
+        TS_CHECK(event.Wait().IsReady());
+
+        event.Reset();
+        Future<void> third = event.Wait();
+        TS_CHECK(!event.IsSet() && !third.IsReady());
+
+        event.Set();
+        TS_CHECK(third.IsReady());
+
+        TS_CHECK(AsyncManualResetEvent(true).Wait().IsReady());
+    }
+
+    void Latch()
+    {
+        AsyncLatch latch(3);
+        Future<void> wait = latch.Wait();
+
+        latch.CountDown();
+        latch.CountDown();
+        TS_CHECK(!wait.IsReady() && !latch.TryWait());
+
+        latch.CountDown();
+        TS_CHECK(wait.IsReady() && latch.TryWait());
+        TS_CHECK(latch.Wait().IsReady());
+
+        TS_CHECK(AsyncLatch(0).TryWait());
+    }
+
+    // Threads waiting on the event while it is set, and on a latch counted down by all of them
+    void EventAndLatchStress()
+    {
+        constexpr int threadCount = 8;
+        constexpr int rounds = 1000;
+
+        for (int round = 0; round < rounds; ++round)
+        {
+            AsyncManualResetEvent event;
+            AsyncLatch latch(threadCount);
+            std::atomic<int> released(0);
+            std::vector<std::thread> threads;
+
+            for (int t = 0; t < threadCount; ++t)
+            {
+                threads.emplace_back([&]()
+                    {
+                        event.Wait().Get();
+                        TS_CHECK(event.IsSet());
+
+                        latch.ArriveAndWait().Get();
+                        TS_CHECK(latch.TryWait());
+                        released.fetch_add(1);
+                    });
+            }
+
+            event.Set();
+
+            for (std::thread& thread : threads)
+                thread.join();
+
+            TS_CHECK(released.load() == threadCount);
+        }
+    }
+
+    // Every participant goes through all phases. The completion function runs exactly once per
+    // phase, after all participants arrived and before any of them continues.
+    void BarrierPhases()
+    {
+        constexpr int participants = 6;
+        constexpr int phases = 2000;
+
+        std::vector<std::atomic<int>> arrivals(phases);
+        std::atomic<int> completedPhases(0);
+
+        AsyncBarrier barrier(participants, [&]()
+            {
+                int phase = completedPhases.load();
+                TS_CHECK(phase < phases);
+                TS_CHECK(arrivals[phase].load() == participants);
+                completedPhases.store(phase + 1);
+            });
+
+        std::vector<std::thread> threads;
+
+        for (int t = 0; t < participants; ++t)
+        {
+            threads.emplace_back([&]()
+                {
+                    for (int phase = 0; phase < phases; ++phase)
+                    {
+                        arrivals[phase].fetch_add(1);
+                        barrier.ArriveAndWait().Get();
+                        TS_CHECK(completedPhases.load() == phase + 1);
+                    }
+                });
+        }
+
+        for (std::thread& thread : threads)
+            thread.join();
+
+        TS_CHECK(completedPhases.load() == phases);
+
+        for (std::atomic<int>& count : arrivals)
+            TS_CHECK(count.load() == participants);
+    }
+
+    // A throwing completion function still ends the phase, every participant gets the exception
+    void BarrierCompletionThrows()
+    {
+        int phase = 0;
+
+        AsyncBarrier barrier(3, [&]()
+            {
+                if (phase++ == 0)
+                    throw std::runtime_error("completion");
+            });
+
+        Future<void> first = barrier.ArriveAndWait();
+        Future<void> second = barrier.ArriveAndWait();
+        TS_CHECK(!first.IsReady());
+
+        Future<void> last = barrier.ArriveAndWait();
+
+        for (Future<void>* fut : { &first, &second, &last })
+        {
+            Result<void> result = fut->GetResult();
+            TS_CHECK(result.HasException());
+        }
+
+        // The next phase works as usual
+        Future<void> again = barrier.ArriveAndWait();
+        Future<void> againSecond = barrier.ArriveAndWait();
+        TS_CHECK(!again.IsReady());
+        barrier.ArriveAndWait().Get();
+        again.Get();
+        againSecond.Get();
+        TS_CHECK(phase == 2);
+    }
+
+    // Participants chaining their next arrival from the continuation of the previous one
+    void BarrierContinuations()
+    {
+        constexpr int participants = 4;
+        constexpr int phases = 1000;
+
+        std::atomic<int> completedPhases(0);
+        AsyncBarrier barrier(participants, [&]()
+            {
+                completedPhases.fetch_add(1);
+            });
+
+        ThreadPool pool(participants);
+        std::vector<Promise<void>> done(participants);
+        std::vector<Future<void>> finished;
+
+        for (Promise<void>& promise : done)
+            finished.push_back(promise.GetFuture());
+
+        struct Participant
+        {
+            static void Arrive(AsyncBarrier& barrier, ThreadPool& pool, Promise<void>& done, std::atomic<int>& completedPhases, int phase)
+            {
+                if (phase == phases)
+                {
+                    done.SetDone();
+                    return;
+                }
+
+                barrier.ArriveAndWait().OnComplete([&, phase](Result<void>)
+                    {
+                        TS_CHECK(completedPhases.load() == phase + 1);
+
+                        // Next arrival from the pool, so the stack doesn't grow with the phases
+                        pool.Execute([&, phase]()
+                            {
+                                Arrive(barrier, pool, done, completedPhases, phase + 1);
+                            });
+                    });
+            }
+        };
+
+        for (int i = 0; i < participants; ++i)
+        {
+            pool.Execute([&, i]()
+                {
+                    Participant::Arrive(barrier, pool, done[i], completedPhases, 0);
+                });
+        }
+
+        for (Future<void>& fut : finished)
+            fut.Get();
+
+        TS_CHECK(completedPhases.load() == phases);
+    }
+}
+
+int main()
+{
+    SemaphoreOrder();
+
+    MutexOrder();
+    SharedMutexOrder();
+    ManualResetEvent();
+    Latch();
+    EventAndLatchStress();
+    BarrierCompletionThrows();
+
+    for (int round = 0; round < 5; ++round)
+    {
+        SemaphoreStress();
+        MutexStress();
+        SharedMutexStress();
+        BarrierPhases();
+        BarrierContinuations();
+    }
+
+    return 0;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "../task_stuff.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+
+#include <unistd.h>
+
+// Minimal checks for the test executables, a failed check aborts which ctest reports as a failure
+#define TS_CHECK(condition)                                                                     \
+    do                                                                                          \
+    {                                                                                           \
+        if (!(condition))                                                                       \
+        {                                                                                       \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            std::abort();                                                                       \
+        }                                                                                       \
+    }                                                                                           \
+    while (false)
+
+namespace TaskStuffTests
+{
+    // True if fut completes with a FutureError carrying code
+    template <typename FutureT>
+    bool FailsWith(FutureT fut, TaskStuff::FutureErrorCode code)
+    {
+        try
+        {
+            fut.Get();
+        }
+        catch (TaskStuff::FutureError const& e)
+        {
+            return e.ErrorCode() == code;
+        }
+
+        return false;
+    }
+
+    // Creates an empty file in the temp directory and removes it again when going out of scope
+    class TempFile
+    {
+    private:
+
+        std::string _path_;
+
+    public:
+
+        TempFile()
+        {
+            std::string pattern = (std::filesystem::temp_directory_path() / "task_stuff_test_XXXXXX").string();
+            int fd = mkstemp(pattern.data());
+            TS_CHECK(fd >= 0);
+            close(fd);
+            _path_ = pattern;
+        }
+
+        ~TempFile()
+        {
+            unlink(_path_.c_str());
+        }
+
+        TempFile(TempFile const&) = delete;
+        TempFile& operator=(TempFile const&) = delete;
+
+        std::string const& Path() const
+        {
+            return _path_;
+        }
+    };
+}
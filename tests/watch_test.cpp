@@ -0,0 +1,223 @@
+#include "../task_stuff_watch.h"
+#include "test_util.h"
+
+#include <cerrno>
+#include <chrono>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace TaskStuff;
+using TaskStuffTests::TempFile;
+
+namespace
+{
+    // Creates an empty directory in the temp directory and removes it with its contents again
+    class TempDirectory
+    {
+    private:
+
+        std::string _path_;
+
+    public:
+
+        TempDirectory()
+        {
+            std::string pattern = (std::filesystem::temp_directory_path() / "task_stuff_test_XXXXXX").string();
+            TS_CHECK(mkdtemp(pattern.data()) != nullptr);
+            _path_ = pattern;
+        }
+
+        ~TempDirectory()
+        {
+            std::filesystem::remove_all(_path_);
+        }
+
+        TempDirectory(TempDirectory const&) = delete;
+        TempDirectory& operator=(TempDirectory const&) = delete;
+
+        std::string const& Path() const
+        {
+            return _path_;
+        }
+    };
+
+    // Events come from the reactor thread, a missing one fails the test instead of hanging it
+    template <typename ValueT>
+    ValueT GetWithin(Future<ValueT> fut)
+    {
+        TS_CHECK(WaitAll(std::span<Future<ValueT>>(&fut, 1), std::chrono::seconds(10)));
+        return fut.Get();
+    }
+
+    Future<FileEvent> NextEvent(FileSubscription const& subscription)
+    {
+        return subscription.Next().Then([](PersistentFuture<FileEvent>::shared_value_type event)
+            {
+                return *event;
+            });
+    }
+
+    void Append(std::string const& path)
+    {
+        int fd = open(path.c_str(), O_WRONLY | O_APPEND);
+        TS_CHECK(fd >= 0);
+        TS_CHECK(write(fd, "x", 1) == 1);
+        close(fd);
+    }
+
+    bool CancelledWith(Future<FileEvent> fut)
+    {
+        Result<FileEvent> result = GetWithin(fut.OnComplete([](Result<FileEvent> result) { return result; }));
+        return result.HasError() && result.GetError().value() == ECANCELED;
+    }
+
+    void WatchModified(FileWatcher& watcher)
+    {
+        TempFile temp;
+
+        Future<FileEvent> modified = watcher.WatchFile(temp.Path());
+        TS_CHECK(!modified.IsReady());
+
+        Append(temp.Path());
+
+        FileEvent event = GetWithin(std::move(modified));
+        TS_CHECK(event.Modified());
+        TS_CHECK(event.Path == temp.Path());
+        TS_CHECK(event.Name.empty());
+    }
+
+    // Only the events in the mask complete the watch, two watches on one file share the descriptor
+    void WatchMask(FileWatcher& watcher)
+    {
+        TempFile temp;
+
+        Future<FileEvent> attrib = watcher.WatchFile(temp.Path(), IN_ATTRIB);
+        Future<FileEvent> modified = watcher.WatchFile(temp.Path(), IN_MODIFY);
+
+        Append(temp.Path());
+        TS_CHECK(GetWithin(std::move(modified)).Mask & IN_MODIFY);
+        TS_CHECK(!attrib.IsReady());
+
+        TS_CHECK(chmod(temp.Path().c_str(), 0600) == 0);
+        TS_CHECK(GetWithin(std::move(attrib)).Mask & IN_ATTRIB);
+    }
+
+    void WatchRemoved(FileWatcher& watcher)
+    {
+        std::string path;
+        Future<FileEvent> removed;
+
+        // Scope for temp
+        {
+            TempFile temp;
+            path = temp.Path();
+            removed = watcher.WatchFile(path, IN_DELETE_SELF);
+        }
+
+        FileEvent event = GetWithin(std::move(removed));
+        TS_CHECK(event.Removed());
+        TS_CHECK(event.Path == path);
+    }
+
+    void WatchMissingPath(FileWatcher& watcher)
+    {
+        bool thrown = false;
+
+        try
+        {
+            watcher.WatchFile("/nonexistent/task_stuff_watch_test");
+        }
+        catch (std::system_error const& e)
+        {
+            thrown = e.code().value() == ENOENT;
+        }
+
+        TS_CHECK(thrown);
+    }
+
+    // A subscription on a directory reports entries as they come and go, to every consumer of Next
+    void SubscribeDirectory(FileWatcher& watcher)
+    {
+        TempDirectory dir;
+        std::string entry = dir.Path() + "/entry";
+
+        FileSubscription subscription = watcher.Subscribe(dir.Path(), IN_CREATE | IN_DELETE);
+
+        Future<FileEvent> created = NextEvent(subscription);
+        Future<FileEvent> createdAgain = NextEvent(subscription);
+
+        int fd = open(entry.c_str(), O_CREAT | O_WRONLY, 0600);
+        TS_CHECK(fd >= 0);
+        close(fd);
+
+        FileEvent event = GetWithin(std::move(created));
+        TS_CHECK(event.Created());
+        TS_CHECK(event.Path == dir.Path());
+        TS_CHECK(event.Name == "entry");
+        TS_CHECK(GetWithin(std::move(createdAgain)).Name == "entry");
+
+        Future<FileEvent> removed = NextEvent(subscription);
+        TS_CHECK(unlink(entry.c_str()) == 0);
+
+        event = GetWithin(std::move(removed));
+        TS_CHECK(event.Removed());
+        TS_CHECK(event.Name == "entry");
+
+        // Cancelling fails the round that is still waiting
+        Future<FileEvent> pending = NextEvent(subscription);
+        subscription.Cancel();
+
+        TS_CHECK(!subscription.Valid());
+        TS_CHECK(CancelledWith(std::move(pending)));
+    }
+
+    // Destroying the watcher fails everything still waiting on it
+    void WatcherDestroyed(Reactor& reactor)
+    {
+        TempFile temp;
+
+        Future<FileEvent> once;
+        Future<FileEvent> next;
+        FileSubscription subscription;
+
+        // Scope for watcher
+        {
+            FileWatcher watcher(reactor);
+            once = watcher.WatchFile(temp.Path());
+            subscription = watcher.Subscribe(temp.Path());
+            next = NextEvent(subscription);
+        }
+
+        TS_CHECK(CancelledWith(std::move(once)));
+        TS_CHECK(CancelledWith(std::move(next)));
+    }
+}
+
+int main()
+{
+    ThreadPool pool(2);
+
+    {
+        Reactor reactor(pool);
+
+        {
+            FileWatcher watcher(reactor);
+
+            WatchModified(watcher);
+            WatchMask(watcher);
+            WatchRemoved(watcher);
+            WatchMissingPath(watcher);
+            SubscribeDirectory(watcher);
+        }
+
+        WatcherDestroyed(reactor);
+    }
+
+    return 0;
+}